@@ -0,0 +1,184 @@
+/*==============================================================================
+Playback timing benchmark
+
+Plays files through a NullSink or RecordingSink with a PlaybackMonitor,
+and reports lateness of every message, wakeups and CPU time.
+
+usage: playback_benchmark [--seconds N] [--lookahead US] [--sink null|recording]
+                          [--stream] [--sessions N] [--threads N] [file.mid ...]
+
+--stream plays a precompiled PlaybackStream with StreamPlayer instead of Player.
+--sessions plays N copies of each file at once with a SessionScheduler
+           of --threads threads, to null sinks.
+==============================================================================*/
+
+#include "midi.h"
+#include "player.h"
+#include "playback_monitor.h"
+#include "session_scheduler.h"
+#include "stream_player.h"
+
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Options
+{
+	double								seconds = 10;
+	MidiParser::Microseconds			lookahead = MidiParser::Player::default_lookahead;
+	std::string							sink = "null";
+	bool								stream = false;
+	size_t								sessions = 0;
+	size_t								threads = 1;
+	std::vector<std::filesystem::path>	files;
+};
+
+Options parse_options(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--seconds" && i + 1 < argc)
+			options.seconds = std::stod(argv[++i]);
+		else if (arg == "--lookahead" && i + 1 < argc)
+			options.lookahead = MidiParser::Microseconds(std::stoll(argv[++i]));
+		else if (arg == "--sink" && i + 1 < argc)
+			options.sink = argv[++i];
+		else if (arg == "--stream")
+			options.stream = true;
+		else if (arg == "--sessions" && i + 1 < argc)
+			options.sessions = std::stoul(argv[++i]);
+		else if (arg == "--threads" && i + 1 < argc)
+			options.threads = std::stoul(argv[++i]);
+		else
+			options.files.emplace_back(arg);
+	}
+	if (options.files.empty())
+	{
+		std::filesystem::path root_path(ROOT_PATH);
+		options.files = {
+			root_path / "sample_sonic3_boss.mid",
+			root_path / "sample_tamashino_refrain.mid",
+			root_path / "sample_these.mid",
+		};
+	}
+	return options;
+}
+
+template <typename PlayerType>
+void run(PlayerType& player, MidiParser::MidiSink& sink, const Options& options)
+{
+	std::thread timer([&]
+	{
+		auto end = MidiParser::Clock::now() + std::chrono::duration<double>(options.seconds);
+		while (MidiParser::Clock::now() < end && !player.is_playing())
+			std::this_thread::yield();
+		while (MidiParser::Clock::now() < end && player.is_playing())
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		player.stop();
+	});
+	player.play(sink);
+	timer.join();
+}
+
+void benchmark(const std::filesystem::path& file_path, const Options& options)
+{
+	MidiParser::Midi midi(file_path);
+	MidiParser::PlaybackMonitor monitor;
+
+	std::unique_ptr<MidiParser::MidiSink> sink;
+	if (options.sink == "recording")
+		sink = std::make_unique<MidiParser::RecordingSink>(midi.event_count());
+	else
+		sink = std::make_unique<MidiParser::NullSink>();
+
+	// compiled before timing, as a cache would be
+	std::optional<MidiParser::PlaybackStream> stream;
+	if (options.stream)
+		stream.emplace(midi);
+
+	std::clock_t cpu_begin = std::clock();
+	MidiParser::Timepoint begin = MidiParser::Clock::now();
+	uint64_t overrun = 0, underrun = 0;
+	if (stream)
+	{
+		MidiParser::StreamPlayer player(*stream);
+		player.set_monitor(&monitor);
+		run(player, *sink, options);
+		underrun = player.get_underrun_count();
+	}
+	else
+	{
+		MidiParser::Player player(midi);
+		player.set_monitor(&monitor);
+		player.set_lookahead(options.lookahead);
+		run(player, *sink, options);
+		overrun = player.get_overrun_count();
+		underrun = player.get_underrun_count();
+	}
+	MidiParser::Timepoint end = MidiParser::Clock::now();
+	std::clock_t cpu_end = std::clock();
+
+	double played = std::chrono::duration<double>(end - begin).count();
+	double cpu = static_cast<double>(cpu_end - cpu_begin) / CLOCKS_PER_SEC;
+
+	std::cout
+	<< "===================================================================\n"
+	<< file_path.filename().string() << '\n'
+	<< "Played: " << played << " s, sink: " << options.sink
+	<< ", player: " << (options.stream ? "stream" : "midi")
+	<< ", lookahead: " << options.lookahead.count() << " us\n"
+	<< "CPU time per played minute: " << cpu / played * 60 * 1000 << " ms\n"
+	<< "Overrun: " << overrun << ", Underrun: " << underrun << '\n';
+	monitor.str(std::cout);
+}
+
+void benchmark_sessions(const std::filesystem::path& file_path, const Options& options)
+{
+	auto stream = std::make_shared<const MidiParser::PlaybackStream>(MidiParser::Midi(file_path));
+	std::vector<std::unique_ptr<MidiParser::NullSink>> sinks;
+	for (size_t i = 0; i < options.sessions; ++i)
+		sinks.emplace_back(std::make_unique<MidiParser::NullSink>());
+
+	std::clock_t cpu_begin = std::clock();
+	MidiParser::Timepoint begin = MidiParser::Clock::now();
+	{
+		MidiParser::SessionScheduler scheduler(options.threads);
+		for (auto& sink: sinks)
+			scheduler.add(stream, *sink);
+		std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+	}
+	MidiParser::Timepoint end = MidiParser::Clock::now();
+	std::clock_t cpu_end = std::clock();
+
+	double played = std::chrono::duration<double>(end - begin).count();
+	double cpu = static_cast<double>(cpu_end - cpu_begin) / CLOCKS_PER_SEC;
+	uint64_t message_count = 0;
+	for (auto& sink: sinks)
+		message_count += sink->get_message_count();
+
+	std::cout
+	<< "===================================================================\n"
+	<< file_path.filename().string() << '\n'
+	<< "Played: " << played << " s, sessions: " << options.sessions
+	<< ", threads: " << options.threads << '\n'
+	<< "CPU time per played minute: " << cpu / played * 60 * 1000 << " ms\n"
+	<< "Messages: " << message_count << '\n';
+}
+
+int main(int argc, char** argv)
+{
+	Options options = parse_options(argc, argv);
+	for (const auto& file_path: options.files)
+	{
+		if (options.sessions)
+			benchmark_sessions(file_path, options);
+		else
+			benchmark(file_path, options);
+	}
+}
@@ -0,0 +1,147 @@
+#include "alsa_sink.h"
+#include <alsa/asoundlib.h>
+#include <stdexcept>
+
+static void check(int result, const char* what)
+{
+	if (result < 0)
+		throw std::runtime_error(std::string(what) + ": " + snd_strerror(result));
+}
+
+/*
+	AlsaRawMidiSink
+*/
+AlsaRawMidiSink::AlsaRawMidiSink(const std::string& device)
+{
+	check(snd_rawmidi_open(nullptr, &handle, device.c_str(), 0), "snd_rawmidi_open");
+}
+
+AlsaRawMidiSink::~AlsaRawMidiSink()
+{
+	snd_rawmidi_drain(handle);
+	snd_rawmidi_close(handle);
+}
+
+void AlsaRawMidiSink::send(uint32_t message)
+{
+	MidiParser::byte bytes[3];
+	write(bytes, unpack(message, bytes));
+}
+
+void AlsaRawMidiSink::send(const uint32_t* messages, size_t count)
+{
+	// a write per 256 messages, on the stack so the sender never allocates
+	MidiParser::byte bytes[256 * 3];
+	size_t size = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		size += unpack(messages[i], bytes + size);
+		if (size > sizeof(bytes) - 3)
+		{
+			write(bytes, size);
+			size = 0;
+		}
+	}
+	if (size)
+		write(bytes, size);
+}
+
+void AlsaRawMidiSink::send_sysex(const MidiParser::byte* data, size_t size)
+{
+	write(data, size);
+}
+
+void AlsaRawMidiSink::write(const MidiParser::byte* data, size_t size)
+{
+	while (size)
+	{
+		// the port is blocking, a write waits for room
+		ssize_t written = snd_rawmidi_write(handle, data, size);
+		check(written, "snd_rawmidi_write");
+		data += written;
+		size -= written;
+	}
+}
+
+/*
+	AlsaSequencerSink
+*/
+AlsaSequencerSink::AlsaSequencerSink(
+	const std::string& destination,
+	const std::string& client_name
+)
+{
+	check(snd_seq_open(&handle, "default", SND_SEQ_OPEN_OUTPUT, 0), "snd_seq_open");
+	snd_seq_set_client_name(handle, client_name.c_str());
+	port = snd_seq_create_simple_port(
+		handle,
+		"out",
+		SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+		SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION
+	);
+	check(port, "snd_seq_create_simple_port");
+	check(snd_midi_event_new(16, &encoder), "snd_midi_event_new");
+
+	if (!destination.empty())
+	{
+		snd_seq_addr_t address;
+		check(
+			snd_seq_parse_address(handle, &address, destination.c_str()),
+			"snd_seq_parse_address"
+		);
+		check(
+			snd_seq_connect_to(handle, port, address.client, address.port),
+			"snd_seq_connect_to"
+		);
+	}
+}
+
+AlsaSequencerSink::~AlsaSequencerSink()
+{
+	snd_seq_drain_output(handle);
+	snd_midi_event_free(encoder);
+	snd_seq_close(handle);
+}
+
+void AlsaSequencerSink::send(uint32_t message)
+{
+	MidiParser::byte bytes[3];
+	output(bytes, unpack(message, bytes));
+	snd_seq_drain_output(handle);
+}
+
+void AlsaSequencerSink::send(const uint32_t* messages, size_t count)
+{
+	// events are buffered, and delivered at once
+	for (size_t i = 0; i < count; ++i)
+	{
+		MidiParser::byte bytes[3];
+		output(bytes, unpack(messages[i], bytes));
+	}
+	snd_seq_drain_output(handle);
+}
+
+void AlsaSequencerSink::send_sysex(const MidiParser::byte* data, size_t size)
+{
+	snd_seq_event_t event;
+	snd_seq_ev_clear(&event);
+	snd_seq_ev_set_sysex(&event, size, const_cast<MidiParser::byte*>(data));
+	snd_seq_ev_set_source(&event, port);
+	snd_seq_ev_set_subs(&event);
+	snd_seq_ev_set_direct(&event);
+	snd_seq_event_output_direct(handle, &event);
+}
+
+void AlsaSequencerSink::output(const MidiParser::byte* data, size_t size)
+{
+	snd_seq_event_t event;
+	snd_seq_ev_clear(&event);
+	snd_midi_event_reset_encode(encoder);
+	if (snd_midi_event_encode(encoder, data, size, &event) < 0 ||
+		event.type == SND_SEQ_EVENT_NONE)
+		return;
+	snd_seq_ev_set_source(&event, port);
+	snd_seq_ev_set_subs(&event);
+	snd_seq_ev_set_direct(&event);
+	snd_seq_event_output(handle, &event);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "midi_sink.h"
+#include <string>
+
+typedef struct _snd_rawmidi snd_rawmidi_t;
+typedef struct _snd_seq snd_seq_t;
+typedef struct snd_midi_event snd_midi_event_t;
+
+/*
+ * ALSA raw MIDI output, writes bytes straight to a hardware port.
+ * device: "hw:1,0,0", "virtual", ... (see `amidi -l`)
+*/
+class AlsaRawMidiSink final : public MidiParser::MidiSink
+{
+public:
+	AlsaRawMidiSink(const std::string& device = "default");
+	~AlsaRawMidiSink();
+
+	void	send(uint32_t message) override;
+	void	send(const uint32_t* messages, size_t count) override;
+	void	send_sysex(const MidiParser::byte* data, size_t size) override;
+
+private:
+	snd_rawmidi_t*	handle = nullptr;
+
+	void	write(const MidiParser::byte* data, size_t size);
+};
+
+/*
+ * ALSA sequencer output, for software synthesizers and routing.
+ * Creates an output port, and connects it to `destination` if given.
+ * destination: "128:0", "FLUID Synth", ... (see `aconnect -o`)
+*/
+class AlsaSequencerSink final : public MidiParser::MidiSink
+{
+public:
+	AlsaSequencerSink(
+		const std::string& destination = "",
+		const std::string& client_name = "midi_parser"
+	);
+	~AlsaSequencerSink();
+
+	void	send(uint32_t message) override;
+	void	send(const uint32_t* messages, size_t count) override;
+	void	send_sysex(const MidiParser::byte* data, size_t size) override;
+
+private:
+	snd_seq_t*			handle = nullptr;
+	snd_midi_event_t*	encoder = nullptr;
+	int					port = -1;
+
+	void	output(const MidiParser::byte* data, size_t size);
+};
@@ -1,81 +1,54 @@
-#include <windows.h>
-#include <cstdint>
-#include <bit>
+#include "midi_out.h"
+#include "event/midi_event.h"
+#include <cstdlib>
+#include <memory>
 
-struct MidiDevice
+#if defined(_WIN32)
+#include "winmm_sink.h"
+#elif defined(MIDI_OUT_ALSA)
+#include "alsa_sink.h"
+#endif
+
+static
+std::unique_ptr<MidiParser::MidiSink> create_sink()
 {
-	HMIDIOUT handle = nullptr;
-	MidiDevice()
-	{
-		init();
-	}
-	~MidiDevice()
-	{
-		close();
-	}
-	void init()
-	{
-		midiOutOpen(&handle, MIDI_MAPPER, 0, 0, CALLBACK_NULL);
-	}
-	void close()
-	{
-		midiOutReset(handle);
-		midiOutClose(handle);
-		handle = nullptr;
-	}
-	void reset()
-	{
-		close();
-		init();
-	}
-	operator HMIDIOUT()
-	{
-		return handle;
-	}
-};
+#if defined(_WIN32)
+	return std::make_unique<WinMMSink>();
+#elif defined(MIDI_OUT_ALSA)
+	const char* port = std::getenv("MIDI_OUT_PORT");
+	return std::make_unique<AlsaSequencerSink>(port ? port : "");
+#else
+	return std::make_unique<MidiParser::NullSink>();
+#endif
+}
 
-static 
-MidiDevice& midi_device()
+MidiParser::MidiSink& midi_sink()
 {
-	static MidiDevice device;
-	return device;
+	static std::unique_ptr<MidiParser::MidiSink> sink = create_sink();
+	return *sink;
 }
 
 void midi_init()
 {
-	midi_device();
+	midi_sink();
 }
 
 void midi_reset()
 {
-	midi_device().reset();
+	midi_sink().reset();
 }
 
 int midi_out(uint32_t msg)
 {
-	return midiOutShortMsg(midi_device(), msg);
+	midi_sink().send(msg);
+	return 0;
 }
 
 int midi_out(int channel, int instruction, int val0, int val1)
 {
-	if constexpr (std::endian::native == std::endian::little)
-	{
-		return midiOutShortMsg(
-			midi_device(),
-			(channel & 0xf)     <<  0 |
-			(instruction & 0xf) <<  4 |
-			(val0 & 0xff)       <<  8 |
-			(val1 & 0xff)       << 16 
-		);
-	}
-	else // constexpr (std::endian::native == std::endian::big)
-	{
-		return midiOutShortMsg(
-			midi_device(),
-			(channel & 0xf)     << 28 |
-			(instruction & 0xf) << 24 |
-			(val0 & 0xff)       << 18 |
-			(val1 & 0xff)       <<  8 
-		);
-	}
-}
\ No newline at end of file
+	return midi_out(MidiParser::MidiEvent::make_binary(
+		(instruction & 0xf) << 4 | (channel & 0xf),
+		val0,
+		val1
+	));
+}
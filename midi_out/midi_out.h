@@ -1,4 +1,5 @@
 #pragma once
+#include "midi_sink.h"
 #include <cstdint>
 
 /*
@@ -10,4 +11,12 @@ void midi_init();
 
 int midi_out(uint32_t msg);
 int midi_out(int channel, int instruction, int val0, int val1 = 0);
-void midi_reset();
\ No newline at end of file
+void midi_reset();
+
+/*
+ * Default output of the platform:
+ * - Windows: WinMMSink
+ * - Linux(with ALSA): AlsaSequencerSink, connected to $MIDI_OUT_PORT if set
+ * - otherwise: NullSink
+*/
+MidiParser::MidiSink& midi_sink();
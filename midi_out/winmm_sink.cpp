@@ -0,0 +1,52 @@
+#include "winmm_sink.h"
+#include <stdexcept>
+
+WinMMSink::WinMMSink(UINT device_id):
+	device_id(device_id)
+{
+	open();
+}
+
+WinMMSink::~WinMMSink()
+{
+	close();
+}
+
+void WinMMSink::send(uint32_t message)
+{
+	midiOutShortMsg(handle, message);
+}
+
+void WinMMSink::send_sysex(const MidiParser::byte* data, size_t size)
+{
+	MIDIHDR header = {};
+	header.lpData = reinterpret_cast<LPSTR>(const_cast<MidiParser::byte*>(data));
+	header.dwBufferLength = static_cast<DWORD>(size);
+	header.dwBytesRecorded = static_cast<DWORD>(size);
+	if (midiOutPrepareHeader(handle, &header, sizeof(header)) != MMSYSERR_NOERROR)
+		return;
+	midiOutLongMsg(handle, &header, sizeof(header));
+	while (midiOutUnprepareHeader(handle, &header, sizeof(header)) == MIDIERR_STILLPLAYING)
+		Sleep(1);
+}
+
+void WinMMSink::reset()
+{
+	close();
+	open();
+}
+
+void WinMMSink::open()
+{
+	if (midiOutOpen(&handle, device_id, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
+		throw std::runtime_error("midiOutOpen failed");
+}
+
+void WinMMSink::close()
+{
+	if (!handle)
+		return;
+	midiOutReset(handle);
+	midiOutClose(handle);
+	handle = nullptr;
+}
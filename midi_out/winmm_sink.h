@@ -0,0 +1,25 @@
+#pragma once
+#include "midi_sink.h"
+#include <windows.h>
+
+/*
+ * Windows multimedia(winmm) output.
+ * Opens MIDI_MAPPER unless a device id is given.
+*/
+class WinMMSink final : public MidiParser::MidiSink
+{
+public:
+	WinMMSink(UINT device_id = MIDI_MAPPER);
+	~WinMMSink();
+
+	void	send(uint32_t message) override;
+	void	send_sysex(const MidiParser::byte* data, size_t size) override;
+	void	reset() override;
+
+private:
+	UINT		device_id;
+	HMIDIOUT	handle = nullptr;
+
+	void	open();
+	void	close();
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include "common.h"
+#include "arrow_writer.h"
+#include "event_query.h"
+#include "event_table.h"
+#include "midi.h"
+#include <filesystem>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	ArrowExporter
+
+##########################*/
+/*
+ * Writes events into an Arrow IPC file, a record batch per song:
+ *
+ *	file_id		uint32, given by the caller
+ *	track		uint16
+ *	tick		uint64
+ *	us			int64, by the tempo map
+ *	type		dictionary of Event::get_type_name(), int8 indices
+ *	channel		uint8, null for meta and sysex
+ *	data0/1		uint8, as EventTable
+ *	payload		binary, meta data or sysex messages
+ *
+ * The columns of an EventTable are written as they are; only file_id, type
+ * and channel are made per song, unless a selection of rows is gathered.
+ * write() may be called from many threads.
+*/
+class ArrowExporter final
+{
+public:
+	/*---------------------
+		enumerations
+	---------------------*/
+	enum Column
+	{
+		FILE_ID,
+		TRACK,
+		TICK,
+		TIME,
+		TYPE,
+		CHANNEL,
+		DATA0,
+		DATA1,
+		PAYLOAD,
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	ArrowExporter(const std::filesystem::path& file_path);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				write(const EventTable& table, uint32_t file_id);
+	// the rows selected, copied into the batch
+	void				write(const EventTable& table, uint32_t file_id, const Selection& selection);
+	void				write(const Midi& midi, uint32_t file_id);
+	void				close(); // writes the footer
+
+	static
+	std::vector<ArrowWriter::Column>	get_columns();
+
+	/*
+	 * Exports every .mid/.midi file under input_directory, parsed in parallel,
+	 * into output_directory:
+	 *	events.arrow	the columns above, batches in the order they finish
+	 *	files.arrow		file_id, path(relative), error(null if parsed), events
+	*/
+	static
+	void				export_directory(
+		const std::filesystem::path&	input_directory,
+		const std::filesystem::path&	output_directory
+	);
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	ArrowWriter			writer;
+};
+} // MidiParser
@@ -0,0 +1,148 @@
+#pragma once
+#include "common.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	ArrowWriter
+
+##########################*/
+/*
+ * Writes an Apache Arrow IPC file(.arrow, Feather v2), uncompressed, that
+ * pyarrow, polars, DuckDB and the like read directly:
+ *
+ *	"ARROW1" schema dictionaries batches... footer "ARROW1"
+ *
+ * The flatbuffers of the metadata are built by hand, only the tables this
+ * format needs, so there is nothing to link.
+ *
+ * Columns are integers, binary or utf8. A column with a dictionary holds
+ * indices into it, the dictionary(utf8) is written once after the schema.
+ * A Batch points to the buffers of its columns, they are written as they
+ * are, without copies. write() may be called from many threads, a batch
+ * is encoded before the lock and only written under it.
+ * Buffers are in native byte order, which the schema records.
+*/
+class ArrowWriter final
+{
+public:
+	/*---------------------
+		enumerations
+	---------------------*/
+	enum class Type
+	{
+		INT8,
+		INT16,
+		INT32,
+		INT64,
+		UINT8,
+		UINT16,
+		UINT32,
+		UINT64,
+		BINARY,
+		UTF8,
+	};
+
+	/*---------------------
+		types
+	---------------------*/
+	struct Column
+	{
+		std::string					name;
+		Type						type;
+		bool						nullable = false;
+		std::vector<std::string>	dictionary = {}; // when not empty, type is the index type
+	};
+
+	// The buffers of one record batch, which must outlive write().
+	class Batch
+	{
+	public:
+		Batch(const ArrowWriter& writer, size_t length);
+
+		// fixed width, length values
+		void				set(int column, const void* values);
+		// binary and utf8, length + 1 offsets into data
+		void				set(int column, const int32_t* offsets, const void* data);
+		// a bit per value, lowest bit first, 0 for null
+		void				set_validity(int column, const byte* bitmap, int64_t null_count);
+		size_t				size() const;
+
+	private:
+		friend ArrowWriter;
+		struct Buffers
+		{
+			const byte*		validity = nullptr;
+			int64_t			null_count = 0;
+			const void*		values = nullptr;
+			const int32_t*	offsets = nullptr;
+		};
+		const ArrowWriter&		writer;
+		size_t					length;
+		std::vector<Buffers>	columns;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	ArrowWriter(const std::filesystem::path& file_path, std::vector<Column> columns);
+	~ArrowWriter(); // closes, ignoring errors
+	ArrowWriter(const ArrowWriter&) = delete;
+	ArrowWriter& operator=(const ArrowWriter&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				write(const Batch& batch);
+	void				close(); // writes the footer
+	bool				is_open() const;
+	const std::vector<Column>&	get_columns() const;
+	size_t				get_batch_count() const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Block
+	{
+		int64_t			offset;
+		int32_t			metadata_size;
+		int64_t			body_size;
+	};
+	struct Buffer
+	{
+		const void*		data;
+		size_t			size;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	std::ofstream		file;
+	std::vector<Column>	columns;
+	std::vector<Block>	dictionaries;
+	std::vector<Block>	batches;
+	int64_t				position = 0;
+	std::mutex			mutex;
+	bool				open = true;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				write_dictionary(int column, int64_t id);
+	// the message is written whole, its block recorded in blocks(if any)
+	void				write_message(
+		const std::vector<byte>&	metadata,
+		const std::vector<Buffer>&	body,
+		std::vector<Block>*			blocks
+	);
+	void				write_output(const void* data, size_t size);
+};
+} // MidiParser
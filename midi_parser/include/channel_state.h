@@ -0,0 +1,148 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include <array>
+#include <bitset>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	ChannelState
+
+##########################*/
+/*
+ * Everything a receiver remembers about one channel except sounding notes.
+ * Only touched values are sent back by get_messages().
+*/
+struct ChannelState
+{
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr int		registered_parameter_count = 6;
+	static constexpr uint16_t	null_parameter = 0x3fff;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::array<byte, 128>	controllers;
+	std::bitset<128>		controller_set;
+	byte					program = 0;
+	byte					pressure = 0;
+	uint16_t				pitch_bend = 0x2000; // 14 bit
+	uint16_t				registered_parameter = null_parameter;
+	uint16_t				non_registered_parameter = null_parameter;
+	bool					non_registered_selected = false;
+	bool					program_set = false;
+	bool					pressure_set = false;
+	bool					pitch_bend_set = false;
+	std::array<uint16_t, registered_parameter_count>	registered_parameters;
+	std::bitset<registered_parameter_count>				registered_parameter_set;
+
+	/*---------------------
+		constructor
+	---------------------*/
+	ChannelState();
+
+	/*---------------------
+		methods
+	---------------------*/
+	void	reset();
+	void	reset_controllers();
+	void	apply(int status, int data0, int data1);
+	void	get_messages(int channel, std::vector<uint32_t>& messages) const;
+
+
+private:
+	void	control_change(int controller, int value);
+};
+
+
+
+
+/*##########################
+
+	ChannelStateTracker
+
+##########################*/
+/*
+ * State of all 16 channels, updated by applying events in time order.
+*/
+class ChannelStateTracker final
+{
+public:
+	/*---------------------
+		members
+	---------------------*/
+	std::array<ChannelState, 16>	channels;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					reset();
+	void					apply(const Event& event);
+	void					apply(int status, int data0, int data1);
+	void					get_messages(std::vector<uint32_t>& messages) const;
+	std::vector<uint32_t>	get_messages() const;
+};
+
+
+
+
+/*##########################
+
+	ChannelStateIndex
+
+##########################*/
+/*
+ * Snapshots of ChannelStateTracker taken every `interval` ticks.
+ * Intervals without any channel message don't take a snapshot.
+ * seek() restores the nearest snapshot and replays only the events after it,
+ * instead of chasing every event from tick 0.
+*/
+class ChannelStateIndex final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	ChannelStateIndex() = default;
+	ChannelStateIndex(const Midi& midi, uint64_t interval = 0);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			build(const Midi& midi, uint64_t interval = 0);
+	void			seek(uint64_t tick, ChannelStateTracker& tracker) const; // state before tick
+	ChannelStateTracker	seek(uint64_t tick) const;
+	uint64_t		get_interval() const;
+	size_t			get_snapshot_count() const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Message
+	{
+		uint64_t	tick;
+		byte		status;
+		byte		data[2];
+	};
+
+	struct Snapshot
+	{
+		uint64_t			tick;
+		size_t				message_index;
+		ChannelStateTracker	tracker;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	uint64_t				interval = 0;
+	std::vector<Message>	messages;
+	std::vector<Snapshot>	snapshots;
+};
+} // MidiParser
@@ -5,6 +5,7 @@
 #include <string_view>
 #include <vector>
 #include <memory>
+#include <span>
 
 namespace MidiParser {
 class Track final
@@ -20,5 +21,43 @@ public:
 	---------------------*/
 	Track(const uint8_t*& input, const uint8_t* end);
 	Track() = default;
+
+	/*---------------------
+		methods
+	---------------------*/
+	// The MTrk chunk the track was read from, as it was in the file.
+	// Midi::save() copies it instead of encoding the events, unless dirty.
+	std::span<const byte>	get_source() const;
+	// Adding or removing events is seen, replacing one or changing it in
+	// place(set_..., delta_time) is not: mark the track dirty after those.
+	// A dirty track stays dirty, it is encoded on save.
+	bool					is_dirty() const;
+	void					mark_dirty();
+	// Where each event starts in get_source(), and where the last one ends,
+	// if the Midi was opened with keep_offsets. Empty once the track is dirty.
+	std::span<const uint32_t>	get_event_offsets() const;
+
+
+private:
+	friend class Midi;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::shared_ptr<const std::vector<byte>>	source; // the whole file
+	size_t					source_begin = 0;
+	size_t					source_end = 0;
+	size_t					source_count = 0; // events when read
+	bool					dirty = false;
+	std::vector<uint32_t>	event_offsets;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					set_source(
+		std::shared_ptr<const std::vector<byte>>	source,
+		size_t										begin,
+		size_t										end
+	);
 };
-}
\ No newline at end of file
+}
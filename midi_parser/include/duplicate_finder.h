@@ -0,0 +1,103 @@
+#pragma once
+#include "common.h"
+#include "fingerprint.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	DuplicateFinder
+
+##########################*/
+/*
+ * Clusters the files of a corpus that play the same notes.
+ *
+ *	exact group		files of equal Fingerprint hashes
+ *	cluster			files linked by signatures at least `threshold` alike,
+ *					exact duplicates included
+ *
+ * Only the hash and signature of a file are kept, hash_count * 4 bytes plus
+ * its path, so files are parsed in parallel and dropped as they come.
+ *
+ * Near duplicates are found by locality sensitive hashing: the signature is
+ * cut into bands, and files with an equal band are candidates. The bands are
+ * bucketed one at a time by sorting. In a bucket of up to
+ * pairwise_bucket_size files every pair of different clusters is compared,
+ * so two files of similarity s are linked with probability
+ * 1 - (1 - s^rows)^bands; the defaults, 16 bands of 4 rows, find 90% alike
+ * files almost always and 50% alike ones rarely. In a larger bucket, which
+ * alike files seldom make, a file is compared with one file of each cluster
+ * met in it, so time stays near O(files * bands * log files).
+ *
+ * Files without notes or that fail to parse are in no group or cluster but
+ * their own.
+*/
+class DuplicateFinder final
+{
+public:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr size_t	pairwise_bucket_size = 64;
+
+	/*---------------------
+		types
+	---------------------*/
+	struct Entry
+	{
+		std::filesystem::path	path;
+		std::string		error; // empty if read
+		uint64_t		hash = 0;
+		size_t			note_count = 0;
+		size_t			exact_group = 0; // the first entry of it
+		size_t			cluster = 0; // the first entry of it
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	// hash_count of the options must be a multiple of band_count
+	DuplicateFinder(
+		FingerprintOptions	options = {},
+		int					band_count = 16,
+		double				threshold = 0.8
+	);
+
+	/*---------------------
+		methods
+	---------------------*/
+	// a fingerprint made with the options of the finder, returns its entry
+	size_t					add(const Fingerprint& fingerprint, const std::filesystem::path& path = {});
+	// in parallel, a file that fails has its error
+	void					add_files(const std::vector<std::filesystem::path>& files);
+	void					clear();
+
+	// sets exact_group and cluster of every entry
+	void					run();
+	const std::vector<Entry>&	get_entries() const;
+	// entries of more than one file, by their first entry
+	std::vector<std::vector<size_t>>	get_clusters() const;
+
+	// a row per entry
+	void					save_csv(const std::filesystem::path& csv_path) const;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	FingerprintOptions		options;
+	int						band_count;
+	double					threshold;
+	std::vector<Entry>		entries;
+	std::vector<uint32_t>	signatures; // hash_count per entry
+
+	/*---------------------
+		methods
+	---------------------*/
+	const uint32_t*			get_signature(size_t entry) const;
+	bool					is_valid(size_t entry) const; // read, with notes
+};
+} // MidiParser
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace MidiParser {
 class Event
@@ -77,6 +78,10 @@ public:
 	static
 	Category				get_category(byte status);
 
+	// snake case, "note_on", "unknown" if it is none of the above
+	static
+	const char*				get_type_name(Type type);
+
 	virtual 
 	Category				get_category() const = 0;
 
@@ -92,8 +97,9 @@ public:
 	virtual 
 	std::ostream&			str(std::ostream& os) const;
 
-	// virtual
-	// std::ostream&			binary(std::ostream& os);
+	// appends the event as stored in a file, without delta time and status
+	virtual
+	void					binary(std::vector<byte>& output) const = 0;
 
 
 protected:
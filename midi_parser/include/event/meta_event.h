@@ -25,6 +25,9 @@ public:
 	virtual
 	std::ostream&		str(std::ostream& os) const override; // {return "";}
 
+	void				binary(std::vector<byte>& output) const override;
+	const std::vector<byte>&	get_data() const; // as stored in a file
+
 	static
 	std::shared_ptr<Event>	create(
 		uint64_t				delta_time,
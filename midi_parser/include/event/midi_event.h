@@ -36,6 +36,23 @@ public:
 	
 	virtual
 	uint32_t		get_binary() const = 0;
+
+	void			binary(std::vector<byte>& output) const override;
+
+	static inline
+	uint32_t		make_binary(int status, int data0 = 0, int data1 = 0)
+	{
+		if constexpr (std::endian::native == std::endian::little)
+			return 
+				(status & 0xff)       |
+				(data0  & 0xff) << 8  |
+				(data1  & 0xff) << 16 ;
+		else
+			return 
+				(status & 0xff) << 24 |
+				(data0  & 0xff) << 16 |
+				(data1  & 0xff) <<  8 ;
+	}
 	
 
 	static
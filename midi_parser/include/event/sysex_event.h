@@ -26,6 +26,9 @@ public:
 	virtual
 	std::ostream&	str(std::ostream& os) const override;
 
+	virtual
+	void			binary(std::vector<byte>& output) const override; // no data by default
+
 	Event::Category	get_category() const override;
 
 	static 
@@ -74,8 +77,10 @@ public:
 	Type				get_type() const override;
 	std::ostream&		str(std::ostream& os) const override;
 	std::vector<byte>	get_messages() const;
+	void				get_messages(std::vector<byte>& output) const; // appends
 	void				set_messages(const std::vector<byte>& messages);
 	void				set_messages(std::vector<byte>&& messages);
+	void				binary(std::vector<byte>& output) const override;
 	
 
 
@@ -110,6 +115,7 @@ public:
 	std::ostream&		str(std::ostream& os) const override;
 	int 				get_value() const;
 	void				set_value(int val);
+	void				binary(std::vector<byte>& output) const override;
 
 
 private:
@@ -146,6 +152,7 @@ public:
 	void 		get_position(byte& b0, byte& b1) const;
 	void		set_position(int val);
 	void	 	set_position(byte b0, byte b1);
+	void		binary(std::vector<byte>& output) const override;
 
 private:
 	/*---------------------
@@ -178,6 +185,7 @@ public:
 	std::ostream&		str(std::ostream& os) const override;
 	int 				get_song() const;
 	void	 			set_song(int song);
+	void				binary(std::vector<byte>& output) const override;
 
 private:
 	/*---------------------
@@ -226,12 +234,23 @@ public:
 	---------------------*/
 	EndOfSysexMessages() = default;
 	EndOfSysexMessages(uint64_t delta_time);
+	EndOfSysexMessages(uint64_t delta_time, std::vector<byte>&& messages) noexcept;
 
 	/*---------------------
 		methods
 	---------------------*/
 	Event::Type		get_type() const override;
 	std::ostream&		str(std::ostream& os) const override;
+	const std::vector<byte>&	get_messages() const; // escaped bytes, sent as they are
+	void			set_messages(std::vector<byte>&& messages);
+	void			binary(std::vector<byte>& output) const override;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	std::vector<byte>	messages;
 };
 
 
@@ -0,0 +1,138 @@
+#pragma once
+#include "common.h"
+#include "event_table.h"
+#include "midi.h"
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	EventIndex
+
+##########################*/
+/*
+ * Inverted index of the events of a Midi: for each key, the sorted numbers
+ * of the events that have it. An event is numbered as its row in an
+ * EventTable, the events of track 0 first, then track 1, ...
+ *
+ *	type			every event of an Event::Type
+ *	channel, type	midi events
+ *	channel, key	note offs, note ons and polyphonic key pressures
+ *
+ * A list is stored in blocks of 128 numbers: the first of each block in a
+ * skip table, the rest as varint deltas. Decoding is O(k), and intersection
+ * walks the shorter list and skips through the blocks of the longer one.
+ *
+ * The index is one image like EventTable's, saved next to the cache and
+ * mapped on load, so a search over a library reads only the lists it uses.
+ * The source file is stamped the same way: load_cached compares its size and
+ * time, and the checksum of its bytes is kept(get_source_checksum).
+*/
+class EventIndex final
+{
+public:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr size_t	block_size = 128;
+
+	/*---------------------
+		types
+	---------------------*/
+	// a compressed list, valid while its index is
+	class Postings
+	{
+	public:
+		size_t				size() const;
+		bool				empty() const;
+		void				decode(std::vector<uint32_t>& output) const; // appends
+		std::vector<uint32_t>	decode() const;
+
+
+	private:
+		friend class EventIndex;
+
+		const uint32_t*		firsts = nullptr; // of each block
+		const uint32_t*		offsets = nullptr; // of each block in data
+		const byte*			data = nullptr;
+		size_t				data_size = 0;
+		uint32_t			count = 0;
+
+		size_t				get_block_count() const;
+		// the numbers of a block into output, returns how many
+		size_t				decode_block(size_t block, uint32_t* output) const;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	EventIndex() = default;
+	EventIndex(const Midi& midi);
+	EventIndex(const EventTable& table);
+	EventIndex(const std::filesystem::path& index_path);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					build(const Midi& midi);
+	void					build(const EventTable& table); // the table knows its source
+	void					load(const std::filesystem::path& index_path); // maps the file
+	void					save(const std::filesystem::path& index_path) const;
+	void					clear();
+
+	// Loads the index if it was made from the file as it is now(size and time),
+	// otherwise parses the file and rewrites the index.
+	static
+	EventIndex				load_cached(
+		const std::filesystem::path&	midi_path,
+		const std::filesystem::path&	index_path
+	);
+
+	size_t					size() const; // events
+	bool					empty() const;
+	int						get_track_count() const;
+	size_t					get_track_begin(int track) const;
+	size_t					get_track_end(int track) const;
+	// the track of an event and its index in the track
+	void					locate(uint32_t event, int& track, size_t& index) const;
+	uint64_t				get_source_checksum() const;
+
+	// an empty list for keys no event has
+	Postings				find(Event::Type type) const;
+	Postings				find(int channel, Event::Type type) const;
+	Postings				find_key(int channel, int key) const;
+
+	static
+	std::vector<uint32_t>	intersect(const Postings& a, const Postings& b);
+	// events sorted, as from another intersection
+	static
+	std::vector<uint32_t>	intersect(std::span<const uint32_t> events, const Postings& postings);
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Header;
+	struct Key;
+	class Builder;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::shared_ptr<const void>	owner; // keeps the image alive
+	const Header*			header = nullptr;
+	const uint64_t*			track_offsets = nullptr;
+	const Key*				keys = nullptr;
+	const byte*				data = nullptr;
+
+	/*---------------------
+		methods
+	---------------------*/
+	Postings				find(uint32_t key) const;
+	void					attach(std::shared_ptr<const void> owner, const byte* image, size_t size);
+};
+} // MidiParser
@@ -0,0 +1,173 @@
+#pragma once
+#include "common.h"
+#include "event_table.h"
+#include <bit>
+#include <span>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	Selection
+
+##########################*/
+/*
+ * A set of rows of an EventTable, a bit per row.
+ * Bits past size() are always 0, so words can be combined as they are.
+*/
+class Selection final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	Selection() = default;
+	Selection(size_t size, bool value = false);
+	Selection(size_t size, std::span<const uint32_t> rows); // as from EventIndex
+
+	/*---------------------
+		methods
+	---------------------*/
+	size_t				size() const; // rows of the table
+	size_t				count() const; // rows selected
+	bool				test(size_t row) const;
+	void				set(size_t row, bool value = true);
+	std::vector<uint32_t>	get_rows() const;
+	std::span<const uint64_t>	get_words() const;
+	std::span<uint64_t>	get_words();
+
+	// function(row) for each selected row, in order
+	template <typename Function>
+	void				for_each(const Function& function) const
+	{
+		for (size_t word = 0; word < words.size(); ++word)
+		{
+			for (uint64_t bits = words[word]; bits; bits &= bits - 1)
+				function(word * 64 + std::countr_zero(bits));
+		}
+	}
+
+	/*---------------------
+		operators
+	---------------------*/
+	Selection&			operator&=(const Selection& other);
+	Selection&			operator|=(const Selection& other);
+	Selection&			operator^=(const Selection& other);
+	Selection			operator~() const;
+	friend Selection	operator&(Selection a, const Selection& b) { return a &= b; }
+	friend Selection	operator|(Selection a, const Selection& b) { return a |= b; }
+	friend Selection	operator^(Selection a, const Selection& b) { return a ^= b; }
+	bool				operator==(const Selection& other) const = default;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	size_t				length = 0;
+	std::vector<uint64_t>	words;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				check_size(const Selection& other) const;
+	void				clear_tail(); // the bits past length
+};
+
+
+
+
+/*##########################
+
+	EventQuery
+
+##########################*/
+/*
+ * A filter over the columns of an EventTable, built by narrowing:
+ *
+ *	EventQuery().type(Event::NOTE_ON).channel(0, 3).data1(91, 127).bars(10, 20)
+ *
+ * Ranges are inclusive, except ticks and time which end before `last`.
+ * Calling a method again narrows the range further.
+ *
+ * select() compiles the query for the table into range tests on single
+ * columns, a type and its channels folding into one range of status bytes,
+ * bars into ticks by the measure map of the table. The tests run over blocks
+ * of rows: a plain loop of compares into a byte per row, which the compiler
+ * vectorizes, packed into 64 bit words and and-ed, skipping words already 0.
+ * Blocks are shared among threads.
+*/
+class EventQuery final
+{
+public:
+	/*---------------------
+		methods
+	---------------------*/
+	EventQuery&			type(Event::Type type);
+	EventQuery&			channel(int first, int last); // midi events only
+	EventQuery&			channel(int channel);
+	EventQuery&			data0(int first, int last); // the key of notes
+	EventQuery&			data1(int first, int last); // the velocity of notes
+	EventQuery&			track(int first, int last);
+	EventQuery&			ticks(uint64_t first, uint64_t last);
+	EventQuery&			time(Microseconds first, Microseconds last);
+	EventQuery&			bars(int64_t first, int64_t last); // from 0, as MeasureMap
+
+	Selection			select(const EventTable& table) const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	enum Column
+	{
+		STATUS,
+		TYPE,
+		DATA0,
+		DATA1,
+		TRACK,
+		TICK,
+		TIME,
+	};
+
+	struct Range
+	{
+		uint64_t		first;
+		uint64_t		last;
+	};
+
+	// value & mask in [first, last] for one column, in its unsigned bits
+	struct Term
+	{
+		Column			column;
+		uint64_t		mask;
+		uint64_t		first;
+		uint64_t		last;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	bool				typed = false;
+	Event::Type			event_type = Event::NOTE_OFF;
+	Range				channels = {0, 15};
+	Range				data0_range = {0, 255};
+	Range				data1_range = {0, 255};
+	Range				track_range = {0, UINT16_MAX};
+	Range				tick_range = {0, UINT64_MAX};
+	int64_t				time_first = INT64_MIN;
+	int64_t				time_last = INT64_MAX;
+	int64_t				bar_first = INT64_MIN;
+	int64_t				bar_last = INT64_MAX;
+	bool				none = false; // narrowed to nothing
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				narrow(Range& range, uint64_t first, uint64_t last);
+	std::vector<Term>	compile(const EventTable& table) const;
+	static
+	void				match(const EventTable& table, const Term& term, size_t begin, size_t end, uint64_t* words, bool first);
+};
+} // MidiParser
@@ -0,0 +1,130 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include "measure_map.h"
+#include "tempo_map.h"
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	EventTable
+
+##########################*/
+/*
+ * Every event of a Midi, decoded and timestamped, stored by column:
+ * one array per field, the events of track 0 first, then track 1, ...
+ *
+ *	tick		timestamp
+ *	time		us, by the tempo map
+ *	track		index of the track
+ *	status		status byte: 0x8n..0xen for midi, 0xff for meta, 0xf0..0xfe for sysex
+ *	type		Event::Type
+ *	data0/1		midi data bytes, MTC value, song position(lsb, msb), song number
+ *	payload		meta data or sysex messages, empty for the others
+ *
+ * The table is one contiguous image: a header, then aligned sections found
+ * by their offsets from the start. It is saved as is, and loading maps the
+ * file and points the columns into it, so there is no work per event and
+ * a hit costs the same for any file size.
+ * The image is in native byte order, the cache is not meant to move between
+ * machines. The source file is identified by size, modification time and
+ * a checksum of its bytes.
+ *
+ * Copies share the image.
+*/
+class EventTable final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	EventTable() = default;
+	EventTable(const Midi& midi);
+	EventTable(const std::filesystem::path& cache_path);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					build(const Midi& midi);
+	void					load(const std::filesystem::path& cache_path); // maps the file
+	void					save(const std::filesystem::path& cache_path) const;
+	void					clear();
+
+	// Loads the cache if it was made from the file as it is now(size and time),
+	// otherwise parses the file and rewrites the cache.
+	static
+	EventTable				load_cached(
+		const std::filesystem::path&	midi_path,
+		const std::filesystem::path&	cache_path
+	);
+	// the columns of one event, the payload is appended
+	static
+	void					decode(
+		const Event&			event,
+		byte&					data0,
+		byte&					data1,
+		std::vector<byte>&		payload
+	);
+	// compares the checksum with the file, reading all of it
+	bool					verify(const std::filesystem::path& midi_path) const;
+
+	size_t					size() const;
+	bool					empty() const;
+	int						get_track_count() const;
+	size_t					get_track_begin(int track) const; // index of its first event
+	size_t					get_track_end(int track) const;
+	Midi::Format			get_format() const;
+	Division				get_division() const;
+	TempoMap				get_tempo_map() const;
+	MeasureMap				get_measure_map() const;
+	uint64_t				get_source_size() const;
+	int64_t					get_source_time() const;
+	uint64_t				get_source_checksum() const;
+
+	std::span<const uint64_t>	get_ticks() const;
+	std::span<const int64_t>	get_times() const;
+	std::span<const uint16_t>	get_tracks() const;
+	std::span<const byte>		get_statuses() const;
+	std::span<const byte>		get_types() const;
+	std::span<const byte>		get_data0() const;
+	std::span<const byte>		get_data1() const;
+	std::span<const byte>		get_payload(size_t event) const;
+	// the payload of event i is [offsets[i], offsets[i + 1]) of get_payloads()
+	std::span<const uint32_t>	get_payload_offsets() const;
+	std::span<const byte>		get_payloads() const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Header;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::shared_ptr<const void>	owner; // keeps the image alive
+	const Header*			header = nullptr;
+	const uint64_t*			track_offsets = nullptr;
+	const uint64_t*			ticks = nullptr;
+	const int64_t*			times = nullptr;
+	const uint16_t*			tracks = nullptr;
+	const byte*				statuses = nullptr;
+	const byte*				types = nullptr;
+	const byte*				data0 = nullptr;
+	const byte*				data1 = nullptr;
+	const uint32_t*			payload_offsets = nullptr;
+	const byte*				payload = nullptr;
+	const TempoMap::Segment*	tempo_segments = nullptr;
+	const MeasureMap::Segment*	measure_segments = nullptr;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					attach(std::shared_ptr<const void> owner, const byte* image, size_t size);
+};
+} // MidiParser
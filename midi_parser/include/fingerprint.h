@@ -0,0 +1,89 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include "note_span.h"
+#include "tempo_map.h"
+#include <span>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	FingerprintOptions
+
+##########################*/
+struct FingerprintOptions
+{
+	// positions on the beat rather than the clock, so tempo changes do not count
+	bool			tempo_invariant = true;
+	// intervals between notes rather than keys
+	bool			transposition_invariant = false;
+	int				resolution = 12; // steps per quarter note, or per second on the clock
+	int				shingle_size = 4; // notes in a shingle
+	int				hash_count = 64; // of the signature
+};
+
+
+
+
+/*##########################
+
+	Fingerprint
+
+##########################*/
+/*
+ * What a Midi plays, whatever the tracks, channels, meta events, running
+ * status or tempo it was written with.
+ *
+ * The notes are quantized to the resolution and sorted by position, then
+ * key, ignoring track, channel and velocity; a note doubled on the same
+ * position and key counts once. Each note becomes a token of the steps
+ * since the previous note and its key, or its interval from the previous
+ * key when transposition invariant. Drums(channel 10) are told apart from
+ * the other notes and always keep their key, as transposing leaves them be.
+ *
+ *	hash		64 bits of the tokens and durations, equal for exact duplicates
+ *	signature	MinHash of the shingles(shingle_size tokens in a row), the
+ *				share of equal values estimates how much two files overlap
+ *
+ * The hash functions are fixed, so fingerprints can be stored and compared
+ * across runs with the same options.
+*/
+class Fingerprint final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	using Options = FingerprintOptions;
+
+	/*---------------------
+		constructors
+	---------------------*/
+	Fingerprint() = default;
+	Fingerprint(const Midi& midi, Options options = {});
+	// spans as NotePairer makes them, in any order
+	Fingerprint(std::span<const NoteSpan> spans, const TempoMap& tempo_map, Options options = {});
+
+	/*---------------------
+		methods
+	---------------------*/
+	uint64_t				get_hash() const;
+	const std::vector<uint32_t>&	get_signature() const;
+	size_t					get_note_count() const; // after doubled notes are dropped
+	// estimated Jaccard similarity of the shingles, 0 if the signatures differ in size
+	double					get_similarity(const Fingerprint& other) const;
+
+	static
+	double					get_similarity(std::span<const uint32_t> a, std::span<const uint32_t> b);
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	uint64_t				hash = 0;
+	std::vector<uint32_t>	signature;
+	size_t					note_count = 0;
+};
+} // MidiParser
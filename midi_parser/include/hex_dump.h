@@ -0,0 +1,75 @@
+#pragma once
+#include "common.h"
+#include "chunk.h"
+#include "midi.h"
+#include "text_dump.h"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	HexDump
+
+##########################*/
+/*
+ * Hex dump of a file as it was read, 16 bytes a line, with each chunk and
+ * each event starting a line annotated as Event::str() does:
+ *
+ *	00000000  4d 54 68 64 00 00 00 06  00 01 00 02 00 60        | MThd format 1, 2 tracks, division 96
+ *	0000000e  4d 54 72 6b 00 00 00 1c                           | MTrk track 0, 28 bytes
+ *	00000016  00 90 3c 64                                       |     0 [MIDI]           Note On | ...
+ *
+ * Events are found by the offsets a Midi keeps when opened with keep_offsets.
+ * Tracks without them, dirty tracks, unknown chunks and trailing bytes are
+ * dumped as bytes. Lines are formatted from tables into a reused buffer,
+ * and tracks in parallel.
+*/
+class HexDump final
+{
+public:
+	/*---------------------
+		methods
+	---------------------*/
+	// bytes and their ascii, address is that of the first byte
+	void				append(const byte* data, size_t size, uint64_t address = 0);
+	// the chunk of a track, address is that of the chunk in the file
+	void				append(const Track& track, int track_number, uint64_t address);
+	void				append_header(const Midi& midi);
+	const std::string&	get() const;
+	void				clear(); // keeps the capacity
+
+	// throws std::logic_error if the midi was not read from a file
+	static
+	std::string			str(const Midi& midi);
+	static
+	void				save(const Midi& midi, const std::filesystem::path& file_path);
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	std::string			buffer;
+	TextDump			text; // the annotation of an event
+
+	/*---------------------
+		methods
+	---------------------*/
+	// one line of up to 16 bytes, padded to the annotation
+	void				append_line(const byte* data, size_t size, uint64_t address);
+	// lines of 16 bytes, the note after the first
+	void				append_bytes(
+		const byte*				data,
+		size_t					size,
+		uint64_t				address,
+		std::string_view		note
+	);
+
+	// the header, then a buffer per chunk
+	static
+	std::vector<std::string>	dump(const Midi& midi);
+};
+} // MidiParser
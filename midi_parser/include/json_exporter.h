@@ -0,0 +1,148 @@
+#pragma once
+#include "common.h"
+#include "event_query.h"
+#include "event_table.h"
+#include "midi.h"
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	JsonExporter
+
+##########################*/
+/*
+ * Writes songs as JSON, one object per event, in track order:
+ *	{"track":0,"tick":0,"us":0,"type":"note_on","channel":0,"data":[60,100]}
+ *
+ *	data		midi data bytes, MTC value, song position(lsb, msb), song number
+ *	text		text meta events, each byte as one character(\u0080.. for 0x80..),
+ *				so the bytes are found again whatever their encoding was
+ *	payload		other meta and sysex contents, in hex
+ *
+ * NDJSON writes a line per song, {"type":"song","file":...,"format":1,
+ * "tracks":2,"division":480}, then a line per event.
+ * JSON writes an array of songs, each holding its "events".
+ *
+ * Text is formatted by hand into a buffer that is flushed when full, so
+ * memory is bounded by the buffer and nothing is allocated per event.
+ * A song can come from a Midi or from an EventTable, which may be a
+ * mapped cache file.
+*/
+class JsonExporter final
+{
+public:
+	/*---------------------
+		enumerations
+	---------------------*/
+	enum class Format
+	{
+		JSON,
+		NDJSON,
+	};
+
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr size_t		default_buffer_size = 1 << 16;
+
+	/*---------------------
+		constructors
+	---------------------*/
+	JsonExporter(
+		std::ostream&		output,
+		Format				format = Format::NDJSON,
+		size_t				buffer_size = default_buffer_size
+	);
+	~JsonExporter(); // finishes, ignoring errors
+	JsonExporter(const JsonExporter&) = delete;
+	JsonExporter& operator=(const JsonExporter&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				write(const Midi& midi, std::string_view file_name = {});
+	void				write(const EventTable& table, std::string_view file_name = {});
+	void				write(
+		const EventTable&	table,
+		const Selection&	selection, // rows of the table
+		std::string_view	file_name = {}
+	);
+	void				write_error(std::string_view file_name, std::string_view message);
+	void				finish(); // ends the JSON array and flushes
+
+	/*
+	 * Exports every .mid/.midi file under input_directory into shard_count
+	 * files in output_directory(shard-0000.ndjson, ...), the shards in parallel.
+	 * A file that fails to parse becomes an error object, {"type":"error",...}.
+	 * shard_count 0 means one per hardware thread.
+	*/
+	static
+	void				export_directory(
+		const std::filesystem::path&	input_directory,
+		const std::filesystem::path&	output_directory,
+		int								shard_count = 0,
+		Format							format = Format::NDJSON
+	);
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Item
+	{
+		uint64_t		tick;
+		int64_t			time;
+		int				track;
+		byte			status;
+		byte			type;
+		byte			data0;
+		byte			data1;
+		const byte*		payload;
+		size_t			payload_size;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	std::ostream&		output;
+	Format				format;
+	size_t				buffer_size;
+	std::string			buffer;
+	std::vector<byte>	scratch; // sysex messages of a Midi
+	size_t				song_count = 0;
+	bool				first_event = true;
+	bool				finished = false;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				begin_song(
+		std::string_view	file_name,
+		Midi::Format		midi_format,
+		int					track_count,
+		const Division&		division
+	);
+	void				end_song();
+	// for_each_row(function) calls function(row) for the rows to write
+	template <typename ForEachRow>
+	void				write_rows(
+		const EventTable&	table,
+		std::string_view	file_name,
+		const ForEachRow&	for_each_row
+	);
+	void				begin_object(); // separates songs and events
+	void				write_item(const Item& item);
+	void				append_number(int64_t value);
+	void				append_string(const byte* data, size_t size);
+	void				append_string(std::string_view str);
+	void				append_hex(const byte* data, size_t size);
+	void				flush_if_full();
+	void				flush();
+};
+} // MidiParser
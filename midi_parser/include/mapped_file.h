@@ -0,0 +1,49 @@
+#pragma once
+#include "common.h"
+#include <filesystem>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	MappedFile
+
+##########################*/
+/*
+ * A file mapped read only into memory, pages are read as they are touched.
+ * Where mmap is not available(Windows) the file is read at once instead.
+*/
+class MappedFile final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	MappedFile() = default;
+	MappedFile(const std::filesystem::path& file_path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				open(const std::filesystem::path& file_path);
+	void				close();
+	bool				is_open() const;
+	const byte*			data() const; // aligned to 8 bytes at least
+	size_t				size() const;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	const byte*			address = nullptr;
+	size_t				length = 0;
+	bool				opened = false;
+#ifdef _WIN32
+	std::vector<byte>	buffer;
+#endif
+};
+} // MidiParser
@@ -0,0 +1,96 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include "tempo_map.h"
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	MeasureMap
+
+##########################*/
+/*
+ * Mapping between ticks(timestamp) and bar:beat:tick.
+ * Built once per file from every TimeSignature event of every track.
+ * Bars and beats are counted from 0, like timestamps.
+ * A TimeSignature in the middle of a bar starts a new bar at its tick.
+*/
+class MeasureMap final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Position
+	{
+		int64_t			bar = 0;
+		int				beat = 0;
+		uint64_t		tick = 0; // ticks from the beat
+	};
+
+	struct Segment
+	{
+		uint64_t		tick;
+		int64_t			bar;
+		int				numerator;
+		int				denominator; // power of 2, same as TimeSignature
+		uint64_t		beat_length; // ticks
+		uint64_t		bar_length; // ticks
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	MeasureMap() = default;
+	MeasureMap(const Midi& midi);
+	MeasureMap(uint64_t ticks_per_quarter_note, std::vector<Segment> segments); // as built before
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					build(const Midi& midi);
+	Position				get_position(uint64_t tick) const;
+	int64_t					get_bar(uint64_t tick) const;
+	// a negative bar or beat counts as 0
+	uint64_t				get_tick(int64_t bar, int beat = 0, uint64_t tick = 0) const;
+	uint64_t				get_tick(const Position& position) const;
+	Microseconds			get_time(
+		const TempoMap&			tempo_map,
+		int64_t					bar,
+		int						beat = 0
+	) const;
+	const Segment&			get_segment(uint64_t tick) const;
+	const Segment&			get_bar_segment(int64_t bar) const;
+	const std::vector<Segment>&	get_segments() const;
+	uint64_t				get_ticks_per_quarter_note() const;
+
+	/*
+	 * Annotate events with bar numbers at once.
+	 * Sorted events (a track) cost O(n + segments), others O(n log segments).
+	*/
+	void					get_bars(
+		const std::vector<Event::ptr>&	events,
+		std::vector<int64_t>&			bars
+	) const;
+	std::vector<int64_t>	get_bars(const std::vector<Event::ptr>& events) const;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	std::vector<Segment>	segments;
+	uint64_t				ticks_per_quarter_note = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	Segment					make_segment(
+		uint64_t				tick,
+		int64_t					bar,
+		int						numerator,
+		int						denominator
+	) const;
+};
+} // MidiParser
@@ -0,0 +1,150 @@
+#pragma once
+#include "common.h"
+#include "note_span.h"
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	MelodyIndexOptions
+
+##########################*/
+struct MelodyIndexOptions
+{
+	int				gram_size = 4; // steps of a gram, so gram_size + 1 notes
+	size_t			batch_size = 1024; // files parsed before their grams are added
+};
+
+
+
+
+/*##########################
+
+	MelodyQuery
+
+##########################*/
+struct MelodyQuery
+{
+	bool			rhythm = true; // match rhythm ratios too, not only intervals
+	double			min_score = 0.7; // of the alignment, 1 for an exact match
+	size_t			max_candidates = 1000; // melodies aligned, by grams found
+	size_t			max_results = 100;
+};
+
+
+
+
+/*##########################
+
+	MelodyIndex
+
+##########################*/
+/*
+ * Finds the files of a library that contain a melody, whatever its key and
+ * tempo.
+ *
+ * The melody line of a track is its highest note at each onset, channel 10
+ * (drums) left out. It is stored as steps from note to note: the interval in
+ * semitones and the ratio of the time between the notes to the time before,
+ * rounded to a power of the square root of 2. A gram is gram_size steps in a row, its
+ * intervals alone or with the ratios inside it; for each gram the index has
+ * the sorted numbers of the melodies that have it, as varint deltas.
+ *
+ * search() takes the grams of the query, counts for each melody how many it
+ * has, then aligns the steps of the query with those of the best candidates,
+ * a wrong, missing or extra step costing 1 and a wrong ratio 0.5. The score
+ * is 1 - cost / steps of the query.
+ *
+ * build() parses the files in parallel, a batch at a time, and the index is
+ * one image, saved and mapped on load like EventIndex's. Files that fail to
+ * parse are kept with no melodies.
+*/
+class MelodyIndex final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	using Options = MelodyIndexOptions;
+
+	struct Match
+	{
+		uint32_t		file;
+		int				track;
+		uint32_t		note; // in the melody line of the track, where the match begins
+		uint32_t		length; // steps of the melody matched
+		double			score;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	MelodyIndex() = default;
+	MelodyIndex(const std::filesystem::path& index_path);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					build(const std::vector<std::filesystem::path>& files, Options options = {});
+	void					load(const std::filesystem::path& index_path); // maps the file
+	void					save(const std::filesystem::path& index_path) const;
+	void					clear();
+
+	size_t					get_file_count() const;
+	std::filesystem::path	get_file(uint32_t file) const;
+	size_t					get_melody_count() const;
+	int						get_gram_size() const;
+
+	// notes of the melody as NotePairer makes them, at least gram_size + 1 of
+	// the line; the best first
+	std::vector<Match>		search(std::span<const NoteSpan> notes, MelodyQuery query = {}) const;
+
+	// the highest note of each onset, without channel 10
+	static
+	std::vector<NoteSpan>	get_line(std::span<const NoteSpan> spans);
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Header;
+	struct FileEntry;
+	struct MelodyEntry;
+	struct Key;
+	struct Step;
+	class Builder;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::shared_ptr<const void>	owner; // keeps the image alive
+	const Header*			header = nullptr;
+	const FileEntry*		files = nullptr;
+	const MelodyEntry*		melodies = nullptr;
+	const Step*				steps = nullptr;
+	const Key*				keys = nullptr;
+	const byte*				data = nullptr;
+	const char*				paths = nullptr;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					attach(std::shared_ptr<const void> owner, const byte* image, size_t size);
+	// melodies that have a gram, appended
+	void					decode(uint64_t gram, std::vector<uint32_t>& output) const;
+
+	static
+	std::vector<Step>		get_steps(std::span<const NoteSpan> line);
+	// unique and sorted, of intervals alone(pitch) and with ratios(rhythm)
+	static
+	std::vector<uint64_t>	get_grams(std::span<const Step> steps, int gram_size, bool pitch, bool rhythm);
+	// the least cost of the query against a part of the melody, [begin, end) in it
+	static
+	uint32_t				align(std::span<const Step> query, std::span<const Step> melody, bool rhythm, uint32_t& begin, uint32_t& end);
+};
+} // MidiParser
@@ -15,6 +15,7 @@ Minchang Kim
 #include <filesystem>
 #include <sstream>
 #include <chrono>
+#include <span>
 
 namespace MidiParser{
 /*##########################
@@ -40,6 +41,10 @@ public:
 	std::string		to_string() const;
 	Microseconds	get_delta_time_duration(Microseconds quarter_note_duration) const;
 	Microseconds	get_delta_time_duration() const;
+	Type			get_type() const;
+	int				get_division() const;
+	int				get_frame_rate() const;
+	int				get_ticks() const;
 
 protected:
 	Type		type = QUARTER_NOTE;
@@ -77,29 +82,58 @@ public:
 		constructor
 	---------------------*/
 	Midi() = default;
-	Midi(const std::filesystem::path &file_path);
+	// keep_offsets records where each event is in the file, see Track
+	Midi(const std::filesystem::path &file_path, bool keep_offsets = false);
 
 	/*---------------------
 		methods
 	---------------------*/
-	void					open(const std::filesystem::path &file_path);
+	void					open(const std::filesystem::path &file_path, bool keep_offsets = false);
 	void					close();
 
 	Format					get_format() const;
+	void					set_format(Format format);
 	int						get_track_count() const;
 	std::ostream&			str(std::ostream& os) const;
 	std::string				str() const;
 	std::filesystem::path	get_file_path() const;
+	std::span<const byte>	get_source() const; // the file as read, if it was
+	// modification time of the file before it was read, as get_file_stamp()
+	int64_t					get_source_time() const;
 	void					save_str(const std::filesystem::path& file_path) const;
 	void					save_str() const;
+	// Standard MIDI File. Tracks whose events are as read(see Track) are
+	// copied as they were, along with unknown chunks; the others are encoded
+	// in parallel, and running_status applies to them.
+	void					save(
+		const std::filesystem::path&	file_path,
+		bool							running_status = true
+	) const;
 	void					update_timestamp();
 	int						event_count() const;
 
 private:
+	/*---------------------
+		types
+	---------------------*/
+	// a chunk other than MTrk, or bytes after the last track
+	struct RawChunk
+	{
+		size_t				track; // the index of the track it precedes
+		size_t				begin;
+		size_t				end;
+	};
+
 	/*---------------------
 		members
 	---------------------*/
 	std::filesystem::path	file_path;
+	Format					format = Format::MULTIPLE_TRACK;
+	std::shared_ptr<const std::vector<byte>>	source; // the file, shared with tracks
+	int64_t					source_time = 0;
+	size_t					header_size = 0;
+	std::vector<RawChunk>	raw_chunks;
+	std::vector<size_t>		track_origins; // where each track read began in source
 };
 
 } // MidiParser
\ No newline at end of file
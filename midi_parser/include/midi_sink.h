@@ -0,0 +1,143 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	MidiSink
+
+##########################*/
+/*
+ * Output device interface.
+ * Short messages are packed the same way as MidiEvent::get_binary().
+ * Sysex data is a complete message, from 0xf0 to 0xf7.
+*/
+class MidiSink
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	MidiSink() = default;
+	MidiSink(const MidiSink&) = delete;
+	MidiSink& operator=(const MidiSink&) = delete;
+	virtual ~MidiSink() = default;
+
+	/*---------------------
+		methods
+	---------------------*/
+	virtual
+	void			send(uint32_t message) = 0;
+
+	virtual
+	void			send(const uint32_t* messages, size_t count);
+
+	virtual
+	void			send_sysex(const byte* data, size_t size) = 0;
+
+	virtual
+	void			reset(); // all sound off, reset all controllers
+
+	static
+	size_t			get_message_length(int status);
+
+	static
+	size_t			unpack(uint32_t message, byte* bytes); // returns length, up to 3
+};
+
+
+
+
+/*##########################
+
+	NullSink
+
+##########################*/
+/*
+ * Discards everything, only counts. For benchmarks and headless machines.
+*/
+class NullSink final : public MidiSink
+{
+public:
+	/*---------------------
+		methods
+	---------------------*/
+	void			send(uint32_t message) override;
+	void			send(const uint32_t* messages, size_t count) override;
+	void			send_sysex(const byte* data, size_t size) override;
+	uint64_t		get_message_count() const;
+	uint64_t		get_sysex_count() const;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	std::atomic<uint64_t>	message_count = 0;
+	std::atomic<uint64_t>	sysex_count = 0;
+};
+
+
+
+
+/*##########################
+
+	RecordingSink
+
+##########################*/
+/*
+ * Keeps every message with the time it was sent, relative to the first one.
+ * Sysex data is kept in one buffer and referenced by offset.
+*/
+class RecordingSink final : public MidiSink
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Record
+	{
+		Microseconds	time;
+		uint32_t		message; // 0 for sysex
+		uint32_t		sysex_offset;
+		uint32_t		sysex_size;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	RecordingSink(size_t capacity = 0);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			send(uint32_t message) override;
+	void			send(const uint32_t* messages, size_t count) override;
+	void			send_sysex(const byte* data, size_t size) override;
+	void			clear();
+	std::vector<Record>	get_records() const;
+	std::vector<byte>	get_sysex(const Record& record) const;
+	void			save(const std::filesystem::path& file_path) const; // text, a line per record
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	mutable std::mutex		mutex;
+	bool					started = false;
+	Timepoint				start;
+	std::vector<Record>		records;
+	std::vector<byte>		sysex;
+
+	/*---------------------
+		methods
+	---------------------*/
+	Microseconds	elapsed(Timepoint now);
+};
+} // MidiParser
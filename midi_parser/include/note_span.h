@@ -0,0 +1,137 @@
+#pragma once
+#include "common.h"
+#include "chunk.h"
+#include "event_table.h"
+#include "midi.h"
+#include <array>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	NoteSpan
+
+##########################*/
+struct NoteSpan
+{
+	uint64_t		tick; // of the note on
+	uint64_t		duration; // in ticks
+	uint16_t		track;
+	byte			channel;
+	byte			key;
+	byte			velocity;
+	byte			off_velocity; // 0 if not ended by a NoteOff
+};
+
+
+
+
+/*##########################
+
+	NotePolicy
+
+##########################*/
+struct NotePolicy
+{
+	// a note on while the same key is already sounding
+	enum class Overlap
+	{
+		FIRST_IN_FIRST_OUT,	// a note off ends the oldest
+		LAST_IN_FIRST_OUT,	// a note off ends the newest
+		RETRIGGER,			// the note on ends the sounding ones
+	};
+	// a note on without a note off
+	enum class Dangling
+	{
+		CLOSE_AT_END,		// ends at the end of the track
+		DROP,
+	};
+
+	Overlap			overlap = Overlap::FIRST_IN_FIRST_OUT;
+	Dangling		dangling = Dangling::CLOSE_AT_END;
+};
+
+
+
+
+/*##########################
+
+	NotePairer
+
+##########################*/
+/*
+ * Pairs note ons with note offs(or note ons of velocity 0) in one pass.
+ * The notes sounding on each channel and key are a list through the spans
+ * themselves, heads and tails in fixed arrays, so a note costs O(1) and
+ * nothing is allocated per note.
+ *
+ * Spans are in the order of their note ons, which is by tick within a track.
+ * Merged spans of several tracks are by tick, then by track.
+*/
+class NotePairer final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	using Policy = NotePolicy;
+	using Overlap = NotePolicy::Overlap;
+	using Dangling = NotePolicy::Dangling;
+
+	/*---------------------
+		constructors
+	---------------------*/
+	NotePairer(Policy policy = {});
+
+	/*---------------------
+		methods
+	---------------------*/
+	// events of one track, in time order
+	void				reset(int track = 0); // keeps the capacity
+	void				note_on(uint64_t tick, int channel, int key, int velocity);
+	void				note_off(uint64_t tick, int channel, int key, int velocity);
+	void				apply(uint64_t tick, const Event& event); // others than notes are ignored
+	void				apply(uint64_t tick, int status, int data0, int data1);
+	void				finish(uint64_t end_tick); // dangling notes, by the policy
+	std::vector<NoteSpan>&	get_spans();
+	size_t				get_orphan_count() const; // note offs with nothing to end
+
+	static
+	std::vector<NoteSpan>	pair(const Track& track, int track_number = 0, Policy policy = {});
+	// tracks in parallel, merged
+	static
+	std::vector<NoteSpan>	pair(const Midi& midi, Policy policy = {});
+	static
+	std::vector<NoteSpan>	pair(const EventTable& table, Policy policy = {});
+	// tracks in parallel, a vector per track
+	static
+	std::vector<std::vector<NoteSpan>>	pair_tracks(const Midi& midi, Policy policy = {});
+
+
+private:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr uint32_t	none = UINT32_MAX;
+
+	/*---------------------
+		members
+	---------------------*/
+	Policy				policy;
+	int					track = 0;
+	std::vector<NoteSpan>	spans;
+	std::vector<uint32_t>	next; // the next sounding span of the same key
+	std::array<uint32_t, 16 * 128>	heads;
+	std::array<uint32_t, 16 * 128>	tails;
+	size_t				orphan_count = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				end(uint32_t span, uint64_t tick, int velocity);
+
+	// merges runs sorted by tick, begins[i] to begins[i + 1]
+	static
+	std::vector<NoteSpan>	merge(std::vector<NoteSpan> spans, std::vector<size_t> begins);
+};
+} // MidiParser
@@ -0,0 +1,88 @@
+#pragma once
+#include "common.h"
+#include "note_span.h"
+#include "tempo_map.h"
+#include <span>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	PianoRoll
+
+##########################*/
+/*
+ * Rasterizes note spans into planes of 128 keys by frames, key major:
+ * plane[key * frame_count + frame], so a note is one run of bytes in the
+ * row of its key, written with memset.
+ *
+ *	velocity	the velocity while the note sounds, the latest note on wins
+ *	onset		1 on the frame of the note on
+ *	sustain		1 while the note sounds
+ *
+ * A note covers frames [frame(tick), frame(tick + duration)), at least one.
+ * Frames are either ticks_per_frame ticks, or 1/frames_per_second seconds
+ * by the tempo map.
+ *
+ * The planes belong to the caller, render() overwrites the window of frames
+ * it is given. Rows of keys are rendered in parallel, the notes of a key
+ * from the latest, so every frame is written once however notes overlap.
+*/
+class PianoRoll final
+{
+public:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr int	key_count = 128;
+
+	/*---------------------
+		types
+	---------------------*/
+	struct Planes
+	{
+		byte*			velocity = nullptr; // key_count * frame_count bytes each,
+		byte*			onset = nullptr; // null to skip the plane
+		byte*			sustain = nullptr;
+		size_t			first_frame = 0; // the window
+		size_t			frame_count = 0;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	PianoRoll(uint64_t ticks_per_frame);
+	PianoRoll(const TempoMap& tempo_map, double frames_per_second);
+
+	/*---------------------
+		methods
+	---------------------*/
+	size_t				get_frame(uint64_t tick) const;
+	// frames up to the end of the last note
+	size_t				get_frame_count(std::span<const NoteSpan> spans) const;
+	void				render(std::span<const NoteSpan> spans, const Planes& planes) const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Range
+	{
+		size_t			begin;
+		size_t			end;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	uint64_t			ticks_per_frame = 0; // 0 for wall clock frames
+	TempoMap			tempo_map;
+	double				frames_per_us = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	Range				get_range(const NoteSpan& span) const;
+};
+} // MidiParser
@@ -0,0 +1,54 @@
+#pragma once
+#include "common.h"
+
+namespace MidiParser {
+/*##########################
+
+	PlaybackClock
+
+##########################*/
+/*
+ * Maps wall clock time to song time(us of the tempo map) under a tempo
+ * scale, 2 plays twice as fast.
+ * A new scale is reached linearly over a ramp, starting from the position
+ * and the speed at the moment of the change, so neither of them jumps.
+ * Changing the scale is O(1), both mappings are closed form.
+ *
+ * Not thread safe, players guard it with their own lock.
+*/
+class PlaybackClock final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	PlaybackClock(double scale = 1);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			reset(Timepoint wall, Microseconds song); // keeps the target scale
+	void			set_scale(Timepoint now, double scale, Microseconds ramp = Microseconds(0));
+	double			get_scale(Timepoint wall) const;
+	double			get_target_scale() const;
+	Microseconds	get_song_time(Timepoint wall) const; // rounded down
+	Timepoint		get_wall_time(Microseconds song) const; // rounded up
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	Timepoint		anchor_wall;
+	double			anchor_song = 0; // us at anchor_wall
+	double			from_scale;
+	double			to_scale;
+	double			ramp = 0; // us of wall time
+
+	/*---------------------
+		methods
+	---------------------*/
+	double			get_elapsed_song(double elapsed_wall) const; // us
+	double			get_elapsed_wall(double elapsed_song) const; // us
+};
+} // MidiParser
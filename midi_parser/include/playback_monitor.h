@@ -0,0 +1,72 @@
+#pragma once
+#include "common.h"
+#include <array>
+#include <ostream>
+#include <string>
+
+namespace MidiParser {
+/*##########################
+
+	PlaybackMonitor
+
+##########################*/
+/*
+ * Lateness of every message sent by Player, actual send time - deadline.
+ * Kept in a log-linear histogram(16 buckets per power of 2, ~6% error),
+ * so recording never allocates.
+ *
+ * record() and sender wakeups come from the sender thread,
+ * producer wakeups from the playing thread. Read it after play() returns.
+*/
+class PlaybackMonitor final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	typedef std::chrono::nanoseconds	Nanoseconds;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			reset();
+	void			record(Timepoint deadline, Timepoint sent, uint64_t count = 1);
+	void			add_sender_wakeup();
+	void			add_producer_wakeup();
+
+	uint64_t		get_count() const;
+	uint64_t		get_sender_wakeup_count() const;
+	uint64_t		get_producer_wakeup_count() const;
+	Nanoseconds		get_percentile(double percentile) const; // 0 ~ 100
+	Nanoseconds		get_max() const;
+	Nanoseconds		get_mean() const;
+	std::ostream&	str(std::ostream& os) const;
+
+
+private:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr int	sub_bucket_bits = 4;
+	static constexpr int	sub_bucket_count = 1 << sub_bucket_bits;
+	static constexpr int	bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::array<uint64_t, bucket_count>	histogram = {};
+	uint64_t				count = 0;
+	uint64_t				total = 0; // ns
+	uint64_t				max = 0; // ns
+	uint64_t				sender_wakeup_count = 0;
+	uint64_t				producer_wakeup_count = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	static
+	int				get_bucket(uint64_t value);
+	static
+	uint64_t		get_bucket_limit(int bucket); // largest value in the bucket
+};
+} // MidiParser
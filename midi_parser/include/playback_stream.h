@@ -0,0 +1,93 @@
+#pragma once
+#include "common.h"
+#include <filesystem>
+#include <vector>
+
+namespace MidiParser {
+class Midi;
+
+/*##########################
+
+	PlaybackStream
+
+##########################*/
+/*
+ * A Midi compiled for playback: every track merged, every tick resolved
+ * to microseconds by the tempo map, as one contiguous array of
+ * (time, packed short message) records.
+ * Sysex records point into an offset table over a single byte pool,
+ * each message starting with F0.
+ * Meta events are dropped, they are already in the times.
+ *
+ * The arrays are plain data, so the stream can be saved as a cache file
+ * and loaded back with a few reads.
+*/
+class PlaybackStream final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Record
+	{
+		int64_t			time; // us from the beginning
+		uint32_t		message; // same as MidiEvent::get_binary(), 0 for sysex
+		uint32_t		sysex; // index of the sysex, or no_sysex
+	};
+
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr uint32_t	no_sysex = 0xffffffff;
+
+	/*---------------------
+		constructors
+	---------------------*/
+	PlaybackStream() = default;
+	PlaybackStream(const Midi& midi);
+	PlaybackStream(const std::filesystem::path& cache_path);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					compile(const Midi& midi);
+	void					load(const std::filesystem::path& cache_path);
+	void					save(const std::filesystem::path& cache_path) const;
+	void					clear();
+
+	// Loads the cache if it was made from the file as it is now,
+	// otherwise parses and compiles the file, and rewrites the cache.
+	static
+	PlaybackStream			load_cached(
+		const std::filesystem::path&	midi_path,
+		const std::filesystem::path&	cache_path
+	);
+
+	const std::vector<Record>&	get_records() const;
+	size_t					size() const;
+	bool					empty() const;
+	size_t					find(Microseconds time) const; // first record at or after time
+	Microseconds			get_duration() const; // time of the last record
+	const byte*				get_sysex(uint32_t sysex) const;
+	uint32_t				get_sysex_size(uint32_t sysex) const;
+	size_t					get_sysex_count() const;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	std::vector<Record>		records;
+	std::vector<uint32_t>	sysex_offsets = {0}; // sysex i is [offsets[i], offsets[i + 1])
+	std::vector<byte>		sysex_data;
+
+	// identifies the source file in the cache
+	uint64_t				source_size = 0;
+	int64_t					source_time = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	bool					is_valid() const; // of a loaded cache
+};
+} // MidiParser
@@ -0,0 +1,130 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include "midi_sink.h"
+#include "playback_clock.h"
+#include "playback_monitor.h"
+#include "spsc_ring.h"
+#include "tempo_map.h"
+#include "track_merger.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace MidiParser {
+/*##########################
+
+	Player
+
+##########################*/
+/*
+ * Plays events of all tracks in time order.
+ * Deadlines are absolute, computed from the tempo map and the start time,
+ * so the player sleeps once per batch of events sharing a timestamp,
+ * instead of waking up every tick.
+ *
+ * play(sink) splits the work into two threads:
+ * - the calling thread prepares messages `lookahead` before their deadline,
+ *   and runs the callback, if any.
+ * - a sender thread waits for each deadline and writes to the sink.
+ *   It doesn't allocate, print or lock anything.
+ * They are connected by a SpscRing of (deadline, message). Sysex(F0) and
+ * escaped(F7) events go to send_sysex(), F0 data through a buffer per ring
+ * slot, reused, so memory stays the same however long the song.
+ *
+ * The tempo scale can be changed from any thread while playing.
+ * Deadlines not prepared yet follow the new scale at once, the ones
+ * already in the ring(at most `lookahead` ahead) keep the old one.
+ *
+ * The midi must outlive the player and must not be modified while playing.
+*/
+class Player final
+{
+public:
+	/*---------------------
+		typedef
+	---------------------*/
+	typedef std::function<void(const TrackMerger::Item& item)>	Callback;
+
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr size_t			default_buffer_size = 1024;
+	static constexpr Microseconds	default_lookahead = Microseconds(20000);
+
+	/*---------------------
+		constructors
+	---------------------*/
+	Player(const Midi& midi, size_t buffer_size = default_buffer_size);
+	Player(const Player&) = delete;
+	Player& operator=(const Player&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				play(const Callback& callback); // blocks until the end or stop()
+	void				play(MidiSink& sink, const Callback& callback = nullptr);
+	void				stop(); // thread safe
+	void				seek(uint64_t tick);
+	void				set_lookahead(Microseconds lookahead);
+	void				set_monitor(PlaybackMonitor* monitor); // nullptr to disable
+	void				set_tempo_scale(double scale, Microseconds ramp = Microseconds(0)); // thread safe
+	double				get_tempo_scale() const; // target scale, thread safe
+	uint64_t			get_position() const; // thread safe
+	bool				is_playing() const; // thread safe
+	uint64_t			get_overrun_count() const; // ring was full, thread safe
+	uint64_t			get_underrun_count() const; // message came after its deadline, thread safe
+	const TempoMap&		get_tempo_map() const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Message
+	{
+		Timepoint		deadline;
+		uint32_t		message;
+		uint32_t		sysex_size;
+		const byte*		sysex;
+	};
+
+	typedef std::function<void(const TrackMerger::Item& item, Timepoint deadline)>	Producer;
+
+	/*---------------------
+		members
+	---------------------*/
+	TempoMap				tempo_map;
+	TrackMerger				merger;
+	SpscRing<Message>		ring;
+	Microseconds			lookahead = default_lookahead;
+	PlaybackMonitor*		monitor = nullptr;
+	PlaybackClock			clock; // guarded by mutex
+	uint64_t				clock_version = 0; // guarded by mutex, wakes the producer up
+	std::atomic<uint64_t>	position = 0;
+	std::atomic<bool>		playing = false;
+	std::atomic<bool>		stopped = false;
+	std::atomic<bool>		producing = false;
+	std::atomic<uint32_t>	produced = 0; // sender waits on this while the ring is empty
+	std::atomic<uint64_t>	overrun_count = 0;
+	std::atomic<uint64_t>	underrun_count = 0;
+	mutable std::mutex		mutex;
+	std::condition_variable	condition;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				run(const Producer& producer, Microseconds lookahead);
+	void				push(const Message& message);
+	void				notify_sender();
+	void				send(MidiSink& sink);
+	void				send_batch(
+		MidiSink&			sink,
+		uint32_t*			batch,
+		size_t&				count,
+		Timepoint			deadline
+	);
+	bool				wait_until(Microseconds time, Microseconds lookahead, Timepoint& deadline);
+};
+} // MidiParser
@@ -0,0 +1,125 @@
+#pragma once
+#include "common.h"
+#include "midi_sink.h"
+#include "playback_clock.h"
+#include "playback_stream.h"
+#include "timer_wheel.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	SessionScheduler
+
+##########################*/
+/*
+ * Plays many PlaybackStreams at once from a few threads.
+ * Each session shares a read-only stream and has its own cursor,
+ * tempo scale and sink.
+ *
+ * Sessions are spread over the threads. Each thread keeps its sessions in
+ * a TimerWheel keyed by the time of their next record, sleeps until the
+ * first one is due, and sends every due record of each expired session
+ * to its sink as batches.
+ * Records are sent up to one resolution late, never early.
+ *
+ * Sinks are called from the scheduler threads,
+ * with the lock of the thread held; keep them fast.
+*/
+class SessionScheduler final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	typedef uint64_t	SessionId;
+
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr Microseconds	default_resolution = Microseconds(1000);
+
+	/*---------------------
+		constructors
+	---------------------*/
+	SessionScheduler(
+		size_t				thread_count = 1,
+		Microseconds		resolution = default_resolution
+	);
+	~SessionScheduler(); // stops every session
+	SessionScheduler(const SessionScheduler&) = delete;
+	SessionScheduler& operator=(const SessionScheduler&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	// all thread safe
+	// Starts playing right away, from the beginning of the stream.
+	SessionId			add(
+		std::shared_ptr<const PlaybackStream>	stream,
+		MidiSink&								sink,
+		double									tempo_scale = 1
+	);
+	void				remove(SessionId id); // the sink is not used after it returns
+	void				set_tempo_scale(
+		SessionId			id,
+		double				tempo_scale, // 2 is twice as fast
+		Microseconds		ramp = Microseconds(0)
+	);
+	Microseconds		get_position(SessionId id) const; // in stream time
+	bool				is_finished(SessionId id) const; // played to the end, or removed
+	size_t				get_session_count() const; // including finished ones
+	size_t				get_thread_count() const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Session: TimerWheel::Node
+	{
+		SessionId								id;
+		std::shared_ptr<const PlaybackStream>	stream;
+		MidiSink*								sink;
+		size_t									cursor = 0;
+		PlaybackClock							clock;
+		bool									finished = false;
+	};
+
+	struct Shard
+	{
+		TimerWheel											wheel;
+		std::unordered_map<SessionId, std::unique_ptr<Session>>	sessions;
+		std::vector<TimerWheel::Node*>						expired;
+		mutable std::mutex									mutex;
+		std::condition_variable								condition;
+		std::thread											thread;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	const Microseconds					resolution;
+	const Timepoint						epoch; // tick 0
+	std::vector<std::unique_ptr<Shard>>	shards;
+	std::atomic<SessionId>				next_id = 0;
+	std::atomic<bool>					stopped = false;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				run(Shard& shard);
+	void				play(Shard& shard, Session& session, Timepoint now);
+	void				schedule(Shard& shard, Session& session);
+	uint64_t			to_tick(Timepoint timepoint) const; // rounded up
+	Timepoint			to_timepoint(uint64_t tick) const;
+	Shard&				get_shard(SessionId id) const;
+	Session*			find(Shard& shard, SessionId id) const;
+};
+} // MidiParser
@@ -0,0 +1,56 @@
+#pragma once
+#include "common.h"
+#include "chunk.h"
+#include "midi.h"
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	SmfEncoder
+
+##########################*/
+/*
+ * Encodes events as they are stored in a Standard MIDI File:
+ * delta time, status, and Event::binary().
+ * With running status, the status of a midi event is left out while it
+ * repeats. Meta and sysex events cancel running status, as the spec says.
+*/
+class SmfEncoder final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	SmfEncoder(bool running_status = true);
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			encode(const Event& event, std::vector<byte>& output);
+	void			reset(); // at the start of every track
+
+	static
+	void			encode_header(
+		std::vector<byte>&		output,
+		Midi::Format			format,
+		int						track_count,
+		const Division&			division
+	);
+	// a whole MTrk chunk, EndOfTrack is added if the track lacks it
+	static
+	void			encode_track(
+		std::vector<byte>&		output,
+		const Track&			track,
+		bool					running_status = true
+	);
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	bool			running_status;
+	int				status = -1; // running status, -1 if none
+};
+} // MidiParser
@@ -0,0 +1,115 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include "smf_encoder.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	SmfWriter
+
+##########################*/
+/*
+ * Writes a Standard MIDI File event by event, without holding the tracks.
+ * Memory stays at about one buffer per track, whatever the size of the file.
+ *
+ * Writing to a file path, the lowest unfinished track goes straight to the
+ * file, and its MTrk length is patched when it ends. Events of later tracks
+ * wait in temporary spill files until their turn.
+ * Writing to a stream, which may not seek(a pipe), every track is spilled,
+ * and the file is written on close() when every length is known.
+ *
+ * EndOfTrack is added to each track on end_track() or close(),
+ * writing an EndOfTrack event ends its track as well.
+ * An event that would make a track longer than an MTrk length holds(4 GiB)
+ * throws length_error and is not written.
+*/
+class SmfWriter final
+{
+public:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr size_t		default_buffer_size = 1 << 16;
+
+	/*---------------------
+		constructors
+	---------------------*/
+	SmfWriter(
+		const std::filesystem::path&	file_path,
+		Midi::Format					format,
+		int								track_count,
+		const Division&					division,
+		bool							running_status = true,
+		size_t							buffer_size = default_buffer_size
+	);
+	SmfWriter(
+		std::ostream&					output,
+		Midi::Format					format,
+		int								track_count,
+		const Division&					division,
+		bool							running_status = true,
+		size_t							buffer_size = default_buffer_size
+	);
+	~SmfWriter(); // closes, ignoring errors
+	SmfWriter(const SmfWriter&) = delete;
+	SmfWriter& operator=(const SmfWriter&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			write(int track, const Event& event);
+	void			end_track(int track, uint64_t delta_time = 0);
+	void			close(); // ends every track
+	int				get_track_count() const;
+	bool			is_open() const;
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct TrackState
+	{
+		SmfEncoder			encoder;
+		std::vector<byte>	buffer;
+		std::FILE*			spill = nullptr;
+		uint64_t			spill_size = 0;
+		uint64_t			length = 0; // of the MTrk data, encoded so far
+		bool				ended = false;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	std::ofstream			file;
+	std::ostream*			output;
+	bool					seekable;
+	bool					open = true;
+	size_t					buffer_size;
+	std::vector<TrackState>	tracks;
+	Midi::Format			format;
+	Division				division;
+	int						current = 0; // track written straight to the file
+	std::streampos			current_begin; // after its MTrk length
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			init(int track_count, bool running_status);
+	TrackState&		get_track(int track);
+	void			encode(TrackState& state, const Event& event);
+	void			flush(int track);
+	void			begin_current();
+	void			end_current();
+	void			write_track(TrackState& state); // whole chunk, known length
+	void			copy_spill(TrackState& state);
+	void			write_output(const byte* data, size_t size);
+	void			close_spills();
+};
+} // MidiParser
@@ -0,0 +1,118 @@
+#pragma once
+#include "common.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	SpscRing
+
+##########################*/
+/*
+ * Wait-free ring buffer for exactly one producer thread and one consumer thread.
+ * Capacity is rounded up to a power of 2. Never allocates after construction.
+*/
+template <typename T>
+class SpscRing final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	SpscRing(size_t capacity):
+		buffer(std::bit_ceil(std::max<size_t>(capacity, 2))),
+		mask(buffer.size() - 1)
+	{}
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	/*---------------------
+		methods: producer
+	---------------------*/
+	bool			try_push(const T& value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - cached_head > mask)
+		{
+			cached_head = head.load(std::memory_order_acquire);
+			if (t - cached_head > mask)
+				return false;
+		}
+		buffer[t & mask] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*---------------------
+		methods: consumer
+	---------------------*/
+	const T*		front()
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == cached_tail)
+		{
+			cached_tail = tail.load(std::memory_order_acquire);
+			if (h == cached_tail)
+				return nullptr;
+		}
+		return &buffer[h & mask];
+	}
+
+	void			pop()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool			try_pop(T& value)
+	{
+		const T* item = front();
+		if (!item)
+			return false;
+		value = *item;
+		pop();
+		return true;
+	}
+
+	/*---------------------
+		methods: both
+	---------------------*/
+	size_t			size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	size_t			capacity() const
+	{
+		return buffer.size();
+	}
+
+	void			clear() // only while neither side is running
+	{
+		head = 0;
+		tail = 0;
+		cached_head = 0;
+		cached_tail = 0;
+	}
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	static constexpr size_t	cache_line = 64;
+
+	std::vector<T>			buffer;
+	const size_t			mask;
+	alignas(cache_line)
+	std::atomic<size_t>		head = 0; // written by consumer
+	size_t					cached_tail = 0; // consumer's copy of tail
+	alignas(cache_line)
+	std::atomic<size_t>		tail = 0; // written by producer
+	size_t					cached_head = 0; // producer's copy of head
+};
+} // MidiParser
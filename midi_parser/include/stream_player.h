@@ -0,0 +1,71 @@
+#pragma once
+#include "common.h"
+#include "midi_sink.h"
+#include "playback_clock.h"
+#include "playback_monitor.h"
+#include "playback_stream.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace MidiParser {
+/*##########################
+
+	StreamPlayer
+
+##########################*/
+/*
+ * Plays a PlaybackStream to a sink.
+ * Times are already resolved, so there is nothing to prepare ahead:
+ * the playing thread walks the records linearly, sleeps once per batch
+ * of records sharing a time, and sends the batch.
+ * The tempo scale can be changed from any thread while playing.
+ *
+ * The stream must outlive the player.
+*/
+class StreamPlayer final
+{
+public:
+	/*---------------------
+		constructors
+	---------------------*/
+	StreamPlayer(const PlaybackStream& stream);
+	StreamPlayer(const StreamPlayer&) = delete;
+	StreamPlayer& operator=(const StreamPlayer&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				play(MidiSink& sink); // blocks until the end or stop()
+	void				stop(); // thread safe
+	void				seek(Microseconds time);
+	void				set_monitor(PlaybackMonitor* monitor); // nullptr to disable
+	void				set_tempo_scale(double scale, Microseconds ramp = Microseconds(0)); // thread safe
+	double				get_tempo_scale() const; // target scale, thread safe
+	Microseconds		get_position() const; // thread safe
+	bool				is_playing() const; // thread safe
+	uint64_t			get_underrun_count() const; // thread safe
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	const PlaybackStream&	stream;
+	size_t					cursor = 0;
+	PlaybackMonitor*		monitor = nullptr;
+	PlaybackClock			clock; // guarded by mutex
+	uint64_t				clock_version = 0; // guarded by mutex
+	std::atomic<int64_t>	position = 0; // us
+	std::atomic<bool>		playing = false;
+	std::atomic<bool>		stopped = false;
+	std::atomic<uint64_t>	underrun_count = 0;
+	mutable std::mutex		mutex;
+	std::condition_variable	condition;
+
+	/*---------------------
+		methods
+	---------------------*/
+	bool				wait_until(Microseconds time, Timepoint& deadline);
+};
+} // MidiParser
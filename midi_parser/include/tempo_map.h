@@ -0,0 +1,68 @@
+#pragma once
+#include "common.h"
+#include "midi.h"
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	TempoMap
+
+##########################*/
+/*
+ * Piecewise linear mapping between ticks(timestamp) and microseconds.
+ * Built once per file from every SetTempo event of every track.
+ * Lookups are binary searches over the tempo segments.
+*/
+class TempoMap final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Segment
+	{
+		uint64_t		tick;
+		int64_t			time; // us at tick
+		int64_t			quarter_note_duration; // us
+	};
+
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr
+	int64_t				default_quarter_note_duration = 500000; // 120 bpm
+
+	/*---------------------
+		constructors
+	---------------------*/
+	TempoMap() = default;
+	TempoMap(const Midi& midi);
+	TempoMap(const Division& division, std::vector<Segment> segments); // as built before
+
+	/*---------------------
+		methods
+	---------------------*/
+	void					build(const Midi& midi);
+	Microseconds			get_time(uint64_t tick) const;
+	uint64_t				get_tick(Microseconds time) const;
+	Microseconds			get_quarter_note_duration(uint64_t tick) const;
+	const Segment&			get_segment(uint64_t tick) const;
+	const std::vector<Segment>&	get_segments() const;
+	const Division&			get_division() const;
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	Division				division;
+	std::vector<Segment>	segments = {{0, 0, default_quarter_note_duration}};
+
+	/*---------------------
+		methods
+	---------------------*/
+	int64_t					ticks_to_time(int64_t quarter_note_duration, uint64_t ticks) const;
+	uint64_t				time_to_ticks(int64_t quarter_note_duration, int64_t time) const;
+};
+} // MidiParser
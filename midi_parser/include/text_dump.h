@@ -0,0 +1,59 @@
+#pragma once
+#include "common.h"
+#include "chunk.h"
+#include "midi.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	TextDump
+
+##########################*/
+/*
+ * Formats events as Event::str() and Midi::str() do, character for character,
+ * without streams: numbers go through std::to_chars, names come from tables
+ * padded once, and everything is appended to a buffer that is reused.
+ *
+ * Midi::str() and Midi::save_str() use it. Tracks are formatted in parallel,
+ * and save() writes the header and the tracks with one vectored write.
+*/
+class TextDump final
+{
+public:
+	/*---------------------
+		methods
+	---------------------*/
+	void				append(const Event& event); // as Event::str()
+	void				append(const Track& track, int track_number);
+	void				append_header(const Midi& midi);
+	const std::string&	get() const;
+	void				clear(); // keeps the capacity
+
+	static
+	std::string			str(const Midi& midi);
+	static
+	void				save(const Midi& midi, const std::filesystem::path& file_path);
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	std::string			buffer;
+	std::vector<byte>	scratch; // sysex messages
+
+	/*---------------------
+		methods
+	---------------------*/
+	void				append_number(int64_t value, int width = 0);
+	void				append_unsigned(uint64_t value, int width = 0);
+	void				append_hex(const byte* begin, const byte* end); // as hex_dump()
+
+	// the header, then a buffer per track
+	static
+	std::vector<std::string>	dump(const Midi& midi);
+};
+} // MidiParser
@@ -0,0 +1,112 @@
+#pragma once
+#include "common.h"
+#include "event_table.h"
+#include "midi.h"
+#include <array>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	TimelineStats
+
+##########################*/
+/*
+ * Load of a file on the wall clock, for the whole file and for windows of
+ * a fixed length: polyphony, notes and controllers per second, and the most
+ * events sent in one millisecond.
+ *
+ * One sweep over the events of all tracks in time order. Sounding notes are
+ * counted per channel and key, and the polyphony is taken once all events of
+ * a time are applied, so a note off and a note on at the same time do not
+ * add up. Meta events are not sent and are not counted as events.
+ *
+ * A table is swept through its columns, the tracks merged by a heap of
+ * cursors, which costs O(log tracks) only where tracks interleave.
+*/
+class TimelineStats final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Window
+	{
+		int64_t			begin = 0; // us
+		int64_t			end = 0;
+		uint32_t		max_polyphony = 0;
+		double			mean_polyphony = 0; // over the time of the window
+		uint64_t		note_count = 0; // note ons
+		uint64_t		controller_count = 0;
+		uint64_t		event_count = 0; // midi and sysex
+		uint32_t		peak_events_per_ms = 0;
+		double			notes_per_second = 0;
+		double			controllers_per_second = 0;
+	};
+
+	struct FileStats
+	{
+		std::filesystem::path	path;
+		std::string		error; // empty if read
+		Window			total;
+		std::vector<Window>	windows;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	TimelineStats(Microseconds window_size = {}); // 0 for the total only
+
+	/*---------------------
+		methods
+	---------------------*/
+	// events of all tracks, in time order
+	void					reset();
+	void					apply(int64_t time, int status, int data0, int data1);
+	void					finish(int64_t end_time); // the end of the file, notes still on sound until it
+	const Window&			get_total() const;
+	const std::vector<Window>&	get_windows() const;
+
+	static
+	TimelineStats			measure(const EventTable& table, Microseconds window_size = {});
+	static
+	TimelineStats			measure(const Midi& midi, Microseconds window_size = {});
+	// in parallel, a file that fails has its error and no stats
+	static
+	std::vector<FileStats>	measure_files(
+		const std::vector<std::filesystem::path>&	files,
+		Microseconds								window_size = {}
+	);
+	// a row per file, then a row per window of it
+	static
+	void					save_csv(
+		const std::vector<FileStats>&	stats,
+		const std::filesystem::path&	csv_path
+	);
+
+
+private:
+	/*---------------------
+		members
+	---------------------*/
+	int64_t					window_size;
+	Window					total;
+	std::vector<Window>		windows;
+	std::array<uint16_t, 16 * 128>	sounding; // notes on per channel and key
+	uint32_t				polyphony = 0;
+	int64_t					time = 0; // of the events being applied
+	int64_t					millisecond = 0; // being counted
+	uint32_t				millisecond_events = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	Window&					get_window(int64_t time);
+	void					advance(int64_t time); // holds the polyphony until time
+	void					count_millisecond();
+	static
+	void					complete(Window& window);
+};
+} // MidiParser
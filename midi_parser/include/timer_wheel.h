@@ -0,0 +1,84 @@
+#pragma once
+#include "common.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace MidiParser {
+/*##########################
+
+	TimerWheel
+
+##########################*/
+/*
+ * Hierarchical timing wheel over integer ticks.
+ * 4 levels of 64 slots each, so insert and remove are O(1),
+ * and an expiring node is moved down at most 3 times.
+ * Ticks further than 64^4 ahead wait in the last level until they come in range.
+ *
+ * Nodes are intrusive, owned by the caller, and must stay put
+ * while they are in the wheel. Not thread safe.
+*/
+class TimerWheel final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Node
+	{
+		Node*			prev = nullptr;
+		Node*			next = nullptr;
+		uint64_t		tick = 0;
+		int				slot = -1; // level * slot_count + index, -1 if not in the wheel
+	};
+
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr uint64_t	no_expiry = ~uint64_t(0);
+
+	/*---------------------
+		constructors
+	---------------------*/
+	TimerWheel(uint64_t current = 0);
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			insert(Node* node, uint64_t tick); // past ticks expire on the next advance
+	void			remove(Node* node); // no-op if not in the wheel
+	void			advance(uint64_t tick, std::vector<Node*>& expired); // expires every node up to tick
+	uint64_t		get_next_expiry() const; // a tick no later than the first expiry, or no_expiry
+	uint64_t		get_current() const; // next tick to process
+	size_t			size() const;
+	bool			empty() const;
+
+
+private:
+	/*---------------------
+		constants
+	---------------------*/
+	static constexpr int		slot_bits = 6;
+	static constexpr int		slot_count = 1 << slot_bits;
+	static constexpr uint64_t	slot_mask = slot_count - 1;
+	static constexpr int		level_count = 4;
+
+	/*---------------------
+		members
+	---------------------*/
+	std::array<Node, level_count * slot_count>	slots; // circular list heads
+	uint64_t				occupied = 0; // bit per level 0 slot
+	uint64_t				current;
+	size_t					count = 0;
+
+	/*---------------------
+		methods
+	---------------------*/
+	void			link(Node* node);
+	void			unlink(Node* node);
+	int				cascade(int level); // returns the index of the cascaded slot
+};
+} // MidiParser
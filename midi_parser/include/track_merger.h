@@ -0,0 +1,101 @@
+#pragma once
+#include "common.h"
+#include "chunk.h"
+#include <vector>
+#include <cstddef>
+#include <iterator>
+
+namespace MidiParser {
+class Midi;
+
+/*##########################
+
+	TrackMerger
+
+##########################*/
+/*
+ * Iterates the events of all tracks in global time order.
+ * Events at the same timestamp come in order of track index, then event index.
+ * Keeps one cursor per track in a min heap, so next() costs O(log tracks).
+ *
+ * Tracks must outlive the merger and must not be modified while merging.
+*/
+class TrackMerger final
+{
+public:
+	/*---------------------
+		types
+	---------------------*/
+	struct Item
+	{
+		int				track;
+		size_t			index;
+		const Event*	event;
+	};
+
+	class iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = Item;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Item*;
+		using reference = const Item&;
+
+		iterator() = default;
+		iterator(TrackMerger* merger);
+
+		reference	operator*() const;
+		pointer		operator->() const;
+		iterator&	operator++();
+		void		operator++(int);
+		bool		operator==(const iterator& other) const;
+
+	private:
+		TrackMerger*	merger = nullptr;
+		Item			item;
+	};
+
+	/*---------------------
+		constructors
+	---------------------*/
+	TrackMerger(const Midi& midi);
+	TrackMerger(const std::vector<Track>& tracks);
+
+	/*---------------------
+		methods
+	---------------------*/
+	bool			empty() const;
+	const Item&		peek() const;
+	Item			next();
+	uint64_t		get_timestamp() const; // of the next event
+	void			seek(uint64_t tick); // to the first event at or after tick
+	void			reset();
+	iterator		begin();
+	iterator		end();
+
+
+private:
+	/*---------------------
+		types
+	---------------------*/
+	struct Cursor
+	{
+		uint64_t		timestamp;
+		Item			item;
+	};
+
+	/*---------------------
+		members
+	---------------------*/
+	const std::vector<Track>*	tracks;
+	std::vector<Cursor>			heap;
+
+	/*---------------------
+		methods
+	---------------------*/
+	static
+	bool			greater(const Cursor& a, const Cursor& b);
+	void			push(int track, size_t index);
+};
+} // MidiParser
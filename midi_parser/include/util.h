@@ -1,12 +1,19 @@
 #pragma once
 #include "common.h"
 #include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <fstream>
 #include <chrono>
 #include <thread>
+#include <span>
 
 namespace MidiParser {
 /*##########################
@@ -80,6 +87,108 @@ uint64_t	read_variable(const byte*& begin, const byte* end)
 	while (*begin++ & 0x80);
 	return result;
 }
+//------------------------------------------------------------------------------
+inline
+void		write1(std::vector<byte>& output, byte value)
+{
+	output.push_back(value);
+}
+//------------------------------------------------------------------------------
+inline
+void		write2(std::vector<byte>& output, uint16_t value)
+{
+	output.push_back(static_cast<byte>(value >> 8));
+	output.push_back(static_cast<byte>(value));
+}
+//------------------------------------------------------------------------------
+inline
+void		write4(std::vector<byte>& output, uint32_t value)
+{
+	output.push_back(static_cast<byte>(value >> 24));
+	output.push_back(static_cast<byte>(value >> 16));
+	output.push_back(static_cast<byte>(value >> 8));
+	output.push_back(static_cast<byte>(value));
+}
+//------------------------------------------------------------------------------
+inline
+void		write_variable(std::vector<byte>& output, uint64_t value)
+{
+	byte buffer[10];
+	int length = 0;
+	do
+	{
+		buffer[length++] = value & 0x7f;
+		value >>= 7;
+	}
+	while (value);
+	while (length > 1)
+		output.push_back(buffer[--length] | 0x80);
+	output.push_back(buffer[0]);
+}
+//------------------------------------------------------------------------------
+// 64 bit FNV-1a, continue a hash by passing it as seed
+inline
+uint64_t	hash_bytes(const byte* data, size_t size, uint64_t seed = 0xcbf29ce484222325)
+{
+	for (size_t i = 0; i < size; ++i)
+		seed = (seed ^ data[i]) * 0x100000001b3;
+	return seed;
+}
+//------------------------------------------------------------------------------
+// set on the threads of a parallel_for while they work
+inline thread_local
+bool		in_parallel_for = false;
+//------------------------------------------------------------------------------
+// Calls function(i) for i in [0, count) on up to hardware_concurrency threads.
+// The first exception thrown is rethrown after every thread is done.
+// Called from inside another parallel_for, it runs on the calling thread, so
+// nested loops do not start threads per item.
+template <typename Function> inline
+void		parallel_for(size_t count, const Function& function)
+{
+	size_t thread_count = std::min<size_t>(
+		count, std::max(std::thread::hardware_concurrency(), 1u)
+	);
+	if (thread_count <= 1 || in_parallel_for)
+	{
+		for (size_t i = 0; i < count; ++i)
+			function(i);
+		return;
+	}
+
+	std::atomic<size_t> next = 0;
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	auto work = [&]
+	{
+		in_parallel_for = true;
+		for (size_t i; (i = next++) < count;)
+		{
+			try
+			{
+				function(i);
+			}
+			catch (...)
+			{
+				std::lock_guard lock(error_mutex);
+				if (!error)
+					error = std::current_exception();
+				next = count;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count - 1);
+	for (size_t i = 1; i < thread_count; ++i)
+		threads.emplace_back(work);
+	work();
+	in_parallel_for = false;
+	for (auto& thread: threads)
+		thread.join();
+	if (error)
+		std::rethrow_exception(error);
+}
 // //------------------------------------------------------------------------------
 // template <typename T> inline
 // T			clamp(T val, T edge0, T edge1)
@@ -101,14 +210,44 @@ uint64_t	read_variable(const byte*& begin, const byte* end)
 ##########################*/
 std::vector<byte>	read_bin_file(const std::filesystem::path& file_path);
 std::string			read_file(const std::filesystem::path& file_path);
+// size and modification time, to tell whether a cache is still fresh
+void				get_file_stamp(
+	const std::filesystem::path&	file_path,
+	uint64_t&						size,
+	int64_t&						time
+);
+// the text as a quoted CSV field, quotes doubled
+void							append_csv(std::string& output, std::string_view text);
+// .mid and .midi files under the directory, recursively, sorted
+std::vector<std::filesystem::path>	find_midi_files(const std::filesystem::path& directory);
 void							write_bin_file(
 	const std::filesystem::path&	file_path, 
 	const std::vector<byte>&		data
 );
+// Writes the buffers one after another, with vectored writes where available.
+void							write_bin_file(
+	const std::filesystem::path&			file_path,
+	const std::vector<std::vector<byte>>&	buffers
+);
+void							write_bin_file(
+	const std::filesystem::path&				file_path,
+	const std::vector<std::span<const byte>>&	buffers
+);
+// Writes a file beside and renames it over the path, so whoever has the old
+// file open or mapped keeps reading the old bytes.
+void							replace_bin_file(
+	const std::filesystem::path&	file_path,
+	std::span<const byte>			data
+);
 void							write_file(
 	const std::filesystem::path&	file_path, 
 	const std::string&				data
 );
+// Writes the buffers one after another, as text.
+void							write_file(
+	const std::filesystem::path&	file_path,
+	const std::vector<std::string>&	buffers
+);
 // std::string						hex_dump(
 // 	const byte*						begin,
 // 	const byte*						end, 
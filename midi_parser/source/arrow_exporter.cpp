@@ -0,0 +1,314 @@
+#include "arrow_exporter.h"
+#include "util.h"
+#include <array>
+#include <climits>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	Types
+
+##########################*/
+namespace {
+// the order of the type dictionary, "unknown" follows
+constexpr Event::Type	types[] = {
+	Event::NOTE_OFF,
+	Event::NOTE_ON,
+	Event::POLYPHONIC_KEY_PRESSURE,
+	Event::CONTROL_CHANGE,
+	Event::PROGRAM_CHANGE,
+	Event::CHANNEL_PRESSURE,
+	Event::PITCH_BEND,
+	Event::SEQUENCE_NUMBER,
+	Event::USER_TEXT,
+	Event::COPY_RIGHT,
+	Event::TRACK_NAME,
+	Event::INSTRUMENT_NAME,
+	Event::LYRIC,
+	Event::MARKER,
+	Event::CUE_POINT,
+	Event::CHANNEL_PREFIX,
+	Event::MIDI_PORT,
+	Event::END_OF_TRACK,
+	Event::SET_TEMPO,
+	Event::SMPTE_OFFSET,
+	Event::TIME_SIGNATURE,
+	Event::KEY_SIGNATURE,
+	Event::SEQUENCE_SPECIFIC,
+	Event::SYSEX_MESSAGES,
+	Event::MTC_QUARTER_FRAME,
+	Event::SONG_POSITION_POINTER,
+	Event::SONG_REQUEST,
+	Event::TUNE_REQUEST,
+	Event::END_OF_SYSEX_MESSAGES,
+	Event::TIMING_CLOCK_FOR_SYNC,
+	Event::START_CURRENT_SEQUENCE,
+	Event::CONTINUE_STOPPED_SEQUENCE,
+	Event::STOP_SEQUENCE,
+	Event::ACTIVE_SENSING,
+};
+//------------------------------------------------------------------------------
+// Meta types share numbers with midi types(0x08..0x0e), so meta events are
+// looked up in their own half.
+int8_t			get_type_index(byte status, byte type)
+{
+	static const std::array<int8_t, 512> indices = []
+	{
+		std::array<int8_t, 512> result;
+		result.fill(std::size(types));
+		for (size_t i = 0; i < std::size(types); ++i)
+		{
+			bool meta = types[i] < 0x80 && (types[i] < Event::NOTE_OFF || types[i] > Event::PITCH_BEND);
+			result[(meta ? 0 : 256) + types[i]] = i;
+		}
+		return result;
+	}();
+	return indices[(status == 0xff ? 0 : 256) + type];
+}
+//------------------------------------------------------------------------------
+// the type and channel columns of a song, returns the count of null channels
+int64_t			get_types(
+	std::span<const byte>	statuses,
+	std::span<const byte>	types,
+	int8_t*					type_indices,
+	byte*					channels,
+	byte*					validity
+)
+{
+	int64_t null_count = 0;
+	for (size_t i = 0; i < statuses.size(); ++i)
+	{
+		type_indices[i] = get_type_index(statuses[i], types[i]);
+		if (statuses[i] >= 0x80 && statuses[i] < 0xf0)
+		{
+			channels[i] = statuses[i] & 0x0f;
+			validity[i / 8] |= 1 << (i % 8);
+		}
+		else
+		{
+			++null_count;
+		}
+	}
+	return null_count;
+}
+} // anonymous
+
+
+
+
+
+/*##########################
+
+	ArrowExporter
+
+##########################*/
+ArrowExporter::ArrowExporter(const std::filesystem::path& file_path):
+	writer(file_path, get_columns())
+{
+}
+//------------------------------------------------------------------------------
+void			ArrowExporter::write(const EventTable& table, uint32_t file_id)
+{
+	auto payloads = table.get_payloads();
+	if (payloads.size() > INT32_MAX)
+		throw std::length_error("ArrowExporter: payload over 2GB");
+
+	size_t count = table.size();
+	std::vector<uint32_t> file_ids(count, file_id);
+	std::vector<int8_t> type_indices(count);
+	std::vector<byte> channels(count);
+	std::vector<byte> validity((count + 7) / 8);
+	int64_t null_count = get_types(
+		table.get_statuses(), table.get_types(), type_indices.data(), channels.data(), validity.data()
+	);
+
+	ArrowWriter::Batch batch(writer, count);
+	batch.set(FILE_ID, file_ids.data());
+	batch.set(TRACK, table.get_tracks().data());
+	batch.set(TICK, table.get_ticks().data());
+	batch.set(TIME, table.get_times().data());
+	batch.set(TYPE, type_indices.data());
+	batch.set(CHANNEL, channels.data());
+	batch.set_validity(CHANNEL, validity.data(), null_count);
+	batch.set(DATA0, table.get_data0().data());
+	batch.set(DATA1, table.get_data1().data());
+	// the offsets start at 0 and stay below 2GB, the same bits as int32
+	batch.set(
+		PAYLOAD,
+		reinterpret_cast<const int32_t*>(table.get_payload_offsets().data()),
+		payloads.data()
+	);
+	writer.write(batch);
+}
+//------------------------------------------------------------------------------
+void			ArrowExporter::write(const EventTable& table, uint32_t file_id, const Selection& selection)
+{
+	if (selection.size() != table.size())
+		throw std::logic_error("ArrowExporter: selection of another table");
+
+	std::vector<uint32_t> rows = selection.get_rows();
+	size_t count = rows.size();
+	auto table_tracks = table.get_tracks();
+	auto table_ticks = table.get_ticks();
+	auto table_times = table.get_times();
+	auto table_statuses = table.get_statuses();
+	auto table_types = table.get_types();
+	auto table_data0 = table.get_data0();
+	auto table_data1 = table.get_data1();
+
+	std::vector<uint16_t> tracks(count);
+	std::vector<uint64_t> ticks(count);
+	std::vector<int64_t> times(count);
+	std::vector<byte> statuses(count);
+	std::vector<byte> types(count);
+	std::vector<byte> data0(count);
+	std::vector<byte> data1(count);
+	std::vector<int32_t> offsets(count + 1);
+	std::vector<byte> payloads;
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t row = rows[i];
+		tracks[i] = table_tracks[row];
+		ticks[i] = table_ticks[row];
+		times[i] = table_times[row];
+		statuses[i] = table_statuses[row];
+		types[i] = table_types[row];
+		data0[i] = table_data0[row];
+		data1[i] = table_data1[row];
+		offsets[i] = payloads.size();
+		// checked against the table, the offsets come from a mapped cache
+		std::span<const byte> payload = table.get_payload(row);
+		payloads.insert(payloads.end(), payload.begin(), payload.end());
+		if (payloads.size() > INT32_MAX)
+			throw std::length_error("ArrowExporter: payload over 2GB");
+	}
+	offsets[count] = payloads.size();
+
+	std::vector<uint32_t> file_ids(count, file_id);
+	std::vector<int8_t> type_indices(count);
+	std::vector<byte> channels(count);
+	std::vector<byte> validity((count + 7) / 8);
+	int64_t null_count = get_types(statuses, types, type_indices.data(), channels.data(), validity.data());
+
+	ArrowWriter::Batch batch(writer, count);
+	batch.set(FILE_ID, file_ids.data());
+	batch.set(TRACK, tracks.data());
+	batch.set(TICK, ticks.data());
+	batch.set(TIME, times.data());
+	batch.set(TYPE, type_indices.data());
+	batch.set(CHANNEL, channels.data());
+	batch.set_validity(CHANNEL, validity.data(), null_count);
+	batch.set(DATA0, data0.data());
+	batch.set(DATA1, data1.data());
+	batch.set(PAYLOAD, offsets.data(), payloads.data());
+	writer.write(batch);
+}
+//------------------------------------------------------------------------------
+void			ArrowExporter::write(const Midi& midi, uint32_t file_id)
+{
+	write(EventTable(midi), file_id);
+}
+//------------------------------------------------------------------------------
+void			ArrowExporter::close()
+{
+	writer.close();
+}
+//------------------------------------------------------------------------------
+std::vector<ArrowWriter::Column>	ArrowExporter::get_columns()
+{
+	std::vector<std::string> type_names;
+	for (Event::Type type: types)
+		type_names.push_back(Event::get_type_name(type));
+	type_names.push_back("unknown");
+
+	using Type = ArrowWriter::Type;
+	return {
+		{"file_id",	Type::UINT32},
+		{"track",	Type::UINT16},
+		{"tick",	Type::UINT64},
+		{"us",		Type::INT64},
+		{"type",	Type::INT8,		false,	type_names},
+		{"channel",	Type::UINT8,	true},
+		{"data0",	Type::UINT8},
+		{"data1",	Type::UINT8},
+		{"payload",	Type::BINARY},
+	};
+}
+//------------------------------------------------------------------------------
+void			ArrowExporter::export_directory(
+	const std::filesystem::path&	input_directory,
+	const std::filesystem::path&	output_directory
+)
+{
+	std::vector<std::filesystem::path> files = find_midi_files(input_directory);
+	std::filesystem::create_directories(output_directory);
+
+	struct FileInfo
+	{
+		std::string		error;
+		uint64_t		event_count = 0;
+	};
+	std::vector<FileInfo> infos(files.size());
+	ArrowExporter exporter(output_directory / "events.arrow");
+	parallel_for(files.size(), [&](size_t i)
+	{
+		EventTable table;
+		try
+		{
+			table.build(Midi(files[i]));
+		}
+		catch (const std::exception& e)
+		{
+			infos[i].error = e.what();
+			return;
+		}
+		infos[i].event_count = table.size();
+		exporter.write(table, i);
+	});
+	exporter.close();
+
+	// file_id, path, error, events
+	std::vector<uint32_t> file_ids(files.size());
+	std::vector<int32_t> path_offsets = {0};
+	std::vector<int32_t> error_offsets = {0};
+	std::vector<byte> error_validity((files.size() + 7) / 8);
+	std::vector<uint64_t> event_counts(files.size());
+	std::string paths;
+	std::string errors;
+	int64_t null_count = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		file_ids[i] = i;
+		paths += files[i].lexically_relative(input_directory).generic_string();
+		errors += infos[i].error;
+		if (paths.size() > INT32_MAX || errors.size() > INT32_MAX)
+			throw std::length_error("ArrowExporter: paths over 2GB");
+		path_offsets.push_back(paths.size());
+		error_offsets.push_back(errors.size());
+		if (infos[i].error.empty())
+			++null_count;
+		else
+			error_validity[i / 8] |= 1 << (i % 8);
+		event_counts[i] = infos[i].event_count;
+	}
+
+	using Type = ArrowWriter::Type;
+	ArrowWriter writer(output_directory / "files.arrow", {
+		{"file_id",	Type::UINT32},
+		{"path",	Type::UTF8},
+		{"error",	Type::UTF8,		true},
+		{"events",	Type::UINT64},
+	});
+	ArrowWriter::Batch batch(writer, files.size());
+	batch.set(0, file_ids.data());
+	batch.set(1, path_offsets.data(), paths.data());
+	batch.set(2, error_offsets.data(), errors.data());
+	batch.set_validity(2, error_validity.data(), null_count);
+	batch.set(3, event_counts.data());
+	writer.write(batch);
+	writer.close();
+}
+} // MidiParser
@@ -0,0 +1,573 @@
+#include "arrow_writer.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+namespace MidiParser {
+/*##########################
+
+	Flatbuffers
+
+##########################*/
+namespace {
+/*
+ * Builds a flatbuffer front to back: a table is written, then the tables,
+ * vectors and strings it refers to, and their offsets are patched. Offsets
+ * of a flatbuffer only point forward, so this order is always valid.
+*/
+class FlatBuilder
+{
+public:
+	struct Field
+	{
+		int						id;
+		int						size; // of a scalar, 0 for an offset to a child
+		uint64_t				value;
+		std::function<size_t()>	child; // writes the child, returns its position
+	};
+
+	static
+	Field				scalar(int id, int size, uint64_t value)
+	{
+		return {id, size, value, {}};
+	}
+	static
+	Field				child(int id, std::function<size_t()> child)
+	{
+		return {id, 0, 0, std::move(child)};
+	}
+
+	// the root offset, the root, then padding to 8 bytes
+	std::vector<byte>	finish(const std::function<size_t()>& root)
+	{
+		data.assign(4, 0);
+		patch(0, root());
+		align(8);
+		return std::move(data);
+	}
+	size_t				table(const std::vector<Field>& fields)
+	{
+		int count = 0;
+		for (const Field& field: fields)
+			count = std::max(count, field.id + 1);
+
+		align(2);
+		size_t vtable = data.size();
+		data.resize(vtable + 4 + 2 * count, 0);
+		size_t table = put<int32_t>(0);
+		put_at<int32_t>(table, table - vtable);
+
+		// widest first, so that there is little padding
+		std::vector<const Field*> order;
+		for (const Field& field: fields)
+			order.push_back(&field);
+		std::stable_sort(order.begin(), order.end(), [](const Field* a, const Field* b)
+		{
+			return (a->size ? a->size : 4) > (b->size ? b->size : 4);
+		});
+
+		std::vector<std::pair<size_t, const Field*>> children;
+		for (const Field* field: order)
+		{
+			size_t position;
+			switch (field->size)
+			{
+				case 1:		position = put<uint8_t>(field->value); break;
+				case 2:		position = put<uint16_t>(field->value); break;
+				case 4:		position = put<uint32_t>(field->value); break;
+				case 8:		position = put<uint64_t>(field->value); break;
+				default:
+					position = put<uint32_t>(0);
+					children.emplace_back(position, field);
+			}
+			put_at<uint16_t>(vtable + 4 + 2 * field->id, position - table);
+		}
+		put_at<uint16_t>(vtable, 4 + 2 * count);
+		put_at<uint16_t>(vtable + 2, data.size() - table);
+
+		for (auto& [position, field]: children)
+			patch(position, field->child());
+		return table;
+	}
+	size_t				string(std::string_view str)
+	{
+		size_t position = put<uint32_t>(str.size());
+		data.insert(data.end(), str.begin(), str.end());
+		data.push_back(0);
+		return position;
+	}
+	size_t				tables(const std::vector<std::function<size_t()>>& elements)
+	{
+		size_t position = put<uint32_t>(elements.size());
+		for (size_t i = 0; i < elements.size(); ++i)
+			put<uint32_t>(0);
+		for (size_t i = 0; i < elements.size(); ++i)
+			patch(position + 4 + 4 * i, elements[i]());
+		return position;
+	}
+	// structs of 8 byte alignment, already in little endian
+	size_t				structs(const std::vector<byte>& values, size_t count)
+	{
+		while ((data.size() + 4) % 8)
+			data.push_back(0);
+		size_t position = put<uint32_t>(count);
+		data.insert(data.end(), values.begin(), values.end());
+		return position;
+	}
+
+private:
+	std::vector<byte>	data;
+
+	void				align(size_t alignment)
+	{
+		while (data.size() % alignment)
+			data.push_back(0);
+	}
+	template <typename T>
+	size_t				put(T value)
+	{
+		align(sizeof(T));
+		size_t position = data.size();
+		data.resize(position + sizeof(T));
+		put_at<T>(position, value);
+		return position;
+	}
+	template <typename T>
+	void				put_at(size_t position, uint64_t value)
+	{
+		for (size_t i = 0; i < sizeof(T); ++i)
+			data[position + i] = static_cast<byte>(value >> (8 * i));
+	}
+	void				patch(size_t position, size_t target)
+	{
+		put_at<uint32_t>(position, target - position);
+	}
+};
+//------------------------------------------------------------------------------
+void			append_le(std::vector<byte>& output, uint64_t value, int size = 8)
+{
+	for (int i = 0; i < size; ++i)
+		output.push_back(static_cast<byte>(value >> (8 * i)));
+}
+//------------------------------------------------------------------------------
+constexpr int		metadata_v5 = 4;
+constexpr int		header_schema = 1;
+constexpr int		header_dictionary_batch = 2;
+constexpr int		header_record_batch = 3;
+constexpr int		type_int = 2;
+constexpr int		type_binary = 4;
+constexpr int		type_utf8 = 5;
+constexpr byte		zeros[8] = {};
+//------------------------------------------------------------------------------
+size_t			padded(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+//------------------------------------------------------------------------------
+size_t			build_int(FlatBuilder& builder, int width, bool is_signed)
+{
+	return builder.table({
+		FlatBuilder::scalar(0, 4, width * 8),
+		FlatBuilder::scalar(1, 1, is_signed),
+	});
+}
+//------------------------------------------------------------------------------
+// a message holding a record batch or a dictionary batch
+size_t			build_message(
+	FlatBuilder&						builder,
+	int									header_type,
+	int64_t								body_size,
+	const std::function<size_t()>&		header
+)
+{
+	return builder.table({
+		FlatBuilder::scalar(0, 2, metadata_v5),
+		FlatBuilder::scalar(1, 1, header_type),
+		FlatBuilder::child(2, header),
+		FlatBuilder::scalar(3, 8, body_size),
+	});
+}
+//------------------------------------------------------------------------------
+// nodes are (length, null count), buffers (offset, size) in the body
+size_t			build_record_batch(
+	FlatBuilder&						builder,
+	int64_t								length,
+	const std::vector<int64_t>&			nodes,
+	const std::vector<int64_t>&			buffers
+)
+{
+	return builder.table({
+		FlatBuilder::scalar(0, 8, length),
+		FlatBuilder::child(1, [&]
+		{
+			std::vector<byte> values;
+			for (int64_t value: nodes)
+				append_le(values, value);
+			return builder.structs(values, nodes.size() / 2);
+		}),
+		FlatBuilder::child(2, [&]
+		{
+			std::vector<byte> values;
+			for (int64_t value: buffers)
+				append_le(values, value);
+			return builder.structs(values, buffers.size() / 2);
+		}),
+	});
+}
+//------------------------------------------------------------------------------
+// in bytes, 0 for binary and utf8
+int				get_width(ArrowWriter::Type type)
+{
+	switch (type)
+	{
+		using Type = ArrowWriter::Type;
+		case Type::INT8:	case Type::UINT8:	return 1;
+		case Type::INT16:	case Type::UINT16:	return 2;
+		case Type::INT32:	case Type::UINT32:	return 4;
+		case Type::INT64:	case Type::UINT64:	return 8;
+		default:								return 0;
+	}
+}
+//------------------------------------------------------------------------------
+size_t			build_schema(FlatBuilder& builder, const std::vector<ArrowWriter::Column>& columns)
+{
+	std::vector<std::function<size_t()>> fields;
+	for (const ArrowWriter::Column& column: columns)
+	{
+		fields.push_back([&builder, &column, &columns]
+		{
+			bool encoded = !column.dictionary.empty();
+			int width = get_width(column.type);
+			int type = encoded ? type_utf8 : width ? type_int
+				: column.type == ArrowWriter::Type::UTF8 ? type_utf8 : type_binary;
+			bool is_signed = column.type <= ArrowWriter::Type::INT64;
+
+			std::vector<FlatBuilder::Field> field = {
+				FlatBuilder::child(0, [&]{ return builder.string(column.name); }),
+				FlatBuilder::scalar(1, 1, column.nullable),
+				FlatBuilder::scalar(2, 1, type),
+				FlatBuilder::child(3, [&]
+				{
+					if (type == type_int)
+						return build_int(builder, width, is_signed);
+					return builder.table({});
+				}),
+				FlatBuilder::child(5, [&]{ return builder.tables({}); }),
+			};
+			if (encoded)
+			{
+				// the dictionary id is the index of the column
+				int64_t id = &column - &columns.front();
+				field.push_back(FlatBuilder::child(4, [&, id]
+				{
+					return builder.table({
+						FlatBuilder::scalar(0, 8, id),
+						FlatBuilder::child(1, [&]{ return build_int(builder, width, is_signed); }),
+					});
+				}));
+			}
+			return builder.table(field);
+		});
+	}
+	return builder.table({
+		FlatBuilder::scalar(0, 2, std::endian::native == std::endian::big),
+		FlatBuilder::child(1, [&]{ return builder.tables(fields); }),
+	});
+}
+} // anonymous
+
+
+
+
+
+/*##########################
+
+	ArrowWriter::Batch
+
+##########################*/
+ArrowWriter::Batch::Batch(const ArrowWriter& writer, size_t length):
+	writer(writer), length(length), columns(writer.columns.size())
+{
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::Batch::set(int column, const void* values)
+{
+	if (column < 0 || column >= static_cast<int>(columns.size()))
+		throw std::out_of_range(__func__);
+	if (!get_width(writer.columns[column].type))
+		throw std::logic_error("ArrowWriter: column needs offsets");
+	columns[column].values = values;
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::Batch::set(int column, const int32_t* offsets, const void* data)
+{
+	if (column < 0 || column >= static_cast<int>(columns.size()))
+		throw std::out_of_range(__func__);
+	if (get_width(writer.columns[column].type))
+		throw std::logic_error("ArrowWriter: column is fixed width");
+	columns[column].offsets = offsets;
+	columns[column].values = data;
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::Batch::set_validity(int column, const byte* bitmap, int64_t null_count)
+{
+	if (column < 0 || column >= static_cast<int>(columns.size()))
+		throw std::out_of_range(__func__);
+	if (null_count && !writer.columns[column].nullable)
+		throw std::logic_error("ArrowWriter: column is not nullable");
+	columns[column].validity = bitmap;
+	columns[column].null_count = null_count;
+}
+//------------------------------------------------------------------------------
+size_t			ArrowWriter::Batch::size() const
+{
+	return length;
+}
+
+
+
+
+
+/*##########################
+
+	ArrowWriter
+
+##########################*/
+ArrowWriter::ArrowWriter(const std::filesystem::path& file_path, std::vector<Column> columns):
+	file(file_path, std::ios::binary | std::ios::trunc), columns(std::move(columns))
+{
+	if (!file.is_open())
+		throw std::runtime_error("create failed");
+	for (const Column& column: this->columns)
+	{
+		if (!column.dictionary.empty() && !get_width(column.type))
+			throw std::logic_error("ArrowWriter: dictionary index must be an integer");
+	}
+
+	static constexpr byte magic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+	write_output(magic, sizeof(magic));
+
+	FlatBuilder builder;
+	std::vector<byte> schema = builder.finish([&]
+	{
+		return builder.table({
+			FlatBuilder::scalar(0, 2, metadata_v5),
+			FlatBuilder::scalar(1, 1, header_schema),
+			FlatBuilder::child(2, [&]{ return build_schema(builder, this->columns); }),
+			FlatBuilder::scalar(3, 8, 0),
+		});
+	});
+	write_message(schema, {}, nullptr);
+
+	for (size_t i = 0; i < this->columns.size(); ++i)
+	{
+		if (!this->columns[i].dictionary.empty())
+			write_dictionary(i, i);
+	}
+}
+//------------------------------------------------------------------------------
+ArrowWriter::~ArrowWriter()
+{
+	try
+	{
+		close();
+	}
+	catch (...)
+	{
+		// nowhere to report it, call close() to know
+	}
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::write(const Batch& batch)
+{
+	if (&batch.writer != this)
+		throw std::logic_error("ArrowWriter: batch of another writer");
+
+	// validity, then values, or offsets and data, for each column
+	std::vector<Buffer> body;
+	std::vector<int64_t> nodes;
+	std::vector<int64_t> buffers;
+	int64_t offset = 0;
+	auto add = [&](const void* data, size_t size)
+	{
+		body.push_back({data, size});
+		buffers.push_back(offset);
+		buffers.push_back(size);
+		offset += padded(size);
+	};
+
+	int64_t length = batch.length;
+	for (size_t i = 0; i < columns.size(); ++i)
+	{
+		const Batch::Buffers& column = batch.columns[i];
+		if (length && (!column.values || (!get_width(columns[i].type) && !column.offsets)))
+			throw std::logic_error("ArrowWriter: column not set");
+		nodes.push_back(length);
+		nodes.push_back(column.null_count);
+		add(column.validity, column.null_count ? (length + 7) / 8 : 0);
+		if (int width = get_width(columns[i].type))
+		{
+			add(column.values, length * width);
+		}
+		else
+		{
+			add(column.offsets, length ? (length + 1) * 4 : 0);
+			add(column.values, length ? column.offsets[length] : 0);
+		}
+	}
+
+	FlatBuilder builder;
+	std::vector<byte> metadata = builder.finish([&]
+	{
+		return build_message(builder, header_record_batch, offset, [&]
+		{
+			return build_record_batch(builder, length, nodes, buffers);
+		});
+	});
+
+	std::lock_guard lock(mutex);
+	if (!open)
+		throw std::logic_error("ArrowWriter: closed");
+	write_message(metadata, body, &batches);
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::close()
+{
+	std::lock_guard lock(mutex);
+	if (!open)
+		return;
+	open = false;
+
+	// end of stream, then the footer for random access
+	static constexpr byte end[8] = {0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0};
+	write_output(end, sizeof(end));
+
+	FlatBuilder builder;
+	auto build_blocks = [&](const std::vector<Block>& blocks)
+	{
+		std::vector<byte> values;
+		for (const Block& block: blocks)
+		{
+			append_le(values, block.offset);
+			append_le(values, block.metadata_size, 4);
+			append_le(values, 0, 4);
+			append_le(values, block.body_size);
+		}
+		return builder.structs(values, blocks.size());
+	};
+	std::vector<byte> footer = builder.finish([&]
+	{
+		return builder.table({
+			FlatBuilder::scalar(0, 2, metadata_v5),
+			FlatBuilder::child(1, [&]{ return build_schema(builder, columns); }),
+			FlatBuilder::child(2, [&]{ return build_blocks(dictionaries); }),
+			FlatBuilder::child(3, [&]{ return build_blocks(batches); }),
+		});
+	});
+	write_output(footer.data(), footer.size());
+
+	// footer size(int32), then the magic
+	std::array<byte, 10> tail = {0, 0, 0, 0, 'A', 'R', 'R', 'O', 'W', '1'};
+	for (int i = 0; i < 4; ++i)
+		tail[i] = static_cast<byte>(footer.size() >> (8 * i));
+	write_output(tail.data(), tail.size());
+
+	file.close();
+	if (!file)
+		throw std::runtime_error("write failed");
+}
+//------------------------------------------------------------------------------
+bool			ArrowWriter::is_open() const
+{
+	return open;
+}
+//------------------------------------------------------------------------------
+const std::vector<ArrowWriter::Column>&	ArrowWriter::get_columns() const
+{
+	return columns;
+}
+//------------------------------------------------------------------------------
+size_t			ArrowWriter::get_batch_count() const
+{
+	return batches.size();
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::write_dictionary(int column, int64_t id)
+{
+	const std::vector<std::string>& values = columns[column].dictionary;
+	std::vector<int32_t> offsets = {0};
+	std::string data;
+	for (const std::string& value: values)
+	{
+		data += value;
+		offsets.push_back(data.size());
+	}
+
+	int64_t length = values.size();
+	std::vector<int64_t> nodes = {length, 0};
+	std::vector<int64_t> buffers = {
+		0, 0,
+		0, (length + 1) * 4,
+		static_cast<int64_t>(padded((length + 1) * 4)), static_cast<int64_t>(data.size()),
+	};
+	int64_t body_size = buffers[4] + padded(data.size());
+
+	FlatBuilder builder;
+	std::vector<byte> metadata = builder.finish([&]
+	{
+		return build_message(builder, header_dictionary_batch, body_size, [&]
+		{
+			return builder.table({
+				FlatBuilder::scalar(0, 8, id),
+				FlatBuilder::child(1, [&]
+				{
+					return build_record_batch(builder, length, nodes, buffers);
+				}),
+			});
+		});
+	});
+	write_message(
+		metadata,
+		{{nullptr, 0}, {offsets.data(), offsets.size() * 4}, {data.data(), data.size()}},
+		&dictionaries
+	);
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::write_message(
+	const std::vector<byte>&	metadata,
+	const std::vector<Buffer>&	body,
+	std::vector<Block>*			blocks
+)
+{
+	Block block = {position, static_cast<int32_t>(8 + metadata.size()), 0};
+
+	std::vector<byte> prefix;
+	append_le(prefix, 0xffffffff, 4);
+	append_le(prefix, metadata.size(), 4);
+	write_output(prefix.data(), prefix.size());
+	write_output(metadata.data(), metadata.size());
+	for (const Buffer& buffer: body)
+	{
+		write_output(buffer.data, buffer.size);
+		write_output(zeros, padded(buffer.size) - buffer.size);
+		block.body_size += padded(buffer.size);
+	}
+
+	if (blocks)
+		blocks->push_back(block);
+}
+//------------------------------------------------------------------------------
+void			ArrowWriter::write_output(const void* data, size_t size)
+{
+	if (!size)
+		return;
+	file.write(static_cast<const char*>(data), size);
+	if (!file)
+		throw std::runtime_error("write failed");
+	position += size;
+}
+} // MidiParser
@@ -0,0 +1,316 @@
+#include "channel_state.h"
+#include "track_merger.h"
+#include <algorithm>
+
+namespace MidiParser {
+/*##########################
+
+	ChannelState
+
+##########################*/
+ChannelState::ChannelState()
+{
+	reset();
+}
+//------------------------------------------------------------------------------
+void	ChannelState::reset()
+{
+	controllers.fill(0);
+	controllers[Controller::CHANNEL_VOLUME] = 100;
+	controllers[Controller::PAN] = 64;
+	controllers[Controller::EXPRESSION_CONTROLLER] = 127;
+	controller_set.reset();
+	program = 0;
+	program_set = false;
+	registered_parameters = {2 << 7, 0x2000, 0x2000, 0, 0, 0};
+	registered_parameter_set.reset();
+	reset_controllers();
+	pressure_set = false;
+	pitch_bend_set = false;
+}
+//------------------------------------------------------------------------------
+void	ChannelState::reset_controllers()
+{
+	// Recommended Practice RP-015
+	controllers[Controller::MODULATION_WHEEL] = 0;
+	controllers[Controller::EXPRESSION_CONTROLLER] = 127;
+	for (int i = Controller::SUSTAIN_ON_OFF; i <= Controller::HOLD_2_ON_OFF; ++i)
+		controllers[i] = 0;
+	pressure = 0;
+	pitch_bend = 0x2000;
+	registered_parameter = null_parameter;
+	non_registered_parameter = null_parameter;
+	non_registered_selected = false;
+}
+//------------------------------------------------------------------------------
+void	ChannelState::apply(int status, int data0, int data1)
+{
+	switch ((status >> 4) & 0xf)
+	{
+		case Event::CONTROL_CHANGE:
+			control_change(data0 & 0x7f, data1 & 0x7f);
+			break;
+		case Event::PROGRAM_CHANGE:
+			program = data0 & 0x7f;
+			program_set = true;
+			break;
+		case Event::CHANNEL_PRESSURE:
+			pressure = data0 & 0x7f;
+			pressure_set = true;
+			break;
+		case Event::PITCH_BEND:
+			pitch_bend = (data0 & 0x7f) | (data1 & 0x7f) << 7;
+			pitch_bend_set = true;
+			break;
+	}
+}
+//------------------------------------------------------------------------------
+void	ChannelState::control_change(int controller, int value)
+{
+	switch (controller)
+	{
+		case Controller::REGISTERED_PARAMETER_NUMBER_MSB:
+			registered_parameter = (registered_parameter & 0x7f) | value << 7;
+			non_registered_selected = false;
+			return;
+		case Controller::REGISTERED_PARAMETER_NUMBER_LSB:
+			registered_parameter = (registered_parameter & 0x3f80) | value;
+			non_registered_selected = false;
+			return;
+		case Controller::NON_REGISTERED_PARAMETER_NUMBER_MSB:
+			non_registered_parameter = (non_registered_parameter & 0x7f) | value << 7;
+			non_registered_selected = true;
+			return;
+		case Controller::NON_REGISTERED_PARAMETER_NUMBER_LSB:
+			non_registered_parameter = (non_registered_parameter & 0x3f80) | value;
+			non_registered_selected = true;
+			return;
+		case Controller::DATA_ENTRY___USED_WITH_RPNS_NRPNS:
+		case Controller::DATA_ENTRY:
+		{
+			// NRPNs are vendor specific, and are not restored.
+			if (non_registered_selected ||
+				registered_parameter >= registered_parameter_count)
+				return;
+			uint16_t& parameter = registered_parameters[registered_parameter];
+			if (controller == Controller::DATA_ENTRY)
+				parameter = (parameter & 0x3f80) | value;
+			else
+				parameter = (parameter & 0x7f) | value << 7;
+			registered_parameter_set.set(registered_parameter);
+			return;
+		}
+		case Controller::RESET_ALL_CONTROLLERS:
+			reset_controllers();
+			return;
+	}
+	// Channel mode messages are not a state to restore.
+	if (controller >= Controller::ALL_SOUND_OFF)
+		return;
+	controllers[controller] = value;
+	controller_set.set(controller);
+}
+//------------------------------------------------------------------------------
+void	ChannelState::get_messages(int channel, std::vector<uint32_t>& messages) const
+{
+	const int control_change = Event::CONTROL_CHANGE << 4 | channel;
+
+	// bank select must precede program change
+	for (int i: {Controller::BANK_SELECT_DETAIL, Controller::BANK_SELECT})
+	{
+		if (controller_set.test(i))
+			messages.push_back(MidiEvent::make_binary(control_change, i, controllers[i]));
+	}
+	if (program_set)
+		messages.push_back(
+			MidiEvent::make_binary(Event::PROGRAM_CHANGE << 4 | channel, program)
+		);
+	for (int i = 0; i < 128; ++i)
+	{
+		if (!controller_set.test(i) ||
+			i == Controller::BANK_SELECT_DETAIL ||
+			i == Controller::BANK_SELECT ||
+			i == Controller::DATA_ENTRY___USED_WITH_RPNS_NRPNS ||
+			i == Controller::DATA_ENTRY)
+			continue;
+		messages.push_back(MidiEvent::make_binary(control_change, i, controllers[i]));
+	}
+	for (int i = 0; i < registered_parameter_count; ++i)
+	{
+		if (!registered_parameter_set.test(i))
+			continue;
+		messages.push_back(MidiEvent::make_binary(
+			control_change, Controller::REGISTERED_PARAMETER_NUMBER_MSB, 0
+		));
+		messages.push_back(MidiEvent::make_binary(
+			control_change, Controller::REGISTERED_PARAMETER_NUMBER_LSB, i
+		));
+		messages.push_back(MidiEvent::make_binary(
+			control_change,
+			Controller::DATA_ENTRY___USED_WITH_RPNS_NRPNS,
+			registered_parameters[i] >> 7
+		));
+		messages.push_back(MidiEvent::make_binary(
+			control_change, Controller::DATA_ENTRY, registered_parameters[i] & 0x7f
+		));
+	}
+	// restore the selected parameter, so following data entries go to the right place
+	uint16_t parameter = non_registered_selected ?
+		non_registered_parameter : registered_parameter;
+	int msb = non_registered_selected ?
+		Controller::NON_REGISTERED_PARAMETER_NUMBER_MSB :
+		Controller::REGISTERED_PARAMETER_NUMBER_MSB;
+	int lsb = non_registered_selected ?
+		Controller::NON_REGISTERED_PARAMETER_NUMBER_LSB :
+		Controller::REGISTERED_PARAMETER_NUMBER_LSB;
+	if (parameter != null_parameter || registered_parameter_set.any())
+	{
+		messages.push_back(MidiEvent::make_binary(control_change, msb, parameter >> 7));
+		messages.push_back(MidiEvent::make_binary(control_change, lsb, parameter & 0x7f));
+	}
+	if (pitch_bend_set)
+		messages.push_back(MidiEvent::make_binary(
+			Event::PITCH_BEND << 4 | channel, pitch_bend & 0x7f, pitch_bend >> 7
+		));
+	if (pressure_set)
+		messages.push_back(MidiEvent::make_binary(
+			Event::CHANNEL_PRESSURE << 4 | channel, pressure
+		));
+}
+
+
+
+
+/*##########################
+
+	ChannelStateTracker
+
+##########################*/
+void	ChannelStateTracker::reset()
+{
+	for (ChannelState& channel: channels)
+		channel.reset();
+}
+//------------------------------------------------------------------------------
+void	ChannelStateTracker::apply(const Event& event)
+{
+	if (event.get_category() != Event::MIDI)
+		return;
+	auto& midi_event = static_cast<const MidiEvent&>(event);
+	apply(midi_event.get_status(), midi_event.data[0], midi_event.data[1]);
+}
+//------------------------------------------------------------------------------
+void	ChannelStateTracker::apply(int status, int data0, int data1)
+{
+	channels[status & 0xf].apply(status, data0, data1);
+}
+//------------------------------------------------------------------------------
+void	ChannelStateTracker::get_messages(std::vector<uint32_t>& messages) const
+{
+	for (int i = 0; i < 16; ++i)
+		channels[i].get_messages(i, messages);
+}
+//------------------------------------------------------------------------------
+std::vector<uint32_t>	ChannelStateTracker::get_messages() const
+{
+	std::vector<uint32_t> messages;
+	get_messages(messages);
+	return messages;
+}
+
+
+
+
+/*##########################
+
+	ChannelStateIndex
+
+##########################*/
+ChannelStateIndex::ChannelStateIndex(const Midi& midi, uint64_t interval)
+{
+	build(midi, interval);
+}
+//------------------------------------------------------------------------------
+void	ChannelStateIndex::build(const Midi& midi, uint64_t interval)
+{
+	// default: 4 bars of 4/4, or 4 seconds for SMPTE
+	if (interval == 0 && midi.division.get_type() == Division::SMPTE)
+		interval = midi.division.get_frame_rate() * midi.division.get_ticks() * 4;
+	else if (interval == 0)
+		interval = midi.division.get_division() * 16;
+	this->interval = std::max<uint64_t>(interval, 1);
+
+	messages.clear();
+	snapshots.clear();
+	for (const TrackMerger::Item& item: TrackMerger(midi))
+	{
+		// notes are not a channel state
+		const Event* event = item.event;
+		Event::Type type = event->get_type();
+		if (event->get_category() != Event::MIDI ||
+			type == Event::NOTE_ON ||
+			type == Event::NOTE_OFF ||
+			type == Event::POLYPHONIC_KEY_PRESSURE)
+			continue;
+		auto* midi_event = static_cast<const MidiEvent*>(event);
+		messages.push_back({
+			event->timestamp,
+			static_cast<byte>(midi_event->get_status()),
+			{midi_event->data[0], midi_event->data[1]}
+		});
+	}
+
+	// Intervals without any message share the previous snapshot.
+	ChannelStateTracker tracker;
+	snapshots.push_back({0, 0, tracker});
+	size_t i = 0;
+	while (i < messages.size())
+	{
+		uint64_t tick = (messages[i].tick / this->interval + 1) * this->interval;
+		while (i < messages.size() && messages[i].tick < tick)
+		{
+			const Message& message = messages[i++];
+			tracker.apply(message.status, message.data[0], message.data[1]);
+		}
+		snapshots.push_back({tick, i, tracker});
+	}
+}
+//------------------------------------------------------------------------------
+void	ChannelStateIndex::seek(uint64_t tick, ChannelStateTracker& tracker) const
+{
+	if (snapshots.empty())
+	{
+		tracker.reset();
+		return;
+	}
+	auto it = std::upper_bound(snapshots.begin(), snapshots.end(), tick,
+		[](uint64_t tick, const Snapshot& snapshot){ return tick < snapshot.tick; }
+	);
+	const Snapshot& snapshot = *(--it);
+	tracker = snapshot.tracker;
+	for (size_t i = snapshot.message_index; i < messages.size(); ++i)
+	{
+		const Message& message = messages[i];
+		if (message.tick >= tick)
+			break;
+		tracker.apply(message.status, message.data[0], message.data[1]);
+	}
+}
+//------------------------------------------------------------------------------
+ChannelStateTracker	ChannelStateIndex::seek(uint64_t tick) const
+{
+	ChannelStateTracker tracker;
+	seek(tick, tracker);
+	return tracker;
+}
+//------------------------------------------------------------------------------
+uint64_t	ChannelStateIndex::get_interval() const
+{
+	return interval;
+}
+//------------------------------------------------------------------------------
+size_t		ChannelStateIndex::get_snapshot_count() const
+{
+	return snapshots.size();
+}
+} // MidiParser
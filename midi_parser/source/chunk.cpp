@@ -0,0 +1,48 @@
+#include "chunk.h"
+#include <cstdint>
+
+namespace MidiParser {
+/*##########################
+
+	Track
+
+##########################*/
+std::span<const byte>	Track::get_source() const
+{
+	if (!source)
+		return {};
+	return {source->data() + source_begin, source_end - source_begin};
+}
+//------------------------------------------------------------------------------
+bool			Track::is_dirty() const
+{
+	return !source || dirty || events.size() != source_count;
+}
+//------------------------------------------------------------------------------
+void			Track::mark_dirty()
+{
+	dirty = true;
+	event_offsets.clear();
+	event_offsets.shrink_to_fit();
+}
+//------------------------------------------------------------------------------
+std::span<const uint32_t>	Track::get_event_offsets() const
+{
+	if (event_offsets.empty() || is_dirty())
+		return {};
+	return event_offsets;
+}
+//------------------------------------------------------------------------------
+void			Track::set_source(
+	std::shared_ptr<const std::vector<byte>>	source,
+	size_t										begin,
+	size_t										end
+)
+{
+	this->source = std::move(source);
+	source_begin = begin;
+	source_end = end;
+	source_count = events.size();
+	dirty = false;
+}
+} // MidiParser
@@ -0,0 +1,243 @@
+#include "duplicate_finder.h"
+#include "util.h"
+#include <algorithm>
+#include <charconv>
+#include <numeric>
+#include <stdexcept>
+
+namespace MidiParser {
+namespace {
+// entries linked into trees, the root being the least entry
+class Clusters
+{
+public:
+	Clusters(size_t size):
+		parents(size)
+	{
+		std::iota(parents.begin(), parents.end(), size_t(0));
+	}
+
+	size_t			find(size_t entry)
+	{
+		while (parents[entry] != entry)
+			entry = parents[entry] = parents[parents[entry]];
+		return entry;
+	}
+
+	void			join(size_t a, size_t b)
+	{
+		a = find(a);
+		b = find(b);
+		if (a < b)
+			parents[b] = a;
+		else
+			parents[a] = b;
+	}
+
+
+private:
+	std::vector<size_t>	parents;
+};
+} // anonymous
+
+
+
+/*##########################
+
+	DuplicateFinder
+
+##########################*/
+DuplicateFinder::DuplicateFinder(FingerprintOptions options, int band_count, double threshold):
+	options(options),
+	band_count(band_count),
+	threshold(threshold)
+{
+	if (band_count <= 0 || options.hash_count <= 0 || options.hash_count % band_count)
+		throw std::invalid_argument("DuplicateFinder: hash count must be a positive multiple of band count");
+	if (!(threshold >= 0 && threshold <= 1))
+		throw std::invalid_argument("DuplicateFinder: threshold out of [0, 1]");
+}
+//------------------------------------------------------------------------------
+size_t			DuplicateFinder::add(const Fingerprint& fingerprint, const std::filesystem::path& path)
+{
+	const std::vector<uint32_t>& signature = fingerprint.get_signature();
+	if (signature.size() != static_cast<size_t>(options.hash_count))
+		throw std::invalid_argument("DuplicateFinder: fingerprint of other options");
+	Entry& entry = entries.emplace_back();
+	entry.path = path;
+	entry.hash = fingerprint.get_hash();
+	entry.note_count = fingerprint.get_note_count();
+	entry.exact_group = entry.cluster = entries.size() - 1;
+	signatures.insert(signatures.end(), signature.begin(), signature.end());
+	return entries.size() - 1;
+}
+//------------------------------------------------------------------------------
+void			DuplicateFinder::add_files(const std::vector<std::filesystem::path>& files)
+{
+	size_t first = entries.size();
+	entries.resize(first + files.size());
+	signatures.resize(entries.size() * options.hash_count, UINT32_MAX);
+	parallel_for(files.size(), [&](size_t i)
+	{
+		Entry& entry = entries[first + i];
+		entry.path = files[i];
+		entry.exact_group = entry.cluster = first + i;
+		try
+		{
+			// runs serially on this worker, parallel_for does not nest
+			Fingerprint fingerprint(Midi(files[i]), options);
+			entry.hash = fingerprint.get_hash();
+			entry.note_count = fingerprint.get_note_count();
+			std::copy(
+				fingerprint.get_signature().begin(), fingerprint.get_signature().end(),
+				signatures.begin() + (first + i) * options.hash_count
+			);
+		}
+		catch (const std::exception& e)
+		{
+			entry.error = e.what();
+		}
+	});
+}
+//------------------------------------------------------------------------------
+void			DuplicateFinder::clear()
+{
+	entries.clear();
+	signatures.clear();
+}
+//------------------------------------------------------------------------------
+void			DuplicateFinder::run()
+{
+	Clusters clusters(entries.size());
+	std::vector<std::pair<uint64_t, size_t>> keys; // sorted, equal keys in entry order
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (is_valid(i))
+			keys.push_back({entries[i].hash, i});
+	}
+
+	// exact duplicates
+	std::sort(keys.begin(), keys.end());
+	for (size_t begin = 0, end; begin < keys.size(); begin = end)
+	{
+		for (end = begin; end < keys.size() && keys[end].first == keys[begin].first; ++end)
+		{
+			entries[keys[end].second].exact_group = keys[begin].second;
+			clusters.join(keys[begin].second, keys[end].second);
+		}
+	}
+
+	// near duplicates, band by band
+	size_t rows = options.hash_count / band_count;
+	std::vector<size_t> representatives; // of the clusters met in a large bucket
+	for (int band = 0; band < band_count; ++band)
+	{
+		parallel_for((keys.size() + 65535) / 65536, [&](size_t block)
+		{
+			size_t end = std::min(keys.size(), (block + 1) * 65536);
+			for (size_t i = block * 65536; i < end; ++i)
+			{
+				const uint32_t* values = get_signature(keys[i].second) + band * rows;
+				keys[i].first = hash_bytes(reinterpret_cast<const byte*>(values), rows * sizeof(uint32_t), band);
+			}
+		});
+		std::sort(keys.begin(), keys.end());
+		for (size_t begin = 0, end; begin < keys.size(); begin = end)
+		{
+			for (end = begin + 1; end < keys.size() && keys[end].first == keys[begin].first; ++end);
+			// every pair of a small bucket, in a large one a file per cluster
+			bool pairwise = end - begin <= pairwise_bucket_size;
+			representatives.clear();
+			for (size_t i = begin; i < end; ++i)
+			{
+				size_t entry = keys[i].second;
+				bool alone = true;
+				auto compare = [&](size_t other)
+				{
+					if (clusters.find(other) == clusters.find(entry))
+					{
+						alone = false;
+						return;
+					}
+					double similarity = Fingerprint::get_similarity(
+						{get_signature(other), static_cast<size_t>(options.hash_count)},
+						{get_signature(entry), static_cast<size_t>(options.hash_count)}
+					);
+					if (similarity >= threshold)
+					{
+						clusters.join(other, entry);
+						alone = false;
+					}
+				};
+				if (pairwise)
+				{
+					for (size_t j = begin; j < i; ++j)
+						compare(keys[j].second);
+				}
+				else
+				{
+					for (size_t other: representatives)
+						compare(other);
+					if (alone)
+						representatives.push_back(entry);
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < entries.size(); ++i)
+		entries[i].cluster = clusters.find(i);
+}
+//------------------------------------------------------------------------------
+const std::vector<DuplicateFinder::Entry>&	DuplicateFinder::get_entries() const
+{
+	return entries;
+}
+//------------------------------------------------------------------------------
+std::vector<std::vector<size_t>>	DuplicateFinder::get_clusters() const
+{
+	std::vector<std::vector<size_t>> members(entries.size());
+	for (size_t i = 0; i < entries.size(); ++i)
+		members[entries[i].cluster].push_back(i);
+	std::vector<std::vector<size_t>> clusters;
+	for (auto& cluster: members)
+	{
+		if (cluster.size() > 1)
+			clusters.push_back(std::move(cluster));
+	}
+	return clusters;
+}
+//------------------------------------------------------------------------------
+void			DuplicateFinder::save_csv(const std::filesystem::path& csv_path) const
+{
+	std::string output = "path,notes,hash,exact_group,cluster,error\n";
+	for (const Entry& entry: entries)
+	{
+		append_csv(output, entry.path.generic_string());
+		if (!entry.error.empty())
+		{
+			output += ",,,,,";
+			append_csv(output, entry.error);
+			output += '\n';
+			continue;
+		}
+		char hash[16] = {'0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0'};
+		char* end = std::to_chars(hash, hash + 16, entry.hash, 16).ptr;
+		std::rotate(hash, end, hash + 16); // zero padded
+		output += ',' + std::to_string(entry.note_count) + ',';
+		output.append(hash, 16);
+		output += ',' + std::to_string(entry.exact_group) + ',' + std::to_string(entry.cluster) + ",\n";
+	}
+	write_file(csv_path, output);
+}
+//------------------------------------------------------------------------------
+const uint32_t*	DuplicateFinder::get_signature(size_t entry) const
+{
+	return signatures.data() + entry * options.hash_count;
+}
+//------------------------------------------------------------------------------
+bool			DuplicateFinder::is_valid(size_t entry) const
+{
+	return entries[entry].error.empty() && entries[entry].note_count;
+}
+} // MidiParser
@@ -17,6 +17,48 @@ Event::Category	Event::get_category(byte status)
 		return MIDI;
 }
 //------------------------------------------------------------------------------
+const char*		Event::get_type_name(Type type)
+{
+	switch (type)
+	{
+		case Event::NOTE_OFF:					return "note_off";
+		case Event::NOTE_ON:					return "note_on";
+		case Event::POLYPHONIC_KEY_PRESSURE:	return "polyphonic_key_pressure";
+		case Event::CONTROL_CHANGE:				return "control_change";
+		case Event::PROGRAM_CHANGE:				return "program_change";
+		case Event::CHANNEL_PRESSURE:			return "channel_pressure";
+		case Event::PITCH_BEND:					return "pitch_bend";
+		case Event::SEQUENCE_NUMBER:			return "sequence_number";
+		case Event::USER_TEXT:					return "text";
+		case Event::COPY_RIGHT:					return "copyright";
+		case Event::TRACK_NAME:					return "track_name";
+		case Event::INSTRUMENT_NAME:			return "instrument_name";
+		case Event::LYRIC:						return "lyric";
+		case Event::MARKER:						return "marker";
+		case Event::CUE_POINT:					return "cue_point";
+		case Event::CHANNEL_PREFIX:				return "channel_prefix";
+		case Event::MIDI_PORT:					return "midi_port";
+		case Event::END_OF_TRACK:				return "end_of_track";
+		case Event::SET_TEMPO:					return "set_tempo";
+		case Event::SMPTE_OFFSET:				return "smpte_offset";
+		case Event::TIME_SIGNATURE:				return "time_signature";
+		case Event::KEY_SIGNATURE:				return "key_signature";
+		case Event::SEQUENCE_SPECIFIC:			return "sequence_specific";
+		case Event::SYSEX_MESSAGES:				return "sysex";
+		case Event::MTC_QUARTER_FRAME:			return "mtc_quarter_frame";
+		case Event::SONG_POSITION_POINTER:		return "song_position_pointer";
+		case Event::SONG_REQUEST:				return "song_request";
+		case Event::TUNE_REQUEST:				return "tune_request";
+		case Event::END_OF_SYSEX_MESSAGES:		return "end_of_sysex";
+		case Event::TIMING_CLOCK_FOR_SYNC:		return "timing_clock";
+		case Event::START_CURRENT_SEQUENCE:		return "start";
+		case Event::CONTINUE_STOPPED_SEQUENCE:	return "continue";
+		case Event::STOP_SEQUENCE:				return "stop";
+		case Event::ACTIVE_SENSING:				return "active_sensing";
+		default:								return "unknown";
+	}
+}
+//------------------------------------------------------------------------------
 std::string		Event::str() const
 {
 	std::stringstream ss;
@@ -33,6 +33,18 @@ std::ostream&	MetaEvent::str(std::ostream& os) const
 	return Event::str(os) << " [META] ";
 }
 //------------------------------------------------------------------------------
+void			MetaEvent::binary(std::vector<byte>& output) const
+{
+	write1(output, get_type());
+	write_variable(output, data.size());
+	output.insert(output.end(), data.begin(), data.end());
+}
+//------------------------------------------------------------------------------
+const std::vector<byte>&	MetaEvent::get_data() const
+{
+	return data;
+}
+//------------------------------------------------------------------------------
 void			MetaEvent::set_string_base(const std::string& str)
 {
 	data.resize(str.size());
@@ -62,15 +74,18 @@ std::shared_ptr<Event>	MetaEvent::create(
 )
 {
 	Type type = static_cast<Type>(read1(input, end));
-	int length = read1(input, end);
-	std::vector<byte> tmp(length);
-	std::memcpy(tmp.data(), input, length);
+	uint64_t length = read_variable(input, end);
+	if (length > static_cast<uint64_t>(end - input))
+		throw std::out_of_range(__func__);
+	std::vector<byte> tmp(input, input + length);
 	input += length;
 
 	switch (type)
 	{
 		case SEQUENCE_NUMBER:
-			return std::make_shared<SequenceNumber>(delta_time, tmp[0]);
+			return std::make_shared<SequenceNumber>(
+						delta_time, tmp.size() < 2 ? 0 : (tmp[0] << 8) | tmp[1]
+					);
 		case USER_TEXT:
 			return std::make_shared<UserText>(delta_time, tmp);
 		case COPY_RIGHT:
@@ -254,7 +269,7 @@ TrackName::TrackName(uint64_t delta_time, const std::string& str):
 //------------------------------------------------------------------------------
 MetaEvent::Type			TrackName::get_type() const
 {
-	return USER_TEXT;
+	return TRACK_NAME;
 }
 //------------------------------------------------------------------------------
 std::ostream&			TrackName::str(std::ostream& os) const
@@ -334,7 +349,7 @@ Lyric::Lyric(uint64_t delta_time, const std::string& str):
 //------------------------------------------------------------------------------
 MetaEvent::Type			Lyric::get_type() const
 {
-	return INSTRUMENT_NAME;
+	return LYRIC;
 }
 //------------------------------------------------------------------------------
 std::ostream&			Lyric::str(std::ostream& os) const
@@ -374,7 +389,7 @@ Marker::Marker(uint64_t delta_time, const std::string& str):
 //------------------------------------------------------------------------------
 MetaEvent::Type			Marker::get_type() const
 {
-	return INSTRUMENT_NAME;
+	return MARKER;
 }
 //------------------------------------------------------------------------------
 std::ostream&			Marker::str(std::ostream& os) const
@@ -414,7 +429,7 @@ CuePoint::CuePoint(uint64_t delta_time, const std::string& str):
 //------------------------------------------------------------------------------
 MetaEvent::Type			CuePoint::get_type() const
 {
-	return INSTRUMENT_NAME;
+	return CUE_POINT;
 }
 //------------------------------------------------------------------------------
 std::ostream&			CuePoint::str(std::ostream& os) const
@@ -452,7 +467,7 @@ ChannelPrefix::ChannelPrefix(uint64_t delta_time, int channel):
 //------------------------------------------------------------------------------
 MetaEvent::Type			ChannelPrefix::get_type() const
 {
-	return INSTRUMENT_NAME;
+	return CHANNEL_PREFIX;
 }
 //------------------------------------------------------------------------------
 std::ostream&			ChannelPrefix::str(std::ostream& os) const
@@ -693,7 +708,7 @@ TimeSignature::TimeSignature(
 ):
 	MetaEvent(delta_time)
 {
-	data.resize(5);
+	data.resize(4);
 	data.shrink_to_fit();
 	set(numerator, denominator, metronome_ticks, quarter_note_division_32);
 }
@@ -783,6 +798,8 @@ KeySignature::KeySignature(
 {
 	data.resize(2);
 	data.shrink_to_fit();
+	set_key(key);
+	set_scale(scale);
 }
 //------------------------------------------------------------------------------
 MetaEvent::Type	KeySignature::get_type() const
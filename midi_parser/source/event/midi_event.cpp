@@ -17,6 +17,14 @@ Event::Category	MidiEvent::get_category() const
 	return Event::MIDI;
 }
 //------------------------------------------------------------------------------
+void			MidiEvent::binary(std::vector<byte>& output) const
+{
+	write1(output, data[0]);
+	Type type = get_type();
+	if (type != PROGRAM_CHANGE && type != CHANNEL_PRESSURE)
+		write1(output, data[1]);
+}
+//------------------------------------------------------------------------------
 int				MidiEvent::get_channel() const
 {
 	return channel;
@@ -255,7 +263,7 @@ PolyphonicKeyPressure::PolyphonicKeyPressure(
 //------------------------------------------------------------------------------
 int		PolyphonicKeyPressure::get_status() const
 {
-	return 0x90 | get_channel();
+	return 0xa0 | get_channel();
 }
 //------------------------------------------------------------------------------
 MidiEvent::Type		PolyphonicKeyPressure::get_type() const
@@ -1,7 +1,5 @@
 #include "event/note.h"
 #include "util.h"
-#include <sstream>
-#include <iomanip>
 
 namespace MidiParser {
 /*##########################
@@ -72,85 +70,15 @@ int Note::make_note_number(Pitch pitch, Octave octave)
 //------------------------------------------------------------------------------
 std::string		Note::to_string() const
 {
-	std::stringstream ss;
-	auto octave = get_octave();
-	switch (octave)
-	{
-		case Octave::OCTAVE_MINUS_2:
-			ss << "Oc-2 - "; 
-			break;
-		case Octave::OCTAVE_MINUS_1:
-			ss << "Oc-1 - "; 
-			break;
-		case Octave::OCTAVE_0:
-			ss << "Oc 0 - "; 
-			break;
-		case Octave::OCTAVE_1:
-			ss << "Oc 1 - "; 
-			break;
-		case Octave::OCTAVE_2:
-			ss << "Oc 2 - "; 
-			break;
-		case Octave::OCTAVE_3:
-			ss << "Oc 3 - "; 
-			break;
-		case Octave::OCTAVE_4:
-			ss << "Oc 4 - "; 
-			break;
-		case Octave::OCTAVE_5:
-			ss << "Oc 5 - "; 
-			break;
-		case Octave::OCTAVE_6:
-			ss << "Oc 6 - "; 
-			break;
-		case Octave::OCTAVE_7:
-			ss << "Oc 7 - "; 
-			break;
-		case Octave::OCTAVE_8:
-			ss << "Oc 8 - "; 
-			break;
-	}
-
-	auto pitch = get_pitch();
-	switch (pitch)
-	{
-		case Pitch::C:
-			ss << std::setw(2) << "C"; 
-			break;
-		case Pitch::C_SHARP:
-			ss << std::setw(2) << "C#"; 
-			break;
-		case Pitch::D:
-			ss << std::setw(2) << "D"; 
-			break;
-		case Pitch::D_SHARP:
-			ss << std::setw(2) << "D#"; 
-			break;
-		case Pitch::E:
-			ss << std::setw(2) << "E"; 
-			break;
-		case Pitch::F:
-			ss << std::setw(2) << "F"; 
-			break;
-		case Pitch::F_SHARP:
-			ss << std::setw(2) << "F#"; 
-			break;
-		case Pitch::G:
-			ss << std::setw(2) << "G"; 
-			break;
-		case Pitch::G_SHARP:
-			ss << std::setw(2) << "G#"; 
-			break;
-		case Pitch::A:
-			ss << std::setw(2) << "A"; 
-			break;
-		case Pitch::A_SHARP:
-			ss << std::setw(2) << "A#"; 
-			break;
-		case Pitch::B:
-			ss << std::setw(2) << "B"; 
-			break;
-	}
-	return ss.str();
+	static constexpr const char* octaves[] = {
+		"Oc-2 - ", "Oc-1 - ", "Oc 0 - ", "Oc 1 - ", "Oc 2 - ", "Oc 3 - ",
+		"Oc 4 - ", "Oc 5 - ", "Oc 6 - ", "Oc 7 - ", "Oc 8 - ",
+	};
+	static constexpr const char* pitches[] = {
+		" C", "C#", " D", "D#", " E", " F", "F#", " G", "G#", " A", "A#", " B",
+	};
+	std::string result = octaves[static_cast<int>(get_octave()) + 2];
+	result += pitches[static_cast<int>(get_pitch())];
+	return result;
 }
 } // MidiParser
\ No newline at end of file
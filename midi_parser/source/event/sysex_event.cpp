@@ -27,6 +27,9 @@ std::ostream&	SysexEvent::str(std::ostream& os) const
 	return Event::str(os) << " [Sysex]";
 }
 //------------------------------------------------------------------------------
+void			SysexEvent::binary(std::vector<byte>&) const
+{}
+//------------------------------------------------------------------------------
 std::shared_ptr<Event>	SysexEvent::create(
 	uint64_t				delta_time,
 	byte					status,
@@ -39,14 +42,13 @@ std::shared_ptr<Event>	SysexEvent::create(
 	{
 		case SYSEX_MESSAGES:
 		{
-			byte c;
-			std::vector<byte> data;
-			do
-			{
-				c = data.emplace_back(read1(begin, end));
-			}
-			while (c != END_OF_SYSEX_MESSAGES);
-			return std::make_shared<SysexMessages>(delta_time, data);
+			// F0 <length> <bytes>, the bytes end with F7 unless split into packets
+			uint64_t length = read_variable(begin, end);
+			if (length > static_cast<uint64_t>(end - begin))
+				throw std::out_of_range(__func__);
+			std::vector<byte> data(begin, begin + length);
+			begin += length;
+			return std::make_shared<SysexMessages>(delta_time, std::move(data));
 		}
 		case MTC_QUARTER_FRAME:
 			return std::make_shared<MTCQuarterFrame>(delta_time, read1(begin, end));
@@ -62,7 +64,15 @@ std::shared_ptr<Event>	SysexEvent::create(
 		case TUNE_REQUEST:
 			return std::make_shared<TuneRequest>(delta_time);
 		case END_OF_SYSEX_MESSAGES:
-			return std::make_shared<EndOfSysexMessages>(delta_time);
+		{
+			// F7 <length> <bytes>, an escape or a continued packet
+			uint64_t length = read_variable(begin, end);
+			if (length > static_cast<uint64_t>(end - begin))
+				throw std::out_of_range(__func__);
+			std::vector<byte> data(begin, begin + length);
+			begin += length;
+			return std::make_shared<EndOfSysexMessages>(delta_time, std::move(data));
+		}
 		case TIMING_CLOCK_FOR_SYNC:
 			return std::make_shared<TimingClockForSync>(delta_time);
 		case START_CURRENT_SEQUENCE:
@@ -112,6 +122,11 @@ std::vector<byte>		SysexMessages::get_messages() const
 	return messages;
 }
 //------------------------------------------------------------------------------
+void					SysexMessages::get_messages(std::vector<byte>& output) const
+{
+	output.insert(output.end(), messages.begin(), messages.end());
+}
+//------------------------------------------------------------------------------
 void 					SysexMessages::set_messages(const std::vector<byte>& messages)
 {
 	this->messages = messages;
@@ -121,6 +136,12 @@ void 					SysexMessages::set_messages(std::vector<byte>&& messages)
 {
 	this->messages = std::move(messages);
 }
+//------------------------------------------------------------------------------
+void					SysexMessages::binary(std::vector<byte>& output) const
+{
+	write_variable(output, messages.size());
+	output.insert(output.end(), messages.begin(), messages.end());
+}
 
 
 
@@ -158,6 +179,11 @@ void 					MTCQuarterFrame::set_value(int val)
 	this->value = val;
 }
 //------------------------------------------------------------------------------
+void					MTCQuarterFrame::binary(std::vector<byte>& output) const
+{
+	write1(output, value);
+}
+//------------------------------------------------------------------------------
 
 
 
@@ -209,7 +235,15 @@ void 				SongPositionPointer::set_position(int position)
 //------------------------------------------------------------------------------
 void	 			SongPositionPointer::set_position(byte b0, byte b1)
 {
-	position = ((static_cast<int>(b0) << 7) & 0x7f) | (b1 & 0x7f);
+	position = ((static_cast<int>(b0) & 0x7f) << 7) | (b1 & 0x7f);
+}
+//------------------------------------------------------------------------------
+void				SongPositionPointer::binary(std::vector<byte>& output) const
+{
+	byte b0, b1;
+	get_position(b0, b1);
+	write1(output, b0);
+	write1(output, b1);
 }
 
 
@@ -248,6 +282,11 @@ void 				SongRequest::set_song(int song)
 {
 	this->song = std::clamp(song, 0, 127);
 }
+//------------------------------------------------------------------------------
+void				SongRequest::binary(std::vector<byte>& output) const
+{
+	write1(output, song);
+}
 
 
 
@@ -285,6 +324,13 @@ EndOfSysexMessages::EndOfSysexMessages(uint64_t delta_time):
 	SysexEvent(delta_time)
 {}
 //------------------------------------------------------------------------------
+EndOfSysexMessages::EndOfSysexMessages(
+	uint64_t				delta_time,
+	std::vector<byte>&&		messages
+) noexcept:
+	SysexEvent(delta_time), messages(std::move(messages))
+{}
+//------------------------------------------------------------------------------
 SysexEvent::Type	EndOfSysexMessages::get_type() const
 {
 	return END_OF_SYSEX_MESSAGES;
@@ -297,6 +343,22 @@ std::ostream&		EndOfSysexMessages::str(std::ostream& os) const
 		<< std::setw(print_width_type)
 		<< "End Of Sysex Msg | ";
 }
+//------------------------------------------------------------------------------
+const std::vector<byte>&	EndOfSysexMessages::get_messages() const
+{
+	return messages;
+}
+//------------------------------------------------------------------------------
+void				EndOfSysexMessages::set_messages(std::vector<byte>&& messages)
+{
+	this->messages = std::move(messages);
+}
+//------------------------------------------------------------------------------
+void				EndOfSysexMessages::binary(std::vector<byte>& output) const
+{
+	write_variable(output, messages.size());
+	output.insert(output.end(), messages.begin(), messages.end());
+}
 
 
 
@@ -0,0 +1,576 @@
+#include "event_index.h"
+#include "event/midi_event.h"
+#include "mapped_file.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	Image
+
+##########################*/
+namespace {
+enum Section
+{
+	TRACK_OFFSETS,
+	KEYS,
+	DATA,
+	SECTION_COUNT
+};
+
+constexpr char		image_magic[4] = {'M', 'P', 'E', 'I'};
+constexpr uint32_t	image_version = 1;
+constexpr uint32_t	image_byte_order = 0x01020304;
+
+// keys: the types of meta events, of the others, then by channel
+constexpr uint32_t	type_keys = 0;
+constexpr uint32_t	channel_type_keys = 512; // 16 channels * 8
+constexpr uint32_t	channel_key_keys = 640; // 16 channels * 128 keys
+constexpr uint32_t	key_count = 2688;
+
+constexpr uint64_t	align(uint64_t offset)
+{
+	return (offset + 7) & ~uint64_t(7);
+}
+//------------------------------------------------------------------------------
+uint32_t			get_type_key(bool meta, int type)
+{
+	return type_keys + (meta ? 0 : 256) + (type & 0xff);
+}
+//------------------------------------------------------------------------------
+void				write_varint(std::vector<byte>& output, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		output.push_back(static_cast<byte>(value | 0x80));
+		value >>= 7;
+	}
+	output.push_back(static_cast<byte>(value));
+}
+} // anonymous
+
+struct EventIndex::Key
+{
+	uint32_t		key;
+	uint32_t		count; // events
+	uint64_t		offset; // in data, the skip table then the deltas
+	uint64_t		size;
+};
+
+struct EventIndex::Header
+{
+	char			magic[4];
+	uint32_t		version;
+	uint32_t		byte_order;
+	uint32_t		header_size;
+	uint32_t		key_size;
+	uint32_t		track_count;
+	uint64_t		key_count; // keys with events
+	uint64_t		source_size;
+	int64_t			source_time;
+	uint64_t		source_checksum;
+	uint64_t		event_count;
+	uint64_t		data_size;
+	uint64_t		image_size;
+	uint64_t		sections[SECTION_COUNT]; // offsets from the start of the image
+
+	uint64_t		get_section_size(int section) const
+	{
+		switch (section)
+		{
+			case TRACK_OFFSETS:		return (track_count + uint64_t(1)) * sizeof(uint64_t);
+			case KEYS:				return key_count * sizeof(Key);
+			default:				return data_size;
+		}
+	}
+
+	void			layout()
+	{
+		uint64_t offset = align(sizeof(Header));
+		for (int i = 0; i < SECTION_COUNT; ++i)
+		{
+			sections[i] = offset;
+			offset = align(offset + get_section_size(i));
+		}
+		image_size = offset;
+	}
+
+	template <typename T>
+	T*				get_section(const byte* image, int section) const
+	{
+		return reinterpret_cast<T*>(const_cast<byte*>(image) + sections[section]);
+	}
+};
+
+
+
+
+/*##########################
+
+	EventIndex::Builder
+
+##########################*/
+class EventIndex::Builder
+{
+public:
+	Builder():
+		lists(key_count)
+	{}
+
+	void			add(uint32_t event, bool meta, int status, int type, int data0)
+	{
+		lists[get_type_key(meta, type)].push_back(event);
+		if (meta || status < 0x80 || status >= 0xf0)
+			return;
+		int channel = status & 0xf;
+		lists[channel_type_keys + channel * 8 + (type & 7)].push_back(event);
+		if (type == Event::NOTE_OFF || type == Event::NOTE_ON || type == Event::POLYPHONIC_KEY_PRESSURE)
+			lists[channel_key_keys + channel * 128 + (data0 & 0x7f)].push_back(event);
+	}
+
+	// h has the source and the counts of tracks and events, the rest is filled in
+	void			finish(Header& h, const std::vector<uint64_t>& track_offsets, EventIndex& index)
+	{
+		std::vector<Key> keys;
+		std::vector<byte> data;
+		for (uint32_t key = 0; key < key_count; ++key)
+		{
+			const std::vector<uint32_t>& list = lists[key];
+			if (list.empty())
+				continue;
+			// the skip table is read as uint32_t
+			data.resize((data.size() + 3) & ~size_t(3));
+			size_t block_count = (list.size() + block_size - 1) / block_size;
+			size_t offset = data.size();
+			std::vector<uint32_t> skips(block_count * 2); // firsts, then offsets
+			data.resize(offset + skips.size() * sizeof(uint32_t));
+			size_t deltas = data.size();
+			for (size_t block = 0; block < block_count; ++block)
+			{
+				size_t begin = block * block_size;
+				size_t end = std::min(begin + block_size, list.size());
+				skips[block] = list[begin];
+				skips[block_count + block] = data.size() - deltas;
+				for (size_t i = begin + 1; i < end; ++i)
+					write_varint(data, list[i] - list[i - 1]);
+			}
+			std::memcpy(data.data() + offset, skips.data(), skips.size() * sizeof(uint32_t));
+			keys.push_back({key, static_cast<uint32_t>(list.size()), offset, data.size() - offset});
+		}
+
+		std::memcpy(h.magic, image_magic, sizeof(image_magic));
+		h.version = image_version;
+		h.byte_order = image_byte_order;
+		h.header_size = sizeof(Header);
+		h.key_size = sizeof(Key);
+		h.key_count = keys.size();
+		h.data_size = data.size();
+		h.layout();
+		auto storage = std::make_shared<std::vector<uint64_t>>(h.image_size / sizeof(uint64_t));
+		byte* image = reinterpret_cast<byte*>(storage->data());
+		std::memcpy(image, &h, sizeof(h));
+		std::memcpy(h.get_section<byte>(image, TRACK_OFFSETS), track_offsets.data(), h.get_section_size(TRACK_OFFSETS));
+		std::memcpy(h.get_section<byte>(image, KEYS), keys.data(), h.get_section_size(KEYS));
+		std::memcpy(h.get_section<byte>(image, DATA), data.data(), data.size());
+		index.attach(storage, image, h.image_size);
+	}
+
+
+private:
+	std::vector<std::vector<uint32_t>>	lists; // by key
+};
+
+
+
+
+/*##########################
+
+	EventIndex::Postings
+
+##########################*/
+size_t			EventIndex::Postings::size() const
+{
+	return count;
+}
+//------------------------------------------------------------------------------
+bool			EventIndex::Postings::empty() const
+{
+	return count == 0;
+}
+//------------------------------------------------------------------------------
+void			EventIndex::Postings::decode(std::vector<uint32_t>& output) const
+{
+	size_t begin = output.size();
+	output.resize(begin + count);
+	for (size_t block = 0; block < get_block_count(); ++block)
+		decode_block(block, output.data() + begin + block * block_size);
+}
+//------------------------------------------------------------------------------
+std::vector<uint32_t>	EventIndex::Postings::decode() const
+{
+	std::vector<uint32_t> output;
+	decode(output);
+	return output;
+}
+//------------------------------------------------------------------------------
+size_t			EventIndex::Postings::get_block_count() const
+{
+	return (count + block_size - 1) / block_size;
+}
+//------------------------------------------------------------------------------
+size_t			EventIndex::Postings::decode_block(size_t block, uint32_t* output) const
+{
+	size_t count = std::min<size_t>(block_size, this->count - block * block_size);
+	const byte* begin = data + offsets[block];
+	const byte* end = block + 1 < get_block_count() ? data + offsets[block + 1] : data + data_size;
+	uint32_t value = firsts[block];
+	output[0] = value;
+	for (size_t i = 1; i < count; ++i)
+	{
+		uint32_t delta = 0;
+		for (int shift = 0;; shift += 7)
+		{
+			if (begin == end || shift > 28)
+				throw std::runtime_error("Invalid index file");
+			byte b = *begin++;
+			delta |= static_cast<uint32_t>(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				break;
+		}
+		value += delta;
+		output[i] = value;
+	}
+	return count;
+}
+
+
+
+
+/*##########################
+
+	EventIndex
+
+##########################*/
+EventIndex::EventIndex(const Midi& midi)
+{
+	build(midi);
+}
+//------------------------------------------------------------------------------
+EventIndex::EventIndex(const EventTable& table)
+{
+	build(table);
+}
+//------------------------------------------------------------------------------
+EventIndex::EventIndex(const std::filesystem::path& index_path)
+{
+	load(index_path);
+}
+//------------------------------------------------------------------------------
+void			EventIndex::build(const Midi& midi)
+{
+	clear();
+	if (static_cast<uint64_t>(midi.event_count()) > UINT32_MAX)
+		throw std::length_error("EventIndex: too many events");
+
+	Header h = {};
+	std::vector<uint64_t> track_offsets;
+	Builder builder;
+	uint32_t i = 0;
+	for (const Track& track: midi.tracks)
+	{
+		track_offsets.push_back(i);
+		for (const Event::ptr& event: track.events)
+		{
+			int data0 = 0;
+			if (event->get_category() == Event::MIDI)
+				data0 = static_cast<const MidiEvent&>(*event).data[0];
+			builder.add(i++, event->get_category() == Event::META, event->get_status(), event->get_type(), data0);
+		}
+	}
+	track_offsets.push_back(i);
+	h.track_count = midi.tracks.size();
+	h.event_count = i;
+
+	// the file as the midi read it, not as it may be now
+	std::span<const byte> source = midi.get_source();
+	if (!source.empty())
+	{
+		h.source_size = source.size();
+		h.source_time = midi.get_source_time();
+		h.source_checksum = hash_bytes(source.data(), source.size());
+	}
+	builder.finish(h, track_offsets, *this);
+}
+//------------------------------------------------------------------------------
+void			EventIndex::build(const EventTable& table)
+{
+	clear();
+	if (table.size() > UINT32_MAX)
+		throw std::length_error("EventIndex: too many events");
+
+	auto statuses = table.get_statuses();
+	auto types = table.get_types();
+	auto data0 = table.get_data0();
+	Builder builder;
+	for (uint32_t i = 0; i < table.size(); ++i)
+		builder.add(i, statuses[i] == 0xff, statuses[i], types[i], data0[i]);
+
+	Header h = {};
+	std::vector<uint64_t> track_offsets;
+	for (int track = 0; track < table.get_track_count(); ++track)
+		track_offsets.push_back(table.get_track_begin(track));
+	track_offsets.push_back(table.size());
+	h.track_count = table.get_track_count();
+	h.event_count = table.size();
+	h.source_size = table.get_source_size();
+	h.source_time = table.get_source_time();
+	h.source_checksum = table.get_source_checksum();
+	builder.finish(h, track_offsets, *this);
+}
+//------------------------------------------------------------------------------
+void			EventIndex::load(const std::filesystem::path& index_path)
+{
+	clear();
+	auto file = std::make_shared<MappedFile>(index_path);
+	attach(file, file->data(), file->size());
+}
+//------------------------------------------------------------------------------
+void			EventIndex::save(const std::filesystem::path& index_path) const
+{
+	if (!header)
+		throw std::logic_error("EventIndex: empty");
+	// renamed into place, tables mapping the old file keep it
+	replace_bin_file(index_path, {reinterpret_cast<const byte*>(header), header->image_size});
+}
+//------------------------------------------------------------------------------
+void			EventIndex::clear()
+{
+	*this = EventIndex();
+}
+//------------------------------------------------------------------------------
+EventIndex		EventIndex::load_cached(
+	const std::filesystem::path&	midi_path,
+	const std::filesystem::path&	index_path
+)
+{
+	uint64_t size;
+	int64_t time;
+	get_file_stamp(midi_path, size, time);
+
+	EventIndex index;
+	if (std::filesystem::exists(index_path))
+	{
+		try
+		{
+			index.load(index_path);
+			if (index.header->source_size == size && index.header->source_time == time)
+				return index;
+		}
+		catch (const std::runtime_error&)
+		{
+			// stale or broken, build again
+		}
+	}
+	index.build(Midi(midi_path));
+	// an index that can not be written is not worth failing the load
+	try
+	{
+		index.save(index_path);
+	}
+	catch (const std::runtime_error&)
+	{}
+	return index;
+}
+//------------------------------------------------------------------------------
+size_t			EventIndex::size() const
+{
+	return header ? header->event_count : 0;
+}
+//------------------------------------------------------------------------------
+bool			EventIndex::empty() const
+{
+	return size() == 0;
+}
+//------------------------------------------------------------------------------
+int				EventIndex::get_track_count() const
+{
+	return header ? header->track_count : 0;
+}
+//------------------------------------------------------------------------------
+size_t			EventIndex::get_track_begin(int track) const
+{
+	if (track < 0 || track >= get_track_count())
+		throw std::out_of_range(__func__);
+	return track_offsets[track];
+}
+//------------------------------------------------------------------------------
+size_t			EventIndex::get_track_end(int track) const
+{
+	if (track < 0 || track >= get_track_count())
+		throw std::out_of_range(__func__);
+	return track_offsets[track + 1];
+}
+//------------------------------------------------------------------------------
+void			EventIndex::locate(uint32_t event, int& track, size_t& index) const
+{
+	if (event >= size())
+		throw std::out_of_range(__func__);
+	// the last track beginning at or before the event, empty tracks skipped
+	const uint64_t* end = track_offsets + header->track_count + 1;
+	track = std::upper_bound(track_offsets, end, event) - track_offsets - 1;
+	index = event - track_offsets[track];
+}
+//------------------------------------------------------------------------------
+uint64_t		EventIndex::get_source_checksum() const
+{
+	return header ? header->source_checksum : 0;
+}
+//------------------------------------------------------------------------------
+EventIndex::Postings	EventIndex::find(Event::Type type) const
+{
+	// the types of midi and sysex events, the rest are meta
+	bool meta = !(type >= Event::NOTE_OFF && type <= Event::PITCH_BEND) && type < 0xf0;
+	return find(get_type_key(meta, type));
+}
+//------------------------------------------------------------------------------
+EventIndex::Postings	EventIndex::find(int channel, Event::Type type) const
+{
+	if (channel < 0 || channel >= 16 || type < Event::NOTE_OFF || type > Event::PITCH_BEND)
+		throw std::out_of_range(__func__);
+	return find(channel_type_keys + channel * 8 + (type & 7));
+}
+//------------------------------------------------------------------------------
+EventIndex::Postings	EventIndex::find_key(int channel, int key) const
+{
+	if (channel < 0 || channel >= 16 || key < 0 || key >= 128)
+		throw std::out_of_range(__func__);
+	return find(channel_key_keys + channel * 128 + key);
+}
+//------------------------------------------------------------------------------
+std::vector<uint32_t>	EventIndex::intersect(const Postings& a, const Postings& b)
+{
+	if (a.size() > b.size())
+		return intersect(b, a);
+	return intersect(a.decode(), b);
+}
+//------------------------------------------------------------------------------
+std::vector<uint32_t>	EventIndex::intersect(std::span<const uint32_t> events, const Postings& postings)
+{
+	// the block where each event would be, decoded once it is reached
+	std::vector<uint32_t> result;
+	uint32_t buffer[block_size];
+	size_t block_count = postings.get_block_count();
+	size_t block = 0;
+	size_t decoded = SIZE_MAX;
+	size_t count = 0;
+	size_t position = 0;
+	for (uint32_t event: events)
+	{
+		while (block + 1 < block_count && postings.firsts[block + 1] <= event)
+			++block;
+		if (block_count == 0 || postings.firsts[block] > event)
+			continue;
+		if (decoded != block)
+		{
+			count = postings.decode_block(block, buffer);
+			decoded = block;
+			position = 0;
+		}
+		while (position < count && buffer[position] < event)
+			++position;
+		if (position < count && buffer[position] == event)
+			result.push_back(event);
+	}
+	return result;
+}
+//------------------------------------------------------------------------------
+EventIndex::Postings	EventIndex::find(uint32_t key) const
+{
+	Postings postings;
+	if (!header)
+		return postings;
+	const Key* end = keys + header->key_count;
+	const Key* found = std::lower_bound(keys, end, key, [](const Key& a, uint32_t key){ return a.key < key; });
+	if (found == end || found->key != key)
+		return postings;
+
+	// the skip table is checked here rather than on load, for the lists used
+	size_t block_count = (found->count + block_size - 1) / block_size;
+	auto* skips = reinterpret_cast<const uint32_t*>(data + found->offset);
+	postings.count = found->count;
+	postings.firsts = skips;
+	postings.offsets = skips + block_count;
+	postings.data = data + found->offset + block_count * 2 * sizeof(uint32_t);
+	postings.data_size = found->size - block_count * 2 * sizeof(uint32_t);
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		if (postings.offsets[block] > postings.data_size
+			|| (block > 0 && (postings.offsets[block] < postings.offsets[block - 1]
+				|| postings.firsts[block] <= postings.firsts[block - 1])))
+			throw std::runtime_error("Invalid index file");
+	}
+	return postings;
+}
+//------------------------------------------------------------------------------
+void			EventIndex::attach(
+	std::shared_ptr<const void>		owner,
+	const byte*						image,
+	size_t							size
+)
+{
+	auto* h = reinterpret_cast<const Header*>(image);
+	if (size < sizeof(Header)
+		|| reinterpret_cast<uintptr_t>(image) % alignof(Header)
+		|| std::memcmp(h->magic, image_magic, sizeof(image_magic))
+		|| h->version != image_version
+		|| h->byte_order != image_byte_order
+		|| h->header_size != sizeof(Header)
+		|| h->key_size != sizeof(Key)
+		|| h->image_size != size
+		|| h->key_count > key_count
+		|| h->event_count > UINT32_MAX
+		|| h->track_count > size
+		|| h->data_size > size)
+		throw std::runtime_error("Invalid index file");
+	for (int i = 0; i < SECTION_COUNT; ++i)
+	{
+		if (h->sections[i] % 8
+			|| h->sections[i] > size
+			|| h->get_section_size(i) > size - h->sections[i])
+			throw std::runtime_error("Invalid index file");
+	}
+
+	auto* offsets = h->get_section<const uint64_t>(image, TRACK_OFFSETS);
+	for (uint32_t i = 0; i < h->track_count; ++i)
+	{
+		if (offsets[i] > offsets[i + 1])
+			throw std::runtime_error("Invalid index file");
+	}
+	if (offsets[0] != 0 || offsets[h->track_count] != h->event_count)
+		throw std::runtime_error("Invalid index file");
+
+	// a key per list, so this is bounded whatever the file
+	auto* k = h->get_section<const Key>(image, KEYS);
+	for (uint64_t i = 0; i < h->key_count; ++i)
+	{
+		uint64_t block_count = (k[i].count + uint64_t(block_size) - 1) / block_size;
+		if (k[i].key >= key_count
+			|| (i > 0 && k[i].key <= k[i - 1].key)
+			|| k[i].count == 0 || k[i].count > h->event_count
+			|| k[i].offset % 4
+			|| k[i].offset > h->data_size
+			|| k[i].size > h->data_size - k[i].offset
+			|| k[i].size < block_count * 2 * sizeof(uint32_t))
+			throw std::runtime_error("Invalid index file");
+	}
+
+	this->owner = std::move(owner);
+	header = h;
+	track_offsets = offsets;
+	keys = k;
+	data = h->get_section<const byte>(image, DATA);
+}
+} // MidiParser
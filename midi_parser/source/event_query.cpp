@@ -0,0 +1,419 @@
+#include "event_query.h"
+#include "measure_map.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace MidiParser {
+namespace {
+constexpr size_t	block_rows = 4096; // rows the terms run over in turn, in cache
+constexpr size_t	group_rows = 1 << 16; // rows a thread takes at once
+
+// a bit per flag byte(0 or 1), flags[i] as bit i
+uint64_t			pack(const byte* flags)
+{
+	uint64_t bits = 0;
+	for (int k = 0; k < 8; ++k)
+	{
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			// each byte lands in the top byte, none carries
+			uint64_t x;
+			std::memcpy(&x, flags + 8 * k, 8);
+			bits |= ((x * 0x0102040810204080) >> 56) << (8 * k);
+		}
+		else
+		{
+			for (int i = 0; i < 8; ++i)
+				bits |= static_cast<uint64_t>(flags[8 * k + i]) << (8 * k + i);
+		}
+	}
+	return bits;
+}
+//------------------------------------------------------------------------------
+// value & mask in [first, last], as one unsigned compare:
+// value - first wraps around above last - first when below first
+template <typename T, bool Masked>
+void				match_values(
+	const T*			values,
+	size_t				count,
+	uint64_t			mask,
+	uint64_t			first,
+	uint64_t			last,
+	uint64_t*			words,
+	bool				assign
+)
+{
+	using U = std::make_unsigned_t<T>;
+	const U m = static_cast<U>(mask);
+	const U low = static_cast<U>(first);
+	const U span = static_cast<U>(static_cast<U>(last) - low);
+	auto test = [&](T value) -> byte
+	{
+		U x = static_cast<U>(value);
+		if constexpr (Masked)
+			x &= m;
+		return static_cast<U>(x - low) <= span;
+	};
+
+	size_t word_count = count / 64;
+	for (size_t w = 0; w < word_count; ++w)
+	{
+		if (!assign && words[w] == 0)
+			continue;
+		const T* v = values + w * 64;
+		byte flags[64];
+		for (size_t j = 0; j < 64; ++j)
+			flags[j] = test(v[j]);
+		uint64_t bits = pack(flags);
+		words[w] = assign ? bits : words[w] & bits;
+	}
+	if (count % 64)
+	{
+		uint64_t bits = 0;
+		for (size_t j = word_count * 64; j < count; ++j)
+			bits |= static_cast<uint64_t>(test(values[j])) << (j % 64);
+		words[word_count] = assign ? bits : words[word_count] & bits;
+	}
+}
+} // anonymous
+
+
+
+
+/*##########################
+
+	Selection
+
+##########################*/
+Selection::Selection(size_t size, bool value):
+	length(size), words((size + 63) / 64, value ? UINT64_MAX : 0)
+{
+	clear_tail();
+}
+//------------------------------------------------------------------------------
+Selection::Selection(size_t size, std::span<const uint32_t> rows):
+	Selection(size)
+{
+	for (uint32_t row: rows)
+		set(row);
+}
+//------------------------------------------------------------------------------
+size_t				Selection::size() const
+{
+	return length;
+}
+//------------------------------------------------------------------------------
+size_t				Selection::count() const
+{
+	size_t count = 0;
+	for (uint64_t word: words)
+		count += std::popcount(word);
+	return count;
+}
+//------------------------------------------------------------------------------
+bool				Selection::test(size_t row) const
+{
+	if (row >= length)
+		throw std::out_of_range(__func__);
+	return words[row / 64] >> (row % 64) & 1;
+}
+//------------------------------------------------------------------------------
+void				Selection::set(size_t row, bool value)
+{
+	if (row >= length)
+		throw std::out_of_range(__func__);
+	if (value)
+		words[row / 64] |= uint64_t(1) << (row % 64);
+	else
+		words[row / 64] &= ~(uint64_t(1) << (row % 64));
+}
+//------------------------------------------------------------------------------
+std::vector<uint32_t>	Selection::get_rows() const
+{
+	std::vector<uint32_t> rows;
+	rows.reserve(count());
+	for_each([&](size_t row){ rows.push_back(row); });
+	return rows;
+}
+//------------------------------------------------------------------------------
+std::span<const uint64_t>	Selection::get_words() const
+{
+	return words;
+}
+//------------------------------------------------------------------------------
+std::span<uint64_t>	Selection::get_words()
+{
+	return words;
+}
+//------------------------------------------------------------------------------
+Selection&			Selection::operator&=(const Selection& other)
+{
+	check_size(other);
+	for (size_t i = 0; i < words.size(); ++i)
+		words[i] &= other.words[i];
+	return *this;
+}
+//------------------------------------------------------------------------------
+Selection&			Selection::operator|=(const Selection& other)
+{
+	check_size(other);
+	for (size_t i = 0; i < words.size(); ++i)
+		words[i] |= other.words[i];
+	return *this;
+}
+//------------------------------------------------------------------------------
+Selection&			Selection::operator^=(const Selection& other)
+{
+	check_size(other);
+	for (size_t i = 0; i < words.size(); ++i)
+		words[i] ^= other.words[i];
+	return *this;
+}
+//------------------------------------------------------------------------------
+Selection			Selection::operator~() const
+{
+	Selection result = *this;
+	for (uint64_t& word: result.words)
+		word = ~word;
+	result.clear_tail();
+	return result;
+}
+//------------------------------------------------------------------------------
+void				Selection::check_size(const Selection& other) const
+{
+	if (length != other.length)
+		throw std::logic_error("Selection: sizes differ");
+}
+//------------------------------------------------------------------------------
+void				Selection::clear_tail()
+{
+	if (length % 64)
+		words.back() &= (uint64_t(1) << (length % 64)) - 1;
+}
+
+
+
+
+/*##########################
+
+	EventQuery
+
+##########################*/
+EventQuery&			EventQuery::type(Event::Type type)
+{
+	if (typed && event_type != type)
+		none = true;
+	typed = true;
+	event_type = type;
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::channel(int first, int last)
+{
+	if (first < 0 || last > 15)
+		throw std::out_of_range(__func__);
+	narrow(channels, first, last);
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::channel(int channel)
+{
+	return this->channel(channel, channel);
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::data0(int first, int last)
+{
+	if (first < 0 || last > 255)
+		throw std::out_of_range(__func__);
+	narrow(data0_range, first, last);
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::data1(int first, int last)
+{
+	if (first < 0 || last > 255)
+		throw std::out_of_range(__func__);
+	narrow(data1_range, first, last);
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::track(int first, int last)
+{
+	if (first < 0 || last > UINT16_MAX)
+		throw std::out_of_range(__func__);
+	narrow(track_range, first, last);
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::ticks(uint64_t first, uint64_t last)
+{
+	if (last == 0)
+		none = true;
+	else
+		narrow(tick_range, first, last - 1);
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::time(Microseconds first, Microseconds last)
+{
+	if (last.count() == INT64_MIN)
+	{
+		none = true;
+		return *this;
+	}
+	time_first = std::max(time_first, first.count());
+	time_last = std::min(time_last, last.count() - 1);
+	if (time_first > time_last)
+		none = true;
+	return *this;
+}
+//------------------------------------------------------------------------------
+EventQuery&			EventQuery::bars(int64_t first, int64_t last)
+{
+	bar_first = std::max(bar_first, first);
+	bar_last = std::min(bar_last, last);
+	if (bar_first > bar_last || bar_last < 0)
+		none = true;
+	return *this;
+}
+//------------------------------------------------------------------------------
+Selection			EventQuery::select(const EventTable& table) const
+{
+	std::vector<Term> terms = compile(table);
+	if (terms.empty())
+		return Selection(table.size(), true);
+
+	Selection selection(table.size());
+	uint64_t* words = selection.get_words().data();
+	size_t group_count = (table.size() + group_rows - 1) / group_rows;
+	parallel_for(group_count, [&](size_t group)
+	{
+		size_t end = std::min(table.size(), (group + 1) * group_rows);
+		for (size_t begin = group * group_rows; begin < end; begin += block_rows)
+		{
+			size_t block_end = std::min(end, begin + block_rows);
+			for (size_t i = 0; i < terms.size(); ++i)
+				match(table, terms[i], begin, block_end, words + begin / 64, i == 0);
+		}
+	});
+	return selection;
+}
+//------------------------------------------------------------------------------
+void				EventQuery::narrow(Range& range, uint64_t first, uint64_t last)
+{
+	range.first = std::max(range.first, first);
+	range.last = std::min(range.last, last);
+	if (range.first > range.last)
+		none = true;
+}
+//------------------------------------------------------------------------------
+std::vector<EventQuery::Term>	EventQuery::compile(const EventTable& table) const
+{
+	// status & 0 is never 1
+	const std::vector<Term> nothing = {{STATUS, 0, 1, 1}};
+	if (none)
+		return nothing;
+
+	std::vector<Term> terms;
+	bool all_channels = channels.first == 0 && channels.last == 15;
+	if (typed && event_type >= Event::NOTE_OFF && event_type <= Event::PITCH_BEND)
+	{
+		// the type and the channels are one range of status bytes
+		uint64_t status = event_type << 4;
+		terms.push_back({STATUS, 0xff, status | channels.first, status | channels.last});
+	}
+	else if (typed)
+	{
+		if (!all_channels)
+			return nothing;
+		if (event_type >= 0xf0)
+		{
+			terms.push_back({STATUS, 0xff, uint64_t(event_type), uint64_t(event_type)});
+		}
+		else
+		{
+			terms.push_back({STATUS, 0xff, 0xff, 0xff});
+			terms.push_back({TYPE, 0xff, uint64_t(event_type), uint64_t(event_type)});
+		}
+	}
+	else if (!all_channels)
+	{
+		terms.push_back({STATUS, 0xff, 0x80, 0xef});
+		terms.push_back({STATUS, 0x0f, channels.first, channels.last});
+	}
+
+	if (data0_range.first != 0 || data0_range.last != 255)
+		terms.push_back({DATA0, 0xff, data0_range.first, data0_range.last});
+	if (data1_range.first != 0 || data1_range.last != 255)
+		terms.push_back({DATA1, 0xff, data1_range.first, data1_range.last});
+	if (track_range.first != 0 || track_range.last != UINT16_MAX)
+		terms.push_back({TRACK, UINT16_MAX, track_range.first, track_range.last});
+
+	Range ticks = tick_range;
+	if (bar_first != INT64_MIN || bar_last != INT64_MAX)
+	{
+		MeasureMap measure_map = table.get_measure_map();
+		ticks.first = std::max(ticks.first, measure_map.get_tick(bar_first));
+		if (bar_last != INT64_MAX)
+		{
+			uint64_t end = measure_map.get_tick(bar_last + 1);
+			if (end == 0)
+				return nothing;
+			ticks.last = std::min(ticks.last, end - 1);
+		}
+		if (ticks.first > ticks.last)
+			return nothing;
+	}
+	if (ticks.first != 0 || ticks.last != UINT64_MAX)
+		terms.push_back({TICK, UINT64_MAX, ticks.first, ticks.last});
+	if (time_first != INT64_MIN || time_last != INT64_MAX)
+	{
+		terms.push_back({
+			TIME, UINT64_MAX, static_cast<uint64_t>(time_first), static_cast<uint64_t>(time_last)
+		});
+	}
+	return terms;
+}
+//------------------------------------------------------------------------------
+void				EventQuery::match(
+	const EventTable&	table,
+	const Term&			term,
+	size_t				begin,
+	size_t				end,
+	uint64_t*			words,
+	bool				first
+)
+{
+	size_t count = end - begin;
+	switch (term.column)
+	{
+		case STATUS:
+			if (term.mask != 0xff)
+				match_values<byte, true>(table.get_statuses().data() + begin, count, term.mask, term.first, term.last, words, first);
+			else
+				match_values<byte, false>(table.get_statuses().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+		case TYPE:
+			match_values<byte, false>(table.get_types().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+		case DATA0:
+			match_values<byte, false>(table.get_data0().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+		case DATA1:
+			match_values<byte, false>(table.get_data1().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+		case TRACK:
+			match_values<uint16_t, false>(table.get_tracks().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+		case TICK:
+			match_values<uint64_t, false>(table.get_ticks().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+		case TIME:
+			match_values<int64_t, false>(table.get_times().data() + begin, count, term.mask, term.first, term.last, words, first);
+			break;
+	}
+}
+} // MidiParser
@@ -0,0 +1,555 @@
+#include "event_table.h"
+#include "event/meta_event.h"
+#include "event/midi_event.h"
+#include "event/sysex_event.h"
+#include "mapped_file.h"
+#include "util.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	Image
+
+##########################*/
+namespace {
+enum Section
+{
+	TRACK_OFFSETS,
+	TICKS,
+	TIMES,
+	TRACKS,
+	STATUSES,
+	TYPES,
+	DATA0,
+	DATA1,
+	PAYLOAD_OFFSETS,
+	TEMPO_SEGMENTS,
+	MEASURE_SEGMENTS,
+	PAYLOAD, // last, its size is known only after the events
+	SECTION_COUNT
+};
+
+constexpr char		image_magic[4] = {'M', 'P', 'E', 'T'};
+constexpr uint32_t	image_version = 1;
+constexpr uint32_t	image_byte_order = 0x01020304;
+
+constexpr uint64_t	align(uint64_t offset)
+{
+	return (offset + 7) & ~uint64_t(7);
+}
+} // anonymous
+
+struct EventTable::Header
+{
+	char			magic[4];
+	uint32_t		version;
+	uint32_t		byte_order;
+	uint32_t		header_size;
+	uint32_t		tempo_segment_size;
+	uint32_t		measure_segment_size;
+	uint32_t		format;
+	uint32_t		division_type;
+	uint16_t		division[2];
+	uint32_t		track_count;
+	uint64_t		source_size;
+	int64_t			source_time;
+	uint64_t		source_checksum;
+	uint64_t		event_count;
+	uint64_t		payload_size;
+	uint64_t		tempo_count;
+	uint64_t		measure_count;
+	uint64_t		ticks_per_quarter_note;
+	uint64_t		image_size;
+	uint64_t		sections[SECTION_COUNT]; // offsets from the start of the image
+
+	uint64_t		get_section_size(int section) const
+	{
+		switch (section)
+		{
+			case TRACK_OFFSETS:		return (track_count + uint64_t(1)) * sizeof(uint64_t);
+			case TICKS:				return event_count * sizeof(uint64_t);
+			case TIMES:				return event_count * sizeof(int64_t);
+			case TRACKS:			return event_count * sizeof(uint16_t);
+			case PAYLOAD_OFFSETS:	return (event_count + 1) * sizeof(uint32_t);
+			case TEMPO_SEGMENTS:	return tempo_count * tempo_segment_size;
+			case MEASURE_SEGMENTS:	return measure_count * measure_segment_size;
+			case PAYLOAD:			return payload_size;
+			default:				return event_count; // a byte per event
+		}
+	}
+
+	void			layout()
+	{
+		uint64_t offset = align(sizeof(Header));
+		for (int i = 0; i < SECTION_COUNT; ++i)
+		{
+			sections[i] = offset;
+			offset = align(offset + get_section_size(i));
+		}
+		image_size = offset;
+	}
+
+	template <typename T>
+	T*				get_section(const byte* image, int section) const
+	{
+		return reinterpret_cast<T*>(const_cast<byte*>(image) + sections[section]);
+	}
+};
+
+
+
+
+/*##########################
+
+	EventTable
+
+##########################*/
+EventTable::EventTable(const Midi& midi)
+{
+	build(midi);
+}
+//------------------------------------------------------------------------------
+EventTable::EventTable(const std::filesystem::path& cache_path)
+{
+	load(cache_path);
+}
+//------------------------------------------------------------------------------
+void			EventTable::build(const Midi& midi)
+{
+	clear();
+	if (midi.tracks.size() > 0xffff)
+		throw std::invalid_argument("EventTable: too many tracks");
+	TempoMap tempo_map(midi);
+	MeasureMap measure_map(midi);
+
+	Header h = {};
+	std::memcpy(h.magic, image_magic, sizeof(image_magic));
+	h.version = image_version;
+	h.byte_order = image_byte_order;
+	h.header_size = sizeof(Header);
+	h.tempo_segment_size = sizeof(TempoMap::Segment);
+	h.measure_segment_size = sizeof(MeasureMap::Segment);
+	h.format = static_cast<uint32_t>(midi.get_format());
+	h.division_type = midi.division.get_type();
+	if (midi.division.get_type() == Division::SMPTE)
+	{
+		h.division[0] = midi.division.get_frame_rate();
+		h.division[1] = midi.division.get_ticks();
+	}
+	else
+	{
+		h.division[0] = midi.division.get_division();
+	}
+	h.track_count = midi.tracks.size();
+	h.event_count = midi.event_count();
+	h.tempo_count = tempo_map.get_segments().size();
+	h.measure_count = measure_map.get_segments().size();
+	h.ticks_per_quarter_note = measure_map.get_ticks_per_quarter_note();
+
+	// the file as the midi read it, not as it may be now
+	std::span<const byte> source = midi.get_source();
+	if (!source.empty())
+	{
+		h.source_size = source.size();
+		h.source_time = midi.get_source_time();
+		h.source_checksum = hash_bytes(source.data(), source.size());
+	}
+	h.layout();
+
+	// uint64_t keeps every section aligned
+	auto storage = std::make_shared<std::vector<uint64_t>>(h.image_size / sizeof(uint64_t));
+	byte* image = reinterpret_cast<byte*>(storage->data());
+	uint64_t* track_offsets = h.get_section<uint64_t>(image, TRACK_OFFSETS);
+	uint64_t* ticks = h.get_section<uint64_t>(image, TICKS);
+	int64_t* times = h.get_section<int64_t>(image, TIMES);
+	uint16_t* tracks = h.get_section<uint16_t>(image, TRACKS);
+	byte* statuses = h.get_section<byte>(image, STATUSES);
+	byte* types = h.get_section<byte>(image, TYPES);
+	byte* data0 = h.get_section<byte>(image, DATA0);
+	byte* data1 = h.get_section<byte>(image, DATA1);
+	uint32_t* payload_offsets = h.get_section<uint32_t>(image, PAYLOAD_OFFSETS);
+
+	std::vector<byte> payload;
+	size_t i = 0;
+	for (size_t track = 0; track < midi.tracks.size(); ++track)
+	{
+		track_offsets[track] = i;
+		for (const Event::ptr& event: midi.tracks[track].events)
+		{
+			ticks[i] = event->timestamp;
+			times[i] = tempo_map.get_time(event->timestamp).count();
+			tracks[i] = track;
+			statuses[i] = event->get_status();
+			types[i] = event->get_type();
+			payload_offsets[i] = payload.size();
+			decode(*event, data0[i], data1[i], payload);
+			if (payload.size() > 0xffffffff)
+				throw std::length_error("EventTable: payload over 4GB");
+			++i;
+		}
+	}
+	track_offsets[h.track_count] = i;
+	payload_offsets[i] = payload.size();
+	std::memcpy(
+		h.get_section<byte>(image, TEMPO_SEGMENTS),
+		tempo_map.get_segments().data(),
+		h.get_section_size(TEMPO_SEGMENTS)
+	);
+	std::memcpy(
+		h.get_section<byte>(image, MEASURE_SEGMENTS),
+		measure_map.get_segments().data(),
+		h.get_section_size(MEASURE_SEGMENTS)
+	);
+
+	// the payload goes at the end, now that its size is known
+	h.payload_size = payload.size();
+	h.image_size = align(h.sections[PAYLOAD] + h.payload_size);
+	storage->resize(h.image_size / sizeof(uint64_t));
+	image = reinterpret_cast<byte*>(storage->data());
+	std::memcpy(image + h.sections[PAYLOAD], payload.data(), payload.size());
+	std::memcpy(image, &h, sizeof(h));
+
+	attach(storage, image, h.image_size);
+}
+//------------------------------------------------------------------------------
+void			EventTable::load(const std::filesystem::path& cache_path)
+{
+	clear();
+	auto file = std::make_shared<MappedFile>(cache_path);
+	attach(file, file->data(), file->size());
+}
+//------------------------------------------------------------------------------
+void			EventTable::save(const std::filesystem::path& cache_path) const
+{
+	if (!header)
+		throw std::logic_error("EventTable: empty");
+	// renamed into place, tables mapping the old file keep it
+	replace_bin_file(cache_path, {reinterpret_cast<const byte*>(header), header->image_size});
+}
+//------------------------------------------------------------------------------
+void			EventTable::clear()
+{
+	*this = EventTable();
+}
+//------------------------------------------------------------------------------
+EventTable		EventTable::load_cached(
+	const std::filesystem::path&	midi_path,
+	const std::filesystem::path&	cache_path
+)
+{
+	uint64_t size;
+	int64_t time;
+	get_file_stamp(midi_path, size, time);
+
+	EventTable table;
+	if (std::filesystem::exists(cache_path))
+	{
+		try
+		{
+			table.load(cache_path);
+			if (table.header->source_size == size && table.header->source_time == time)
+				return table;
+		}
+		catch (const std::runtime_error&)
+		{
+			// stale or broken, build again
+		}
+	}
+	table.build(Midi(midi_path));
+	// a cache that can not be written is not worth failing the load
+	try
+	{
+		table.save(cache_path);
+	}
+	catch (const std::runtime_error&)
+	{}
+	return table;
+}
+//------------------------------------------------------------------------------
+bool			EventTable::verify(const std::filesystem::path& midi_path) const
+{
+	if (!header)
+		return false;
+	std::vector<byte> source = read_bin_file(midi_path);
+	return
+		source.size() == header->source_size &&
+		hash_bytes(source.data(), source.size()) == header->source_checksum;
+}
+//------------------------------------------------------------------------------
+void			EventTable::decode(
+	const Event&			event,
+	byte&					data0,
+	byte&					data1,
+	std::vector<byte>&		payload
+)
+{
+	data0 = 0;
+	data1 = 0;
+	switch (event.get_category())
+	{
+		case Event::MIDI:
+		{
+			auto& midi_event = static_cast<const MidiEvent&>(event);
+			data0 = midi_event.data[0];
+			if (event.get_type() != Event::PROGRAM_CHANGE
+				&& event.get_type() != Event::CHANNEL_PRESSURE)
+				data1 = midi_event.data[1];
+			break;
+		}
+		case Event::META:
+		{
+			const auto& data = static_cast<const MetaEvent&>(event).get_data();
+			payload.insert(payload.end(), data.begin(), data.end());
+			break;
+		}
+		case Event::SYSEX:
+			switch (event.get_type())
+			{
+				case Event::SYSEX_MESSAGES:
+					static_cast<const SysexMessages&>(event).get_messages(payload);
+					break;
+				case Event::END_OF_SYSEX_MESSAGES:
+				{
+					const auto& messages =
+						static_cast<const EndOfSysexMessages&>(event).get_messages();
+					payload.insert(payload.end(), messages.begin(), messages.end());
+					break;
+				}
+				case Event::MTC_QUARTER_FRAME:
+					data0 = static_cast<const MTCQuarterFrame&>(event).get_value();
+					break;
+				case Event::SONG_POSITION_POINTER:
+				{
+					int position = static_cast<const SongPositionPointer&>(event).get_position();
+					data0 = position & 0x7f;
+					data1 = (position >> 7) & 0x7f;
+					break;
+				}
+				case Event::SONG_REQUEST:
+					data0 = static_cast<const SongRequest&>(event).get_song();
+					break;
+				default:
+					break;
+			}
+			break;
+	}
+}
+//------------------------------------------------------------------------------
+size_t			EventTable::size() const
+{
+	return header ? header->event_count : 0;
+}
+//------------------------------------------------------------------------------
+bool			EventTable::empty() const
+{
+	return size() == 0;
+}
+//------------------------------------------------------------------------------
+int				EventTable::get_track_count() const
+{
+	return header ? header->track_count : 0;
+}
+//------------------------------------------------------------------------------
+size_t			EventTable::get_track_begin(int track) const
+{
+	if (track < 0 || track >= get_track_count())
+		throw std::out_of_range(__func__);
+	return track_offsets[track];
+}
+//------------------------------------------------------------------------------
+size_t			EventTable::get_track_end(int track) const
+{
+	if (track < 0 || track >= get_track_count())
+		throw std::out_of_range(__func__);
+	return track_offsets[track + 1];
+}
+//------------------------------------------------------------------------------
+Midi::Format	EventTable::get_format() const
+{
+	return header ? static_cast<Midi::Format>(header->format) : Midi::Format::MULTIPLE_TRACK;
+}
+//------------------------------------------------------------------------------
+Division		EventTable::get_division() const
+{
+	if (!header)
+		return Division();
+	if (header->division_type == Division::SMPTE)
+		return Division(header->division[0], header->division[1]);
+	return Division(header->division[0]);
+}
+//------------------------------------------------------------------------------
+TempoMap		EventTable::get_tempo_map() const
+{
+	if (!header)
+		return TempoMap();
+	return TempoMap(
+		get_division(),
+		std::vector<TempoMap::Segment>(tempo_segments, tempo_segments + header->tempo_count)
+	);
+}
+//------------------------------------------------------------------------------
+MeasureMap		EventTable::get_measure_map() const
+{
+	if (!header)
+		return MeasureMap();
+	return MeasureMap(
+		header->ticks_per_quarter_note,
+		std::vector<MeasureMap::Segment>(measure_segments, measure_segments + header->measure_count)
+	);
+}
+//------------------------------------------------------------------------------
+uint64_t		EventTable::get_source_size() const
+{
+	return header ? header->source_size : 0;
+}
+//------------------------------------------------------------------------------
+int64_t			EventTable::get_source_time() const
+{
+	return header ? header->source_time : 0;
+}
+//------------------------------------------------------------------------------
+uint64_t		EventTable::get_source_checksum() const
+{
+	return header ? header->source_checksum : 0;
+}
+//------------------------------------------------------------------------------
+std::span<const uint64_t>	EventTable::get_ticks() const
+{
+	return {ticks, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const int64_t>	EventTable::get_times() const
+{
+	return {times, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const uint16_t>	EventTable::get_tracks() const
+{
+	return {tracks, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const byte>		EventTable::get_statuses() const
+{
+	return {statuses, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const byte>		EventTable::get_types() const
+{
+	return {types, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const byte>		EventTable::get_data0() const
+{
+	return {data0, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const byte>		EventTable::get_data1() const
+{
+	return {data1, size()};
+}
+//------------------------------------------------------------------------------
+std::span<const byte>		EventTable::get_payload(size_t event) const
+{
+	if (event >= size())
+		throw std::out_of_range(__func__);
+	uint32_t begin = payload_offsets[event];
+	uint32_t end = payload_offsets[event + 1];
+	// offsets are not checked on load, that would be work per event
+	if (begin > end || end > header->payload_size)
+		throw std::runtime_error("Invalid cache file");
+	return {payload + begin, end - begin};
+}
+//------------------------------------------------------------------------------
+std::span<const uint32_t>	EventTable::get_payload_offsets() const
+{
+	if (!header)
+		return {};
+	return {payload_offsets, size() + 1};
+}
+//------------------------------------------------------------------------------
+std::span<const byte>		EventTable::get_payloads() const
+{
+	if (!header)
+		return {};
+	return {payload, header->payload_size};
+}
+//------------------------------------------------------------------------------
+void			EventTable::attach(
+	std::shared_ptr<const void>		owner,
+	const byte*						image,
+	size_t							size
+)
+{
+	auto* h = reinterpret_cast<const Header*>(image);
+	if (size < sizeof(Header)
+		|| reinterpret_cast<uintptr_t>(image) % alignof(Header)
+		|| std::memcmp(h->magic, image_magic, sizeof(image_magic))
+		|| h->version != image_version
+		|| h->byte_order != image_byte_order
+		|| h->header_size != sizeof(Header)
+		|| h->tempo_segment_size != sizeof(TempoMap::Segment)
+		|| h->measure_segment_size != sizeof(MeasureMap::Segment)
+		|| h->image_size != size
+		|| h->track_count > 0xffff
+		|| h->event_count > size
+		|| h->payload_size > size
+		|| h->tempo_count == 0 || h->tempo_count > size
+		|| h->measure_count == 0 || h->measure_count > size)
+		throw std::runtime_error("Invalid cache file");
+	for (int i = 0; i < SECTION_COUNT; ++i)
+	{
+		if (h->sections[i] % 8
+			|| h->sections[i] > size
+			|| h->get_section_size(i) > size - h->sections[i])
+			throw std::runtime_error("Invalid cache file");
+	}
+
+	auto* offsets = h->get_section<const uint64_t>(image, TRACK_OFFSETS);
+	for (uint32_t i = 0; i < h->track_count; ++i)
+	{
+		if (offsets[i] > offsets[i + 1])
+			throw std::runtime_error("Invalid cache file");
+	}
+	if (offsets[0] != 0 || offsets[h->track_count] != h->event_count
+		|| h->get_section<const uint32_t>(image, PAYLOAD_OFFSETS)[h->event_count] != h->payload_size)
+		throw std::runtime_error("Invalid cache file");
+
+	// segments as TempoMap and MeasureMap build them, from tick 0 in order
+	auto* tempos = h->get_section<const TempoMap::Segment>(image, TEMPO_SEGMENTS);
+	for (uint64_t i = 0; i < h->tempo_count; ++i)
+	{
+		const TempoMap::Segment& segment = tempos[i];
+		if ((i ? segment.tick <= tempos[i - 1].tick || segment.time < tempos[i - 1].time : segment.tick || segment.time)
+			|| segment.quarter_note_duration < 0)
+			throw std::runtime_error("Invalid cache file");
+	}
+	auto* measures = h->get_section<const MeasureMap::Segment>(image, MEASURE_SEGMENTS);
+	for (uint64_t i = 0; i < h->measure_count; ++i)
+	{
+		const MeasureMap::Segment& segment = measures[i];
+		if ((i ? segment.tick <= measures[i - 1].tick || segment.bar < measures[i - 1].bar : segment.tick || segment.bar)
+			|| segment.numerator < 1
+			|| segment.denominator < 0 || segment.denominator > 31
+			|| segment.beat_length == 0
+			|| segment.bar_length != segment.beat_length * segment.numerator)
+			throw std::runtime_error("Invalid cache file");
+	}
+
+	this->owner = std::move(owner);
+	header = h;
+	track_offsets = offsets;
+	ticks = h->get_section<const uint64_t>(image, TICKS);
+	times = h->get_section<const int64_t>(image, TIMES);
+	tracks = h->get_section<const uint16_t>(image, TRACKS);
+	statuses = h->get_section<const byte>(image, STATUSES);
+	types = h->get_section<const byte>(image, TYPES);
+	data0 = h->get_section<const byte>(image, DATA0);
+	data1 = h->get_section<const byte>(image, DATA1);
+	payload_offsets = h->get_section<const uint32_t>(image, PAYLOAD_OFFSETS);
+	payload = h->get_section<const byte>(image, PAYLOAD);
+	tempo_segments = tempos;
+	measure_segments = measures;
+}
+} // MidiParser
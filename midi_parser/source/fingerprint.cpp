@@ -0,0 +1,179 @@
+#include "fingerprint.h"
+#include "util.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace MidiParser {
+namespace {
+// the finalizer of splitmix64, spreads every bit over the word
+uint64_t		mix(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+	return value ^ (value >> 31);
+}
+//------------------------------------------------------------------------------
+uint64_t		hash_value(uint64_t value, uint64_t hash)
+{
+	return hash_bytes(reinterpret_cast<const byte*>(&value), sizeof(value), hash);
+}
+//------------------------------------------------------------------------------
+// ticks in steps of 1 / resolution quarter note, rounded
+int64_t			to_steps(uint64_t tick, uint64_t ticks_per_quarter_note, uint64_t resolution)
+{
+	return tick / ticks_per_quarter_note * resolution
+		+ (tick % ticks_per_quarter_note * resolution + ticks_per_quarter_note / 2) / ticks_per_quarter_note;
+}
+//------------------------------------------------------------------------------
+int64_t			to_steps(Microseconds time, int64_t resolution)
+{
+	return (time.count() * resolution + 500000) / 1000000;
+}
+//------------------------------------------------------------------------------
+struct GridNote
+{
+	int64_t			position; // steps
+	int64_t			duration; // steps
+	int				key; // drums from 128
+};
+} // anonymous
+
+
+
+/*##########################
+
+	Fingerprint
+
+##########################*/
+Fingerprint::Fingerprint(const Midi& midi, Options options):
+	Fingerprint(NotePairer::pair(midi), TempoMap(midi), options)
+{
+}
+//------------------------------------------------------------------------------
+Fingerprint::Fingerprint(std::span<const NoteSpan> spans, const TempoMap& tempo_map, Options options)
+{
+	if (options.resolution <= 0 || options.shingle_size <= 0 || options.hash_count <= 0)
+		throw std::invalid_argument("Fingerprint: resolution, shingle size and hash count must be positive");
+
+	// notes on the grid, by position and key, the longest of doubled ones first
+	const Division& division = tempo_map.get_division();
+	bool by_tick = options.tempo_invariant && division.get_type() == Division::QUARTER_NOTE && division.get_division() > 0;
+	std::vector<GridNote> notes(spans.size());
+	parallel_for((spans.size() + 65535) / 65536, [&](size_t block)
+	{
+		size_t end = std::min(spans.size(), (block + 1) * 65536);
+		for (size_t i = block * 65536; i < end; ++i)
+		{
+			const NoteSpan& span = spans[i];
+			int64_t begin, finish;
+			if (by_tick)
+			{
+				begin = to_steps(span.tick, division.get_division(), options.resolution);
+				finish = to_steps(span.tick + span.duration, division.get_division(), options.resolution);
+			}
+			else
+			{
+				begin = to_steps(tempo_map.get_time(span.tick), options.resolution);
+				finish = to_steps(tempo_map.get_time(span.tick + span.duration), options.resolution);
+			}
+			notes[i] = {begin, finish - begin, span.key + (span.channel == 9 ? 128 : 0)};
+		}
+	});
+	std::sort(notes.begin(), notes.end(), [](const GridNote& a, const GridNote& b)
+	{
+		if (a.position != b.position)
+			return a.position < b.position;
+		if (a.key != b.key)
+			return a.key < b.key;
+		return a.duration > b.duration;
+	});
+	notes.erase(
+		std::unique(notes.begin(), notes.end(), [](const GridNote& a, const GridNote& b)
+		{
+			return a.position == b.position && a.key == b.key;
+		}),
+		notes.end()
+	);
+	note_count = notes.size();
+
+	// tokens of the steps since the previous note and the key or interval,
+	// drums keep their key, and intervals are between the other notes only
+	std::vector<uint64_t> tokens(notes.size());
+	hash = hash_value(notes.size(), 0xcbf29ce484222325);
+	int previous_key = -1;
+	for (size_t i = 0; i < notes.size(); ++i)
+	{
+		int64_t step = i ? notes[i].position - notes[i - 1].position : 0;
+		int pitch = notes[i].key;
+		if (options.transposition_invariant && pitch < 128)
+		{
+			pitch -= previous_key < 0 ? pitch : previous_key;
+			previous_key = notes[i].key;
+		}
+		tokens[i] = static_cast<uint64_t>(step) << 9 | (pitch + 256);
+		hash = hash_value(notes[i].duration, hash_value(tokens[i], hash));
+	}
+
+	// MinHash: for each hash function (a * x + b) >> 32, the least over the shingles
+	std::vector<uint64_t> multipliers(options.hash_count), addends(options.hash_count);
+	uint64_t seed = 0x5eed;
+	for (int i = 0; i < options.hash_count; ++i)
+	{
+		multipliers[i] = mix(seed += 0x9e3779b97f4a7c15) | 1;
+		addends[i] = mix(seed += 0x9e3779b97f4a7c15);
+	}
+	size_t shingle_size = std::min<size_t>(options.shingle_size, tokens.size());
+	size_t shingle_count = tokens.empty() ? 0 : tokens.size() - shingle_size + 1;
+	size_t block_count = (shingle_count + 65535) / 65536;
+	std::vector<uint32_t> minimums(block_count * options.hash_count, UINT32_MAX);
+	parallel_for(block_count, [&](size_t block)
+	{
+		uint32_t* minimum = minimums.data() + block * options.hash_count;
+		size_t end = std::min(shingle_count, (block + 1) * 65536);
+		for (size_t i = block * 65536; i < end; ++i)
+		{
+			uint64_t shingle = 0;
+			for (size_t j = 0; j < shingle_size; ++j)
+				shingle = mix(shingle ^ tokens[i + j]);
+			for (int k = 0; k < options.hash_count; ++k)
+				minimum[k] = std::min(minimum[k], static_cast<uint32_t>((multipliers[k] * shingle + addends[k]) >> 32));
+		}
+	});
+	signature.assign(options.hash_count, UINT32_MAX);
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		for (int k = 0; k < options.hash_count; ++k)
+			signature[k] = std::min(signature[k], minimums[block * options.hash_count + k]);
+	}
+}
+//------------------------------------------------------------------------------
+uint64_t		Fingerprint::get_hash() const
+{
+	return hash;
+}
+//------------------------------------------------------------------------------
+const std::vector<uint32_t>&	Fingerprint::get_signature() const
+{
+	return signature;
+}
+//------------------------------------------------------------------------------
+size_t			Fingerprint::get_note_count() const
+{
+	return note_count;
+}
+//------------------------------------------------------------------------------
+double			Fingerprint::get_similarity(const Fingerprint& other) const
+{
+	return get_similarity(signature, other.signature);
+}
+//------------------------------------------------------------------------------
+double			Fingerprint::get_similarity(std::span<const uint32_t> a, std::span<const uint32_t> b)
+{
+	if (a.size() != b.size() || a.empty())
+		return 0;
+	size_t equal = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+		equal += a[i] == b[i];
+	return static_cast<double>(equal) / a.size();
+}
+} // MidiParser
@@ -0,0 +1,257 @@
+#include "hex_dump.h"
+#include "util.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace MidiParser {
+namespace {
+constexpr char			digits[] = "0123456789abcdef";
+constexpr size_t		bytes_per_line = 16;
+// address, two spaces, 16 bytes of "xx " with one more space in the middle
+constexpr size_t		line_width = 8 + 2 + bytes_per_line * 3 + 1;
+
+struct Tables
+{
+	std::array<std::array<char, 2>, 256>	hex;
+	std::array<char, 256>					ascii;
+
+	Tables()
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			hex[i] = {digits[i >> 4], digits[i & 0xf]};
+			ascii[i] = i >= 0x20 && i < 0x7f ? static_cast<char>(i) : '.';
+		}
+	}
+};
+//------------------------------------------------------------------------------
+const Tables&	get_tables()
+{
+	static const Tables tables;
+	return tables;
+}
+//------------------------------------------------------------------------------
+uint32_t		get_u32(const byte* data)
+{
+	return read4(data, data + 4);
+}
+//------------------------------------------------------------------------------
+// the magic of a chunk, unprintable bytes as '.'
+std::string		get_magic(const byte* data)
+{
+	std::string magic(4, '.');
+	for (int i = 0; i < 4; ++i)
+		magic[i] = get_tables().ascii[data[i]];
+	return magic;
+}
+} // anonymous
+
+
+
+/*##########################
+
+	HexDump
+
+##########################*/
+void				HexDump::append(const byte* data, size_t size, uint64_t address)
+{
+	const Tables& tables = get_tables();
+	for (size_t i = 0; i < size; i += bytes_per_line)
+	{
+		size_t count = std::min(size - i, bytes_per_line);
+		append_line(data + i, count, address + i);
+		buffer += '|';
+		for (size_t j = 0; j < count; ++j)
+			buffer += tables.ascii[data[i + j]];
+		buffer += "|\n";
+	}
+}
+//------------------------------------------------------------------------------
+void				HexDump::append(const Track& track, int track_number, uint64_t address)
+{
+	std::span<const byte> source = track.get_source();
+	if (source.size() < 8)
+		throw std::logic_error("HexDump: track was not read from a file");
+
+	append_bytes(source.data(), 8, address,
+		"MTrk track " + std::to_string(track_number)
+		+ ", " + std::to_string(source.size() - 8) + " bytes"
+	);
+
+	std::span<const uint32_t> offsets = track.get_event_offsets();
+	if (offsets.empty())
+	{
+		append_bytes(source.data() + 8, source.size() - 8, address + 8, track.is_dirty()
+			? "changed since read, events not shown"
+			: "events not shown, open with keep_offsets"
+		);
+		return;
+	}
+
+	for (size_t i = 0; i < track.events.size(); ++i)
+	{
+		text.clear();
+		text.append(*track.events[i]);
+		append_bytes(source.data() + offsets[i], offsets[i + 1] - offsets[i], address + offsets[i], text.get());
+	}
+	if (offsets.back() < source.size())
+	{
+		append_bytes(source.data() + offsets.back(), source.size() - offsets.back(),
+			address + offsets.back(), "after EndOfTrack"
+		);
+	}
+}
+//------------------------------------------------------------------------------
+void				HexDump::append_header(const Midi& midi)
+{
+	std::span<const byte> source = midi.get_source();
+	if (source.size() < 14)
+		throw std::logic_error("HexDump: Midi was not read from a file");
+
+	// as it is in the file, which the Midi may have changed since
+	const byte* data = source.data();
+	std::string note = "MThd format " + std::to_string(data[8] << 8 | data[9])
+		+ ", " + std::to_string(data[10] << 8 | data[11]) + " tracks, division ";
+	if (data[12] & 0x80)
+		note += "smpte " + std::to_string(256 - data[12]) + " fps, " + std::to_string(data[13]) + " ticks";
+	else
+		note += std::to_string(data[12] << 8 | data[13]);
+
+	size_t size = std::min<uint64_t>(8 + get_u32(data + 4), source.size());
+	append_bytes(data, size, 0, note);
+}
+//------------------------------------------------------------------------------
+const std::string&	HexDump::get() const
+{
+	return buffer;
+}
+//------------------------------------------------------------------------------
+void				HexDump::clear()
+{
+	buffer.clear();
+}
+//------------------------------------------------------------------------------
+std::string			HexDump::str(const Midi& midi)
+{
+	std::vector<std::string> buffers = dump(midi);
+	size_t size = 0;
+	for (const std::string& buffer: buffers)
+		size += buffer.size();
+	std::string result;
+	result.reserve(size);
+	for (const std::string& buffer: buffers)
+		result += buffer;
+	return result;
+}
+//------------------------------------------------------------------------------
+void				HexDump::save(const Midi& midi, const std::filesystem::path& file_path)
+{
+	write_file(file_path, dump(midi));
+}
+//------------------------------------------------------------------------------
+void				HexDump::append_line(const byte* data, size_t size, uint64_t address)
+{
+	const Tables& tables = get_tables();
+	size_t start = buffer.size();
+	buffer.resize(start + line_width, ' ');
+	char* output = buffer.data() + start;
+	for (int i = 7; i >= 0; --i, address >>= 4)
+		output[i] = digits[address & 0xf];
+
+	char* hex = output + 10;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hex[0] = tables.hex[data[i]][0];
+		hex[1] = tables.hex[data[i]][1];
+		hex += i == 7 ? 4 : 3;
+	}
+}
+//------------------------------------------------------------------------------
+void				HexDump::append_bytes(
+	const byte*				data,
+	size_t					size,
+	uint64_t				address,
+	std::string_view		note
+)
+{
+	for (size_t i = 0; i < size || i == 0; i += bytes_per_line)
+	{
+		append_line(data + i, std::min(size - i, bytes_per_line), address + i);
+		if (i == 0)
+		{
+			buffer += "| ";
+			buffer += note;
+		}
+		else
+		{
+			while (buffer.back() == ' ')
+				buffer.pop_back();
+		}
+		buffer += '\n';
+	}
+}
+//------------------------------------------------------------------------------
+std::vector<std::string>	HexDump::dump(const Midi& midi)
+{
+	std::span<const byte> source = midi.get_source();
+	HexDump header;
+	header.append_header(midi);
+
+	// the chunks as they follow in the file, a track where one was read
+	struct Chunk
+	{
+		size_t			begin;
+		size_t			end;
+		int				track; // -1 for other bytes
+	};
+	std::vector<Chunk> chunks;
+	size_t position = std::min<uint64_t>(8 + get_u32(source.data() + 4), source.size());
+	size_t track = 0;
+	while (position < source.size())
+	{
+		if (source.size() - position < 8)
+		{
+			chunks.push_back({position, source.size(), -1});
+			break;
+		}
+		size_t end = std::min<uint64_t>(position + 8 + get_u32(source.data() + position + 4), source.size());
+		int number = -1;
+		if (track < midi.tracks.size() && midi.tracks[track].get_source().data() == source.data() + position)
+			number = track++;
+		chunks.push_back({position, end, number});
+		position = end;
+	}
+
+	std::vector<std::string> buffers(chunks.size() + 1);
+	buffers[0] = std::move(header.buffer);
+	parallel_for(chunks.size(), [&](size_t i)
+	{
+		const Chunk& chunk = chunks[i];
+		size_t size = chunk.end - chunk.begin;
+		const byte* data = source.data() + chunk.begin;
+
+		// a line takes about 100 characters
+		HexDump dump;
+		if (chunk.track >= 0)
+		{
+			const Track& track = midi.tracks[chunk.track];
+			dump.buffer.reserve((size / bytes_per_line + track.events.size()) * 100 + 128);
+			dump.append(track, chunk.track, chunk.begin);
+		}
+		else if (size < 8)
+		{
+			dump.append_bytes(data, size, chunk.begin, "trailing bytes");
+		}
+		else
+		{
+			dump.buffer.reserve((size / bytes_per_line + 1) * 80);
+			dump.append_bytes(data, size, chunk.begin,
+				get_magic(data) + " chunk, " + std::to_string(size - 8) + " bytes, not a track"
+			);
+		}
+		buffers[i + 1] = std::move(dump.buffer);
+	});
+	return buffers;
+}
+} // MidiParser
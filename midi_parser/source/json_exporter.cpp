@@ -0,0 +1,374 @@
+#include "json_exporter.h"
+#include "tempo_map.h"
+#include "util.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+
+namespace MidiParser {
+
+
+
+/*##########################
+
+	JsonExporter
+
+##########################*/
+template <typename ForEachRow>
+void			JsonExporter::write_rows(
+	const EventTable&	table,
+	std::string_view	file_name,
+	const ForEachRow&	for_each_row
+)
+{
+	begin_song(file_name, table.get_format(), table.get_track_count(), table.get_division());
+	auto ticks = table.get_ticks();
+	auto times = table.get_times();
+	auto tracks = table.get_tracks();
+	auto statuses = table.get_statuses();
+	auto types = table.get_types();
+	auto data0 = table.get_data0();
+	auto data1 = table.get_data1();
+	for_each_row([&](size_t i)
+	{
+		auto payload = table.get_payload(i);
+		write_item({
+			ticks[i], times[i], tracks[i], statuses[i], types[i], data0[i], data1[i],
+			payload.data(), payload.size()
+		});
+	});
+	end_song();
+}
+//------------------------------------------------------------------------------
+JsonExporter::JsonExporter(std::ostream& output, Format format, size_t buffer_size):
+	output(output), format(format), buffer_size(buffer_size)
+{
+	// an event is far below 1KB, unless it carries a long payload
+	buffer.reserve(buffer_size + 1024);
+}
+//------------------------------------------------------------------------------
+JsonExporter::~JsonExporter()
+{
+	try
+	{
+		finish();
+	}
+	catch (...)
+	{
+		// nowhere to report it, call finish() to know
+	}
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::write(const Midi& midi, std::string_view file_name)
+{
+	begin_song(file_name, midi.get_format(), midi.get_track_count(), midi.division);
+	TempoMap tempo_map(midi);
+	for (size_t track = 0; track < midi.tracks.size(); ++track)
+	{
+		for (const Event::ptr& event: midi.tracks[track].events)
+		{
+			Item item;
+			item.tick = event->timestamp;
+			item.time = tempo_map.get_time(event->timestamp).count();
+			item.track = track;
+			item.status = event->get_status();
+			item.type = event->get_type();
+			scratch.clear();
+			EventTable::decode(*event, item.data0, item.data1, scratch);
+			item.payload = scratch.data();
+			item.payload_size = scratch.size();
+			write_item(item);
+		}
+	}
+	end_song();
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::write(const EventTable& table, std::string_view file_name)
+{
+	write_rows(table, file_name, [&](const auto& function)
+	{
+		for (size_t i = 0; i < table.size(); ++i)
+			function(i);
+	});
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::write(
+	const EventTable&	table,
+	const Selection&	selection,
+	std::string_view	file_name
+)
+{
+	if (selection.size() != table.size())
+		throw std::logic_error("JsonExporter: selection of another table");
+	write_rows(table, file_name, [&](const auto& function)
+	{
+		selection.for_each(function);
+	});
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::write_error(std::string_view file_name, std::string_view message)
+{
+	if (finished)
+		throw std::logic_error("JsonExporter: finished");
+	begin_object();
+	buffer += format == Format::NDJSON ? "{\"type\":\"error\",\"file\":" : "{\"file\":";
+	append_string(file_name);
+	buffer += ",\"error\":";
+	append_string(message);
+	buffer += format == Format::NDJSON ? "}\n" : "}";
+	++song_count;
+	flush_if_full();
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::finish()
+{
+	if (finished)
+		return;
+	finished = true;
+	if (format == Format::JSON)
+		buffer += song_count ? "\n]\n" : "[]\n";
+	flush();
+	output.flush();
+	if (!output)
+		throw std::runtime_error("write failed");
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::export_directory(
+	const std::filesystem::path&	input_directory,
+	const std::filesystem::path&	output_directory,
+	int								shard_count,
+	Format							format
+)
+{
+	std::vector<std::filesystem::path> files = find_midi_files(input_directory);
+
+	if (shard_count <= 0)
+		shard_count = std::max(std::thread::hardware_concurrency(), 1u);
+	std::filesystem::create_directories(output_directory);
+
+	parallel_for(shard_count, [&](size_t shard)
+	{
+		std::string name = std::to_string(shard);
+		name = "shard-" + std::string(name.size() < 4 ? 4 - name.size() : 0, '0') + name
+			+ (format == Format::NDJSON ? ".ndjson" : ".json");
+		std::ofstream ofs(output_directory / name, std::ios::binary);
+		if (!ofs.is_open())
+			throw std::runtime_error("create failed");
+
+		JsonExporter exporter(ofs, format);
+		for (size_t i = shard; i < files.size(); i += shard_count)
+		{
+			std::string file_name = files[i].lexically_relative(input_directory).generic_string();
+			Midi midi;
+			try
+			{
+				midi.open(files[i]);
+			}
+			catch (const std::exception& e)
+			{
+				exporter.write_error(file_name, e.what());
+				continue;
+			}
+			exporter.write(midi, file_name);
+		}
+		exporter.finish();
+	});
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::begin_song(
+	std::string_view	file_name,
+	Midi::Format		midi_format,
+	int					track_count,
+	const Division&		division
+)
+{
+	if (finished)
+		throw std::logic_error("JsonExporter: finished");
+	begin_object();
+	buffer += format == Format::NDJSON ? "{\"type\":\"song\",\"file\":" : "{\"file\":";
+	append_string(file_name);
+	buffer += ",\"format\":";
+	append_number(static_cast<int>(midi_format));
+	buffer += ",\"tracks\":";
+	append_number(track_count);
+	buffer += ",\"division\":";
+	if (division.get_type() == Division::SMPTE)
+	{
+		buffer += "{\"fps\":";
+		append_number(division.get_frame_rate());
+		buffer += ",\"ticks\":";
+		append_number(division.get_ticks());
+		buffer += '}';
+	}
+	else
+	{
+		append_number(division.get_division());
+	}
+	buffer += format == Format::NDJSON ? "}\n" : ",\"events\":[";
+	first_event = true;
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::end_song()
+{
+	if (format == Format::JSON)
+		buffer += first_event ? "]}" : "\n]}";
+	++song_count;
+	flush_if_full();
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::begin_object()
+{
+	if (format == Format::JSON)
+		buffer += song_count ? ",\n" : "[\n";
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::write_item(const Item& item)
+{
+	if (format == Format::JSON)
+		buffer += first_event ? "\n" : ",\n";
+	first_event = false;
+
+	buffer += "{\"track\":";
+	append_number(item.track);
+	buffer += ",\"tick\":";
+	append_number(item.tick);
+	buffer += ",\"us\":";
+	append_number(item.time);
+	buffer += ",\"type\":\"";
+	buffer += Event::get_type_name(static_cast<Event::Type>(item.type));
+	buffer += '"';
+
+	if (Event::get_category(item.status) == Event::MIDI)
+	{
+		buffer += ",\"channel\":";
+		append_number(item.status & 0xf);
+		buffer += ",\"data\":[";
+		append_number(item.data0);
+		if (item.type != Event::PROGRAM_CHANGE && item.type != Event::CHANNEL_PRESSURE)
+		{
+			buffer += ',';
+			append_number(item.data1);
+		}
+		buffer += ']';
+	}
+	else if (item.type == Event::MTC_QUARTER_FRAME || item.type == Event::SONG_REQUEST)
+	{
+		buffer += ",\"data\":[";
+		append_number(item.data0);
+		buffer += ']';
+	}
+	else if (item.type == Event::SONG_POSITION_POINTER)
+	{
+		buffer += ",\"data\":[";
+		append_number(item.data0);
+		buffer += ',';
+		append_number(item.data1);
+		buffer += ']';
+	}
+	else if (item.status == 0xff && item.type >= Event::USER_TEXT && item.type <= Event::CUE_POINT)
+	{
+		buffer += ",\"text\":";
+		append_string(item.payload, item.payload_size);
+	}
+	else if (item.payload_size)
+	{
+		buffer += ",\"payload\":\"";
+		append_hex(item.payload, item.payload_size);
+		buffer += '"';
+	}
+
+	buffer += format == Format::NDJSON ? "}\n" : "}";
+	flush_if_full();
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::append_number(int64_t value)
+{
+	char number[24];
+	auto result = std::to_chars(number, number + sizeof(number), value);
+	buffer.append(number, result.ptr);
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::append_string(const byte* data, size_t size)
+{
+	// bytes from 0x80 are written as \u0080.. so that text in any encoding
+	// comes back byte for byte as latin-1
+	static constexpr char digits[] = "0123456789abcdef";
+	buffer += '"';
+	const byte* run = data;
+	const byte* end = data + size;
+	for (const byte* it = data; it != end; ++it)
+	{
+		byte c = *it;
+		if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\')
+			continue;
+		buffer.append(reinterpret_cast<const char*>(run), it - run);
+		run = it + 1;
+		switch (c)
+		{
+			case '"':	buffer += "\\\""; break;
+			case '\\':	buffer += "\\\\"; break;
+			case '\n':	buffer += "\\n"; break;
+			case '\r':	buffer += "\\r"; break;
+			case '\t':	buffer += "\\t"; break;
+			default:
+				buffer += "\\u00";
+				buffer += digits[c >> 4];
+				buffer += digits[c & 0xf];
+				break;
+		}
+	}
+	buffer.append(reinterpret_cast<const char*>(run), end - run);
+	buffer += '"';
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::append_string(std::string_view str)
+{
+	// names and messages, utf-8 already: only quotes and controls are escaped
+	static constexpr char digits[] = "0123456789abcdef";
+	buffer += '"';
+	for (unsigned char c: str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			buffer += '\\';
+			buffer += c;
+		}
+		else if (c < 0x20)
+		{
+			buffer += "\\u00";
+			buffer += digits[c >> 4];
+			buffer += digits[c & 0xf];
+		}
+		else
+		{
+			buffer += c;
+		}
+	}
+	buffer += '"';
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::append_hex(const byte* data, size_t size)
+{
+	static constexpr char digits[] = "0123456789abcdef";
+	for (size_t i = 0; i < size; ++i)
+	{
+		buffer += digits[data[i] >> 4];
+		buffer += digits[data[i] & 0xf];
+	}
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::flush_if_full()
+{
+	if (buffer.size() >= buffer_size)
+		flush();
+}
+//------------------------------------------------------------------------------
+void			JsonExporter::flush()
+{
+	output.write(buffer.data(), buffer.size());
+	if (!output)
+		throw std::runtime_error("write failed");
+	buffer.clear();
+}
+} // MidiParser
@@ -0,0 +1,90 @@
+#include "mapped_file.h"
+#include "util.h"
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MidiParser {
+/*##########################
+
+	MappedFile
+
+##########################*/
+MappedFile::MappedFile(const std::filesystem::path& file_path)
+{
+	open(file_path);
+}
+//------------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	close();
+}
+//------------------------------------------------------------------------------
+void			MappedFile::open(const std::filesystem::path& file_path)
+{
+	close();
+#ifdef _WIN32
+	buffer = read_bin_file(file_path);
+	address = buffer.data();
+	length = buffer.size();
+#else
+	int fd = ::open(file_path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Error: open file");
+	struct stat status;
+	if (::fstat(fd, &status) < 0)
+	{
+		::close(fd);
+		throw std::runtime_error("Error: open file");
+	}
+	length = status.st_size;
+	if (length)
+	{
+		void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			::close(fd);
+			length = 0;
+			throw std::runtime_error("Error: map file");
+		}
+		address = static_cast<const byte*>(mapped);
+	}
+	// the mapping stays valid without the descriptor
+	::close(fd);
+#endif
+	opened = true;
+}
+//------------------------------------------------------------------------------
+void			MappedFile::close()
+{
+#ifdef _WIN32
+	buffer.clear();
+	buffer.shrink_to_fit();
+#else
+	if (address)
+		::munmap(const_cast<byte*>(address), length);
+#endif
+	address = nullptr;
+	length = 0;
+	opened = false;
+}
+//------------------------------------------------------------------------------
+bool			MappedFile::is_open() const
+{
+	return opened;
+}
+//------------------------------------------------------------------------------
+const byte*		MappedFile::data() const
+{
+	return address;
+}
+//------------------------------------------------------------------------------
+size_t			MappedFile::size() const
+{
+	return length;
+}
+} // MidiParser
@@ -0,0 +1,208 @@
+#include "measure_map.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	MeasureMap
+
+##########################*/
+MeasureMap::MeasureMap(const Midi& midi)
+{
+	build(midi);
+}
+//------------------------------------------------------------------------------
+MeasureMap::MeasureMap(uint64_t ticks_per_quarter_note, std::vector<Segment> segments):
+	segments(std::move(segments)), ticks_per_quarter_note(ticks_per_quarter_note)
+{
+	if (this->segments.empty() || this->segments[0].tick != 0)
+		throw std::invalid_argument("MeasureMap: no segment at tick 0");
+}
+//------------------------------------------------------------------------------
+void			MeasureMap::build(const Midi& midi)
+{
+	// SMPTE division has no quarter note, so the default tempo(120 bpm) is assumed.
+	if (midi.division.get_type() == Division::SMPTE)
+		ticks_per_quarter_note =
+			midi.division.get_frame_rate() * midi.division.get_ticks() / 2;
+	else
+		ticks_per_quarter_note = midi.division.get_division();
+
+	struct Change
+	{
+		uint64_t	tick;
+		int			numerator;
+		int			denominator;
+	};
+	std::vector<Change> changes;
+	for (const Track& track: midi.tracks)
+	{
+		for (const Event::ptr& event: track.events)
+		{
+			if (event->get_type() != Event::TIME_SIGNATURE)
+				continue;
+			auto* time_signature = static_cast<const TimeSignature*>(event.get());
+			changes.push_back({
+				event->timestamp,
+				time_signature->get_numerator(),
+				time_signature->get_denominator()
+			});
+		}
+	}
+	std::stable_sort(changes.begin(), changes.end(),
+		[](const Change& a, const Change& b){ return a.tick < b.tick; }
+	);
+
+	segments.clear();
+	segments.push_back(make_segment(0, 0, 4, 2));
+	for (const Change& change: changes)
+	{
+		const Segment& last = segments.back();
+		if (change.tick == last.tick)
+		{
+			segments.back() = make_segment(
+				last.tick, last.bar, change.numerator, change.denominator
+			);
+			continue;
+		}
+		uint64_t ticks = change.tick - last.tick;
+		int64_t bar = last.bar + ticks / last.bar_length;
+		if (ticks % last.bar_length)
+			++bar;
+		segments.push_back(
+			make_segment(change.tick, bar, change.numerator, change.denominator)
+		);
+	}
+}
+//------------------------------------------------------------------------------
+MeasureMap::Position	MeasureMap::get_position(uint64_t tick) const
+{
+	const Segment& segment = get_segment(tick);
+	uint64_t ticks = tick - segment.tick;
+	uint64_t rest = ticks % segment.bar_length;
+
+	Position position;
+	position.bar = segment.bar + ticks / segment.bar_length;
+	position.beat = rest / segment.beat_length;
+	position.tick = rest % segment.beat_length;
+	return position;
+}
+//------------------------------------------------------------------------------
+int64_t			MeasureMap::get_bar(uint64_t tick) const
+{
+	const Segment& segment = get_segment(tick);
+	return segment.bar + (tick - segment.tick) / segment.bar_length;
+}
+//------------------------------------------------------------------------------
+uint64_t		MeasureMap::get_tick(int64_t bar, int beat, uint64_t tick) const
+{
+	// nothing is before tick 0
+	bar = std::max<int64_t>(bar, 0);
+	beat = std::max(beat, 0);
+	const Segment& segment = get_bar_segment(bar);
+	return
+		segment.tick +
+		static_cast<uint64_t>(bar - segment.bar) * segment.bar_length +
+		static_cast<uint64_t>(beat) * segment.beat_length +
+		tick;
+}
+//------------------------------------------------------------------------------
+uint64_t		MeasureMap::get_tick(const Position& position) const
+{
+	return get_tick(position.bar, position.beat, position.tick);
+}
+//------------------------------------------------------------------------------
+Microseconds	MeasureMap::get_time(
+	const TempoMap&	tempo_map,
+	int64_t			bar,
+	int				beat
+) const
+{
+	return tempo_map.get_time(get_tick(bar, beat));
+}
+//------------------------------------------------------------------------------
+const MeasureMap::Segment&	MeasureMap::get_segment(uint64_t tick) const
+{
+	if (segments.empty())
+		throw std::logic_error("MeasureMap is not built");
+	auto it = std::upper_bound(segments.begin(), segments.end(), tick,
+		[](uint64_t tick, const Segment& segment){ return tick < segment.tick; }
+	);
+	return *(--it);
+}
+//------------------------------------------------------------------------------
+const MeasureMap::Segment&	MeasureMap::get_bar_segment(int64_t bar) const
+{
+	if (segments.empty())
+		throw std::logic_error("MeasureMap is not built");
+	auto it = std::upper_bound(segments.begin(), segments.end(), bar,
+		[](int64_t bar, const Segment& segment){ return bar < segment.bar; }
+	);
+	if (it == segments.begin())
+		return *it;
+	return *(--it);
+}
+//------------------------------------------------------------------------------
+const std::vector<MeasureMap::Segment>&	MeasureMap::get_segments() const
+{
+	return segments;
+}
+//------------------------------------------------------------------------------
+uint64_t		MeasureMap::get_ticks_per_quarter_note() const
+{
+	return ticks_per_quarter_note;
+}
+//------------------------------------------------------------------------------
+void			MeasureMap::get_bars(
+	const std::vector<Event::ptr>&	events,
+	std::vector<int64_t>&			bars
+) const
+{
+	if (segments.empty())
+		throw std::logic_error("MeasureMap is not built");
+	bars.resize(events.size());
+
+	// Walk segments along with events, fall back to binary search on rewind.
+	size_t index = 0;
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		uint64_t tick = events[i]->timestamp;
+		if (tick < segments[index].tick)
+		{
+			const Segment& segment = get_segment(tick);
+			index = &segment - segments.data();
+		}
+		while (index + 1 < segments.size() && segments[index + 1].tick <= tick)
+			++index;
+		const Segment& segment = segments[index];
+		bars[i] = segment.bar + (tick - segment.tick) / segment.bar_length;
+	}
+}
+//------------------------------------------------------------------------------
+std::vector<int64_t>	MeasureMap::get_bars(const std::vector<Event::ptr>& events) const
+{
+	std::vector<int64_t> bars;
+	get_bars(events, bars);
+	return bars;
+}
+//------------------------------------------------------------------------------
+MeasureMap::Segment	MeasureMap::make_segment(
+	uint64_t	tick,
+	int64_t		bar,
+	int			numerator,
+	int			denominator
+) const
+{
+	Segment segment;
+	segment.tick = tick;
+	segment.bar = bar;
+	segment.numerator = std::max(numerator, 1);
+	segment.denominator = std::clamp(denominator, 0, 31);
+	segment.beat_length = std::max<uint64_t>(
+		(ticks_per_quarter_note * 4) >> segment.denominator, 1
+	);
+	segment.bar_length = segment.beat_length * segment.numerator;
+	return segment;
+}
+} // MidiParser
@@ -0,0 +1,605 @@
+#include "melody_index.h"
+#include "mapped_file.h"
+#include "util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace MidiParser {
+/*##########################
+
+	Image
+
+##########################*/
+namespace {
+enum Section
+{
+	FILES,
+	MELODIES,
+	STEPS,
+	KEYS,
+	DATA,
+	PATHS,
+	SECTION_COUNT
+};
+
+constexpr char		image_magic[4] = {'M', 'P', 'M', 'I'};
+constexpr uint32_t	image_version = 1;
+constexpr uint32_t	image_byte_order = 0x01020304;
+
+constexpr int8_t	no_ratio = INT8_MIN; // the first step of a line
+constexpr int		max_ratio = 12; // 2^6 either way
+constexpr uint64_t	pitch_seed = 0xcbf29ce484222325;
+constexpr uint64_t	rhythm_seed = 0x84222325cbf29ce4;
+
+// costs of the alignment, doubled to stay whole
+constexpr uint32_t	step_cost = 2;
+constexpr uint32_t	ratio_cost = 1;
+
+constexpr uint64_t	align_offset(uint64_t offset)
+{
+	return (offset + 7) & ~uint64_t(7);
+}
+//------------------------------------------------------------------------------
+void				write_varint(std::vector<byte>& output, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		output.push_back(static_cast<byte>(value | 0x80));
+		value >>= 7;
+	}
+	output.push_back(static_cast<byte>(value));
+}
+//------------------------------------------------------------------------------
+uint64_t			hash_step(int8_t value, uint64_t hash)
+{
+	return hash_bytes(reinterpret_cast<const byte*>(&value), 1, hash);
+}
+} // anonymous
+
+struct MelodyIndex::Step
+{
+	int8_t			interval; // semitones
+	int8_t			ratio; // round(2 * log2(time to the next note / time from the previous))
+};
+
+struct MelodyIndex::FileEntry
+{
+	uint64_t		path_offset;
+	uint32_t		path_size;
+	uint32_t		first_melody; // and the next entry's is the end
+};
+
+struct MelodyIndex::MelodyEntry
+{
+	uint64_t		step_offset;
+	uint32_t		step_count;
+	uint32_t		file;
+	uint32_t		track;
+	uint32_t		reserved;
+};
+
+struct MelodyIndex::Key
+{
+	uint64_t		gram;
+	uint64_t		offset; // in data
+	uint64_t		size;
+	uint32_t		count; // melodies
+	uint32_t		reserved;
+};
+
+struct MelodyIndex::Header
+{
+	char			magic[4];
+	uint32_t		version;
+	uint32_t		byte_order;
+	uint32_t		header_size;
+	uint32_t		key_size;
+	uint32_t		gram_size;
+	uint64_t		file_count;
+	uint64_t		melody_count;
+	uint64_t		step_count;
+	uint64_t		key_count;
+	uint64_t		data_size;
+	uint64_t		path_size;
+	uint64_t		image_size;
+	uint64_t		sections[SECTION_COUNT]; // offsets from the start of the image
+
+	uint64_t		get_section_size(int section) const
+	{
+		switch (section)
+		{
+			case FILES:				return (file_count + 1) * sizeof(FileEntry);
+			case MELODIES:			return melody_count * sizeof(MelodyEntry);
+			case STEPS:				return step_count * sizeof(Step);
+			case KEYS:				return key_count * sizeof(Key);
+			case DATA:				return data_size;
+			default:				return path_size;
+		}
+	}
+
+	void			layout()
+	{
+		uint64_t offset = align_offset(sizeof(Header));
+		for (int i = 0; i < SECTION_COUNT; ++i)
+		{
+			sections[i] = offset;
+			offset = align_offset(offset + get_section_size(i));
+		}
+		image_size = offset;
+	}
+
+	template <typename T>
+	T*				get_section(const byte* image, int section) const
+	{
+		return reinterpret_cast<T*>(const_cast<byte*>(image) + sections[section]);
+	}
+};
+
+
+
+
+/*##########################
+
+	MelodyIndex::Builder
+
+##########################*/
+class MelodyIndex::Builder
+{
+public:
+	struct Melody
+	{
+		uint32_t		track;
+		std::vector<Step>	steps;
+		std::vector<uint64_t>	grams;
+	};
+
+	void			add(const std::string& path, const std::vector<Melody>& file_melodies)
+	{
+		if (files.size() >= UINT32_MAX || melodies.size() + file_melodies.size() > UINT32_MAX)
+			throw std::length_error("MelodyIndex: too many melodies");
+		uint32_t file = files.size();
+		files.push_back({paths.size(), static_cast<uint32_t>(path.size()), static_cast<uint32_t>(melodies.size())});
+		paths += path;
+		for (const Melody& melody: file_melodies)
+		{
+			uint32_t id = melodies.size();
+			melodies.push_back({steps.size(), static_cast<uint32_t>(melody.steps.size()), file, melody.track, 0});
+			steps.insert(steps.end(), melody.steps.begin(), melody.steps.end());
+			// ids only grow, so each list is in order as it is written
+			for (uint64_t gram: melody.grams)
+			{
+				List& list = lists[gram];
+				write_varint(list.data, id - list.last);
+				list.last = id;
+				++list.count;
+			}
+		}
+	}
+
+	void			finish(int gram_size, MelodyIndex& index)
+	{
+		std::vector<Key> keys;
+		keys.reserve(lists.size());
+		uint64_t data_size = 0;
+		for (const auto& [gram, list]: lists)
+		{
+			keys.push_back({gram, 0, list.data.size(), list.count, 0});
+			data_size += list.data.size();
+		}
+		std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b){ return a.gram < b.gram; });
+		files.push_back({paths.size(), 0, static_cast<uint32_t>(melodies.size())});
+
+		Header h = {};
+		std::memcpy(h.magic, image_magic, sizeof(image_magic));
+		h.version = image_version;
+		h.byte_order = image_byte_order;
+		h.header_size = sizeof(Header);
+		h.key_size = sizeof(Key);
+		h.gram_size = gram_size;
+		h.file_count = files.size() - 1;
+		h.melody_count = melodies.size();
+		h.step_count = steps.size();
+		h.key_count = keys.size();
+		h.data_size = data_size;
+		h.path_size = paths.size();
+		h.layout();
+		auto storage = std::make_shared<std::vector<uint64_t>>(h.image_size / sizeof(uint64_t));
+		byte* image = reinterpret_cast<byte*>(storage->data());
+		std::memcpy(image, &h, sizeof(h));
+		std::memcpy(h.get_section<byte>(image, FILES), files.data(), h.get_section_size(FILES));
+		std::memcpy(h.get_section<byte>(image, MELODIES), melodies.data(), h.get_section_size(MELODIES));
+		std::memcpy(h.get_section<byte>(image, STEPS), steps.data(), h.get_section_size(STEPS));
+		std::memcpy(h.get_section<byte>(image, PATHS), paths.data(), paths.size());
+		byte* data = h.get_section<byte>(image, DATA);
+		uint64_t offset = 0;
+		for (Key& key: keys)
+		{
+			// moved out as it goes, so the lists are not held twice
+			auto found = lists.find(key.gram);
+			std::memcpy(data + offset, found->second.data.data(), key.size);
+			lists.erase(found);
+			key.offset = offset;
+			offset += key.size;
+		}
+		std::memcpy(h.get_section<byte>(image, KEYS), keys.data(), h.get_section_size(KEYS));
+		index.attach(storage, image, h.image_size);
+	}
+
+
+private:
+	struct List
+	{
+		std::vector<byte>	data;
+		uint32_t		last = 0;
+		uint32_t		count = 0;
+	};
+
+	std::vector<FileEntry>	files;
+	std::vector<MelodyEntry>	melodies;
+	std::vector<Step>		steps;
+	std::string				paths;
+	std::unordered_map<uint64_t, List>	lists; // by gram
+};
+
+
+
+
+/*##########################
+
+	MelodyIndex
+
+##########################*/
+MelodyIndex::MelodyIndex(const std::filesystem::path& index_path)
+{
+	load(index_path);
+}
+//------------------------------------------------------------------------------
+void			MelodyIndex::build(const std::vector<std::filesystem::path>& files, Options options)
+{
+	if (options.gram_size <= 0 || options.gram_size > 64 || options.batch_size == 0)
+		throw std::invalid_argument("MelodyIndex: gram size out of [1, 64] or no batch size");
+	clear();
+
+	Builder builder;
+	std::vector<std::vector<Builder::Melody>> batch;
+	for (size_t first = 0; first < files.size(); first += options.batch_size)
+	{
+		size_t count = std::min(options.batch_size, files.size() - first);
+		batch.assign(count, {});
+		parallel_for(count, [&](size_t i)
+		{
+			try
+			{
+				// runs serially on this worker, parallel_for does not nest
+				auto tracks = NotePairer::pair_tracks(Midi(files[first + i]));
+				for (size_t track = 0; track < tracks.size(); ++track)
+				{
+					std::vector<Step> steps = get_steps(get_line(tracks[track]));
+					if (steps.size() < static_cast<size_t>(options.gram_size))
+						continue;
+					std::vector<uint64_t> grams = get_grams(steps, options.gram_size, true, true);
+					batch[i].push_back({static_cast<uint32_t>(track), std::move(steps), std::move(grams)});
+				}
+			}
+			catch (const std::exception&)
+			{
+				batch[i].clear();
+			}
+		});
+		for (size_t i = 0; i < count; ++i)
+			builder.add(files[first + i].generic_string(), batch[i]);
+	}
+	builder.finish(options.gram_size, *this);
+}
+//------------------------------------------------------------------------------
+void			MelodyIndex::load(const std::filesystem::path& index_path)
+{
+	clear();
+	auto file = std::make_shared<MappedFile>(index_path);
+	attach(file, file->data(), file->size());
+}
+//------------------------------------------------------------------------------
+void			MelodyIndex::save(const std::filesystem::path& index_path) const
+{
+	if (!header)
+		throw std::logic_error("MelodyIndex: empty");
+	// renamed into place, tables mapping the old file keep it
+	replace_bin_file(index_path, {reinterpret_cast<const byte*>(header), header->image_size});
+}
+//------------------------------------------------------------------------------
+void			MelodyIndex::clear()
+{
+	*this = MelodyIndex();
+}
+//------------------------------------------------------------------------------
+size_t			MelodyIndex::get_file_count() const
+{
+	return header ? header->file_count : 0;
+}
+//------------------------------------------------------------------------------
+std::filesystem::path	MelodyIndex::get_file(uint32_t file) const
+{
+	if (file >= get_file_count())
+		throw std::out_of_range(__func__);
+	const FileEntry& entry = files[file];
+	if (entry.path_offset > header->path_size || entry.path_size > header->path_size - entry.path_offset)
+		throw std::runtime_error("Invalid index file");
+	return std::filesystem::path(std::string(paths + entry.path_offset, entry.path_size));
+}
+//------------------------------------------------------------------------------
+size_t			MelodyIndex::get_melody_count() const
+{
+	return header ? header->melody_count : 0;
+}
+//------------------------------------------------------------------------------
+int				MelodyIndex::get_gram_size() const
+{
+	return header ? header->gram_size : 0;
+}
+//------------------------------------------------------------------------------
+std::vector<MelodyIndex::Match>	MelodyIndex::search(std::span<const NoteSpan> notes, MelodyQuery query) const
+{
+	std::vector<Match> matches;
+	std::vector<Step> pattern = get_steps(get_line(notes));
+	if (!header || pattern.size() < header->gram_size)
+		return matches;
+
+	// melodies by the grams of the query they have
+	std::vector<uint16_t> hits(header->melody_count);
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> found;
+	for (uint64_t gram: get_grams(pattern, header->gram_size, !query.rhythm, query.rhythm))
+	{
+		found.clear();
+		decode(gram, found);
+		for (uint32_t melody: found)
+		{
+			if (hits[melody] == 0)
+				candidates.push_back(melody);
+			if (hits[melody] < UINT16_MAX)
+				++hits[melody];
+		}
+	}
+	if (candidates.size() > query.max_candidates)
+	{
+		std::nth_element(
+			candidates.begin(), candidates.begin() + query.max_candidates, candidates.end(),
+			[&](uint32_t a, uint32_t b){ return hits[a] != hits[b] ? hits[a] > hits[b] : a < b; }
+		);
+		candidates.resize(query.max_candidates);
+	}
+
+	// aligned in parallel, the entries checked as they are used
+	matches.resize(candidates.size());
+	parallel_for((candidates.size() + 63) / 64, [&](size_t block)
+	{
+		size_t end = std::min(candidates.size(), (block + 1) * 64);
+		for (size_t i = block * 64; i < end; ++i)
+		{
+			const MelodyEntry& melody = melodies[candidates[i]];
+			if (melody.file >= header->file_count
+				|| melody.step_offset > header->step_count
+				|| melody.step_count > header->step_count - melody.step_offset)
+				throw std::runtime_error("Invalid index file");
+			uint32_t begin, end;
+			uint32_t cost = align(pattern, {steps + melody.step_offset, melody.step_count}, query.rhythm, begin, end);
+			double score = 1 - static_cast<double>(cost) / (step_cost * pattern.size());
+			matches[i] = {melody.file, static_cast<int>(melody.track), begin, end - begin, score};
+		}
+	});
+	std::erase_if(matches, [&](const Match& match){ return match.score < query.min_score; });
+	std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b)
+	{
+		if (a.score != b.score)
+			return a.score > b.score;
+		if (a.file != b.file)
+			return a.file < b.file;
+		if (a.track != b.track)
+			return a.track < b.track;
+		return a.note < b.note;
+	});
+	if (matches.size() > query.max_results)
+		matches.resize(query.max_results);
+	return matches;
+}
+//------------------------------------------------------------------------------
+std::vector<NoteSpan>	MelodyIndex::get_line(std::span<const NoteSpan> spans)
+{
+	std::vector<NoteSpan> line;
+	for (const NoteSpan& span: spans)
+	{
+		if (span.channel != 9)
+			line.push_back(span);
+	}
+	std::sort(line.begin(), line.end(), [](const NoteSpan& a, const NoteSpan& b)
+	{
+		return a.tick != b.tick ? a.tick < b.tick : a.key > b.key;
+	});
+	line.erase(
+		std::unique(line.begin(), line.end(), [](const NoteSpan& a, const NoteSpan& b){ return a.tick == b.tick; }),
+		line.end()
+	);
+	return line;
+}
+//------------------------------------------------------------------------------
+void			MelodyIndex::attach(
+	std::shared_ptr<const void>		owner,
+	const byte*						image,
+	size_t							size
+)
+{
+	// only the header and the sections are checked here, the entries as they
+	// are used, so a large index opens without being read
+	auto* h = reinterpret_cast<const Header*>(image);
+	if (size < sizeof(Header)
+		|| reinterpret_cast<uintptr_t>(image) % alignof(Header)
+		|| std::memcmp(h->magic, image_magic, sizeof(image_magic))
+		|| h->version != image_version
+		|| h->byte_order != image_byte_order
+		|| h->header_size != sizeof(Header)
+		|| h->key_size != sizeof(Key)
+		|| h->image_size != size
+		|| h->gram_size == 0 || h->gram_size > 64
+		|| h->file_count >= size
+		|| h->melody_count > size
+		|| h->step_count > size
+		|| h->key_count > size
+		|| h->data_size > size
+		|| h->path_size > size)
+		throw std::runtime_error("Invalid index file");
+	for (int i = 0; i < SECTION_COUNT; ++i)
+	{
+		if (h->sections[i] % 8
+			|| h->sections[i] > size
+			|| h->get_section_size(i) > size - h->sections[i])
+			throw std::runtime_error("Invalid index file");
+	}
+
+	this->owner = std::move(owner);
+	header = h;
+	files = h->get_section<const FileEntry>(image, FILES);
+	melodies = h->get_section<const MelodyEntry>(image, MELODIES);
+	steps = h->get_section<const Step>(image, STEPS);
+	keys = h->get_section<const Key>(image, KEYS);
+	data = h->get_section<const byte>(image, DATA);
+	paths = h->get_section<const char>(image, PATHS);
+}
+//------------------------------------------------------------------------------
+void			MelodyIndex::decode(uint64_t gram, std::vector<uint32_t>& output) const
+{
+	const Key* end = keys + header->key_count;
+	const Key* found = std::lower_bound(keys, end, gram, [](const Key& a, uint64_t gram){ return a.gram < gram; });
+	if (found == end || found->gram != gram)
+		return;
+	if (found->offset > header->data_size || found->size > header->data_size - found->offset)
+		throw std::runtime_error("Invalid index file");
+
+	const byte* begin = data + found->offset;
+	const byte* stop = begin + found->size;
+	uint64_t value = 0;
+	for (uint32_t i = 0; i < found->count; ++i)
+	{
+		uint32_t delta = 0;
+		for (int shift = 0;; shift += 7)
+		{
+			if (begin == stop || shift > 28)
+				throw std::runtime_error("Invalid index file");
+			byte b = *begin++;
+			delta |= static_cast<uint32_t>(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				break;
+		}
+		value += delta;
+		if (value >= header->melody_count)
+			throw std::runtime_error("Invalid index file");
+		output.push_back(static_cast<uint32_t>(value));
+	}
+}
+//------------------------------------------------------------------------------
+std::vector<MelodyIndex::Step>	MelodyIndex::get_steps(std::span<const NoteSpan> line)
+{
+	std::vector<Step> result;
+	for (size_t i = 1; i < line.size(); ++i)
+	{
+		Step step;
+		step.interval = static_cast<int8_t>(line[i].key - line[i - 1].key);
+		step.ratio = no_ratio;
+		if (i > 1)
+		{
+			// onsets of a line differ, so neither time is 0
+			double ratio = static_cast<double>(line[i].tick - line[i - 1].tick) / (line[i - 1].tick - line[i - 2].tick);
+			step.ratio = static_cast<int8_t>(std::clamp<long>(std::lround(2 * std::log2(ratio)), -max_ratio, max_ratio));
+		}
+		result.push_back(step);
+	}
+	return result;
+}
+//------------------------------------------------------------------------------
+std::vector<uint64_t>	MelodyIndex::get_grams(std::span<const Step> steps, int gram_size, bool pitch, bool rhythm)
+{
+	std::vector<uint64_t> grams;
+	for (size_t i = 0; i + gram_size <= steps.size(); ++i)
+	{
+		// the ratio of the first step reaches before the gram, so it is left out
+		uint64_t pitch_hash = pitch_seed;
+		uint64_t rhythm_hash = rhythm_seed;
+		for (int j = 0; j < gram_size; ++j)
+		{
+			pitch_hash = hash_step(steps[i + j].interval, pitch_hash);
+			rhythm_hash = hash_step(steps[i + j].interval, rhythm_hash);
+			if (j)
+				rhythm_hash = hash_step(steps[i + j].ratio, rhythm_hash);
+		}
+		if (pitch)
+			grams.push_back(pitch_hash);
+		if (rhythm)
+			grams.push_back(rhythm_hash);
+	}
+	std::sort(grams.begin(), grams.end());
+	grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+	return grams;
+}
+//------------------------------------------------------------------------------
+uint32_t		MelodyIndex::align(
+	std::span<const Step>	query,
+	std::span<const Step>	melody,
+	bool					rhythm,
+	uint32_t&				begin,
+	uint32_t&				end
+)
+{
+	// a column per step of the melody: the least cost of the first i steps of
+	// the query ending there, and where in the melody that began
+	size_t size = query.size();
+	std::vector<uint32_t> cost(size + 1), next_cost(size + 1);
+	std::vector<uint32_t> start(size + 1, 0), next_start(size + 1);
+	for (size_t i = 0; i <= size; ++i)
+		cost[i] = i * step_cost;
+	uint32_t best = cost[size];
+	begin = end = 0;
+	for (size_t j = 1; j <= melody.size(); ++j)
+	{
+		const Step& step = melody[j - 1];
+		next_cost[0] = 0;
+		next_start[0] = j;
+		for (size_t i = 1; i <= size; ++i)
+		{
+			const Step& other = query[i - 1];
+			uint32_t substitution = cost[i - 1];
+			if (other.interval != step.interval)
+				substitution += step_cost;
+			else if (rhythm && other.ratio != step.ratio && other.ratio != no_ratio && step.ratio != no_ratio)
+				substitution += ratio_cost;
+			uint32_t skip = next_cost[i - 1] + step_cost; // a step of the query missing
+			uint32_t extra = cost[i] + step_cost; // a step of the melody more
+			if (substitution <= skip && substitution <= extra)
+			{
+				next_cost[i] = substitution;
+				next_start[i] = start[i - 1];
+			}
+			else if (skip <= extra)
+			{
+				next_cost[i] = skip;
+				next_start[i] = next_start[i - 1];
+			}
+			else
+			{
+				next_cost[i] = extra;
+				next_start[i] = start[i];
+			}
+		}
+		cost.swap(next_cost);
+		start.swap(next_start);
+		if (cost[size] < best)
+		{
+			best = cost[size];
+			begin = start[size];
+			end = j;
+		}
+	}
+	return best;
+}
+} // MidiParser
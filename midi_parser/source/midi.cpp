@@ -1,8 +1,12 @@
 #include "midi.h"
+#include "smf_encoder.h"
+#include "text_dump.h"
 #include "util.h"
 #include <vector>
 #include <iostream>
 #include <bit>
+#include <algorithm>
+#include <span>
 
 
 
@@ -59,6 +63,26 @@ Microseconds	Division::get_delta_time_duration() const
 		return Microseconds(1000000 / value[0] / value[1]);
 	return Microseconds(0);
 }
+//------------------------------------------------------------------------------
+Division::Type	Division::get_type() const
+{
+	return type;
+}
+//------------------------------------------------------------------------------
+int				Division::get_division() const
+{
+	return type == QUARTER_NOTE ? value[0] : 0;
+}
+//------------------------------------------------------------------------------
+int				Division::get_frame_rate() const
+{
+	return type == SMPTE ? value[0] : 0;
+}
+//------------------------------------------------------------------------------
+int				Division::get_ticks() const
+{
+	return type == SMPTE ? value[1] : 0;
+}
 
 
 
@@ -69,18 +93,24 @@ Microseconds	Division::get_delta_time_duration() const
 	Midi
 
 ##########################*/
-Midi::Midi(const std::filesystem::path& file_path)
+Midi::Midi(const std::filesystem::path& file_path, bool keep_offsets)
 {
-	open(file_path);
+	open(file_path, keep_offsets);
 }
 //------------------------------------------------------------------------------
-void	Midi::open(const std::filesystem::path& file_path)
+void	Midi::open(const std::filesystem::path& file_path, bool keep_offsets)
 {
 	close();
-	std::vector<byte> data = read_bin_file(file_path);
+	// taken first, a file changed while read looks changed afterwards
+	uint64_t file_size;
+	int64_t file_time;
+	get_file_stamp(file_path, file_size, file_time);
+	// kept, so that save() copies what is not changed
+	auto data = std::make_shared<const std::vector<byte>>(read_bin_file(file_path));
 
-	const byte* begin = &data[0];
-	const byte* end = begin + data.size();
+	const byte* const file_begin = data->data();
+	const byte* begin = file_begin;
+	const byte* end = begin + data->size();
 
 	std::string magic_num = "0000";
 	magic_num[0] = read1(begin, end);
@@ -91,10 +121,13 @@ void	Midi::open(const std::filesystem::path& file_path)
 		throw std::runtime_error("Invalid file");
 
 	// length of header data
-	read4(begin, end);
+	uint32_t header_length = read4(begin, end);
+	if (header_length < 6 || header_length > static_cast<size_t>(end - begin))
+		throw std::runtime_error("Invalid file");
+	const byte* header_end = begin + header_length;
 	
 	// format
-	read2(begin, end);
+	format = static_cast<Format>(read2(begin, end));
 
 	// track count
 	uint16_t track_count = read2(begin, end);
@@ -113,26 +146,39 @@ void	Midi::open(const std::filesystem::path& file_path)
 	{
 		division.set_division(div);
 	}
+	begin = header_end;
 
-	for (int i = 0; i < track_count; i++)
+	while (static_cast<int>(tracks.size()) < track_count)
 	{
+		const byte* chunk_begin = begin;
 		magic_num[0] = read1(begin, end);
 		magic_num[1] = read1(begin, end);
 		magic_num[2] = read1(begin, end);
 		magic_num[3] = read1(begin, end);
-		if (magic_num != "MTrk")
-			throw std::runtime_error("Invalid file");
 		uint32_t length = read4(begin, end);
 		const byte* track_end = begin + length;
-		if (track_end > end)
-			throw std::out_of_range("");
+		if (magic_num != "MTrk")
+		{
+			// unknown chunks are skipped, as the spec says, and kept
+			if (length > static_cast<size_t>(end - begin))
+				throw std::runtime_error("Invalid file");
+			raw_chunks.push_back({tracks.size(), size_t(chunk_begin - file_begin), size_t(track_end - file_begin)});
+			begin = track_end;
+			continue;
+		}
+		if (length > static_cast<size_t>(end - begin))
+			throw std::out_of_range("Track is truncated");
 
 		Track& track = tracks.emplace_back();
 		track.events.reserve(length / 10);
+		if (keep_offsets)
+			track.event_offsets.reserve(length / 3);
 
 		std::shared_ptr<Event> prev_event;
 		while (begin < track_end)
 		{
+			if (keep_offsets)
+				track.event_offsets.push_back(begin - chunk_begin);
 			uint64_t delta_time = read_variable(begin, track_end);
 			uint64_t status = read1(begin, track_end);
 			
@@ -154,10 +200,7 @@ void	Midi::open(const std::filesystem::path& file_path)
 				);
 				auto meta_type = dynamic_cast<MetaEvent*>(prev_event.get())->get_type();
 				if (meta_type == MetaEvent::END_OF_TRACK)
-				{
-					begin = track_end;
 					break;
-				}
 			}
 			else if (type == Event::SYSEX)
 			{
@@ -173,77 +216,129 @@ void	Midi::open(const std::filesystem::path& file_path)
 				);
 			}
 		}
+		if (keep_offsets)
+		{
+			track.event_offsets.push_back(begin - chunk_begin);
+			track.event_offsets.shrink_to_fit();
+		}
+		begin = track_end;
+		track.set_source(data, chunk_begin - file_begin, track_end - file_begin);
+		track_origins.push_back(chunk_begin - file_begin);
 	}
+	// whatever follows the last track
+	if (begin < end)
+		raw_chunks.push_back({tracks.size(), size_t(begin - file_begin), data->size()});
+
 	update_timestamp();
 	this->file_path = file_path;
+	source = std::move(data);
+	source_time = file_time;
+	header_size = header_end - file_begin;
 }
 //------------------------------------------------------------------------------
 void			Midi::close()
 {
 	tracks.clear();
 	file_path.clear();
+	format = Format::MULTIPLE_TRACK;
+	source.reset();
+	source_time = 0;
+	header_size = 0;
+	raw_chunks.clear();
+	track_origins.clear();
+}
+//------------------------------------------------------------------------------
+Midi::Format	Midi::get_format() const
+{
+	return format;
+}
+//------------------------------------------------------------------------------
+void			Midi::set_format(Format format)
+{
+	this->format = format;
+}
+//------------------------------------------------------------------------------
+int				Midi::get_track_count() const
+{
+	return tracks.size();
 }
 //------------------------------------------------------------------------------
 std::ostream&	Midi::str(std::ostream& os) const
 {
-	os 
-	<< "Header\n"
-	<< "Format: ";
-	if (tracks.size() == 1)
-		os << "Single Track";
-	else if (tracks.size() > 1)
-		os << "Multiple Tracks";
-	os
-	<< "Num of tracks: " << tracks.size() << '\n'
-	<< "Division: " << division.to_string() << '\n'
-	<< "\n===================================================================\n";
-	
-	int track_num = 0;
-	for (const auto& track: tracks)
-	{
-		os 
-		<< "Track " << track_num++
-		<< "\nNum of Events: " << track.events.size() << '\n';
-		
-		int event_num = 0;
-		for (const auto& event: track.events)
-		{
-			os << std::setw(6) << event_num++ << " | ";
-			event->str(os) << '\n';
-		}
-		os<< "===================================================================\n";
-	}
-	return os;
+	return os << TextDump::str(*this);
 }
 //------------------------------------------------------------------------------
 std::string		Midi::str() const
 {
-	std::stringstream ss;
-	str(ss);
-	return ss.str();
+	return TextDump::str(*this);
+}
+//------------------------------------------------------------------------------
+std::filesystem::path	Midi::get_file_path() const
+{
+	return file_path;
+}
+//------------------------------------------------------------------------------
+std::span<const byte>	Midi::get_source() const
+{
+	if (!source)
+		return {};
+	return *source;
+}
+//------------------------------------------------------------------------------
+int64_t			Midi::get_source_time() const
+{
+	return source_time;
 }
 //------------------------------------------------------------------------------
 void			Midi::save_str(const std::filesystem::path& file_path) const
 {
-	std::ofstream ofs(file_path);
-	if (!ofs.is_open())
-		throw std::runtime_error("create failed");
-
-	str(ofs);
-	ofs.close();
+	TextDump::save(*this, file_path);
 }
 //------------------------------------------------------------------------------
 void			Midi::save_str() const
 {
 	std::filesystem::path save_path = file_path;
 	save_path.replace_extension("txt");
+	TextDump::save(*this, save_path);
+}
+//------------------------------------------------------------------------------
+void			Midi::save(const std::filesystem::path& file_path, bool running_status) const
+{
+	if (format == Format::SINGLE_TRACK && tracks.size() != 1)
+		throw std::logic_error("Format 0 must have exactly one track");
+
+	// header, then a chunk per dirty track, encoded in parallel
+	std::vector<std::vector<byte>> chunks(tracks.size() + 1);
+	std::vector<char> dirty(tracks.size());
+	SmfEncoder::encode_header(chunks[0], format, tracks.size(), division);
+	parallel_for(tracks.size(), [&](size_t i)
+	{
+		dirty[i] = tracks[i].is_dirty();
+		if (dirty[i])
+			SmfEncoder::encode_track(chunks[i + 1], tracks[i], running_status);
+	});
 
-	std::ofstream ofs(save_path);
-	if (!ofs.is_open())
-		throw std::runtime_error("create failed");
+	// the header read is kept while its fields are the same, it may be longer
+	std::span<const byte> header = chunks[0];
+	if (source && std::equal(header.begin() + 8, header.end(), source->begin() + 8))
+		header = {source->data(), header_size};
 
-	str(ofs);
-	ofs.close();
+	// unknown chunks stay between the tracks they were read between while the
+	// tracks are those read in that order, otherwise they follow the last one
+	bool same_layout = tracks.size() == track_origins.size();
+	for (size_t i = 0; same_layout && i < tracks.size(); ++i)
+		same_layout = tracks[i].source == source && tracks[i].source_begin == track_origins[i];
+
+	std::vector<std::span<const byte>> buffers = {header};
+	auto raw_chunk = raw_chunks.begin();
+	for (size_t i = 0; i <= tracks.size(); ++i)
+	{
+		for (; raw_chunk != raw_chunks.end() && (i == tracks.size() || (same_layout && raw_chunk->track <= i)); ++raw_chunk)
+			buffers.emplace_back(source->data() + raw_chunk->begin, raw_chunk->end - raw_chunk->begin);
+		if (i < tracks.size())
+			buffers.push_back(dirty[i] ? chunks[i + 1] : tracks[i].get_source());
+	}
+	write_bin_file(file_path, buffers);
 }
 //------------------------------------------------------------------------------
 void			Midi::update_timestamp()
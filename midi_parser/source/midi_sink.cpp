@@ -0,0 +1,195 @@
+#include "midi_sink.h"
+#include "event/midi_event.h"
+#include "util.h"
+#include <bit>
+#include <fstream>
+#include <iomanip>
+
+namespace MidiParser {
+/*##########################
+
+	MidiSink
+
+##########################*/
+void		MidiSink::send(const uint32_t* messages, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		send(messages[i]);
+}
+//------------------------------------------------------------------------------
+void		MidiSink::reset()
+{
+	for (int channel = 0; channel < 16; ++channel)
+	{
+		int status = Event::CONTROL_CHANGE << 4 | channel;
+		send(MidiEvent::make_binary(status, Controller::ALL_SOUND_OFF, 0));
+		send(MidiEvent::make_binary(status, Controller::RESET_ALL_CONTROLLERS, 0));
+	}
+}
+//------------------------------------------------------------------------------
+size_t		MidiSink::get_message_length(int status)
+{
+	switch (status >> 4)
+	{
+		case Event::PROGRAM_CHANGE:
+		case Event::CHANNEL_PRESSURE:
+			return 2;
+		case 0xf:
+			break;
+		default:
+			return 3;
+	}
+	switch (status)
+	{
+		case Event::MTC_QUARTER_FRAME:
+		case Event::SONG_REQUEST:
+			return 2;
+		case Event::SONG_POSITION_POINTER:
+			return 3;
+		default:
+			return 1;
+	}
+}
+//------------------------------------------------------------------------------
+size_t		MidiSink::unpack(uint32_t message, byte* bytes)
+{
+	if constexpr (std::endian::native == std::endian::little)
+	{
+		bytes[0] = message & 0xff;
+		bytes[1] = (message >> 8) & 0xff;
+		bytes[2] = (message >> 16) & 0xff;
+	}
+	else
+	{
+		bytes[0] = (message >> 24) & 0xff;
+		bytes[1] = (message >> 16) & 0xff;
+		bytes[2] = (message >> 8) & 0xff;
+	}
+	return get_message_length(bytes[0]);
+}
+
+
+
+
+/*##########################
+
+	NullSink
+
+##########################*/
+void		NullSink::send(uint32_t)
+{
+	message_count.fetch_add(1, std::memory_order_relaxed);
+}
+//------------------------------------------------------------------------------
+void		NullSink::send(const uint32_t*, size_t count)
+{
+	message_count.fetch_add(count, std::memory_order_relaxed);
+}
+//------------------------------------------------------------------------------
+void		NullSink::send_sysex(const byte*, size_t)
+{
+	sysex_count.fetch_add(1, std::memory_order_relaxed);
+}
+//------------------------------------------------------------------------------
+uint64_t	NullSink::get_message_count() const
+{
+	return message_count;
+}
+//------------------------------------------------------------------------------
+uint64_t	NullSink::get_sysex_count() const
+{
+	return sysex_count;
+}
+
+
+
+
+/*##########################
+
+	RecordingSink
+
+##########################*/
+RecordingSink::RecordingSink(size_t capacity)
+{
+	records.reserve(capacity);
+}
+//------------------------------------------------------------------------------
+void		RecordingSink::send(uint32_t message)
+{
+	Timepoint now = Clock::now();
+	std::lock_guard lock(mutex);
+	records.push_back({elapsed(now), message, 0, 0});
+}
+//------------------------------------------------------------------------------
+void		RecordingSink::send(const uint32_t* messages, size_t count)
+{
+	Timepoint now = Clock::now();
+	std::lock_guard lock(mutex);
+	Microseconds time = elapsed(now);
+	for (size_t i = 0; i < count; ++i)
+		records.push_back({time, messages[i], 0, 0});
+}
+//------------------------------------------------------------------------------
+void		RecordingSink::send_sysex(const byte* data, size_t size)
+{
+	Timepoint now = Clock::now();
+	std::lock_guard lock(mutex);
+	records.push_back({
+		elapsed(now), 0, static_cast<uint32_t>(sysex.size()), static_cast<uint32_t>(size)
+	});
+	sysex.insert(sysex.end(), data, data + size);
+}
+//------------------------------------------------------------------------------
+void		RecordingSink::clear()
+{
+	std::lock_guard lock(mutex);
+	records.clear();
+	sysex.clear();
+	started = false;
+}
+//------------------------------------------------------------------------------
+std::vector<RecordingSink::Record>	RecordingSink::get_records() const
+{
+	std::lock_guard lock(mutex);
+	return records;
+}
+//------------------------------------------------------------------------------
+std::vector<byte>	RecordingSink::get_sysex(const Record& record) const
+{
+	std::lock_guard lock(mutex);
+	auto begin = sysex.begin() + record.sysex_offset;
+	return std::vector<byte>(begin, begin + record.sysex_size);
+}
+//------------------------------------------------------------------------------
+void		RecordingSink::save(const std::filesystem::path& file_path) const
+{
+	std::ofstream ofs(file_path);
+	if (!ofs.is_open())
+		throw std::runtime_error("create failed");
+
+	std::lock_guard lock(mutex);
+	for (const Record& record: records)
+	{
+		ofs << std::setw(12) << record.time.count() << " | ";
+		if (record.sysex_size)
+		{
+			const byte* data = sysex.data() + record.sysex_offset;
+			ofs << hex_dump(data, data + record.sysex_size, true) << '\n';
+			continue;
+		}
+		byte bytes[3];
+		size_t length = unpack(record.message, bytes);
+		ofs << hex_dump(bytes, bytes + length, true) << '\n';
+	}
+}
+//------------------------------------------------------------------------------
+Microseconds	RecordingSink::elapsed(Timepoint now)
+{
+	if (!started)
+	{
+		start = now;
+		started = true;
+	}
+	return std::chrono::duration_cast<Microseconds>(now - start);
+}
+} // MidiParser
@@ -0,0 +1,230 @@
+#include "note_span.h"
+#include "util.h"
+#include <algorithm>
+
+namespace MidiParser {
+/*##########################
+
+	NotePairer
+
+##########################*/
+NotePairer::NotePairer(Policy policy):
+	policy(policy)
+{
+	reset();
+}
+//------------------------------------------------------------------------------
+void			NotePairer::reset(int track)
+{
+	this->track = track;
+	spans.clear();
+	next.clear();
+	heads.fill(none);
+	tails.fill(none);
+	orphan_count = 0;
+}
+//------------------------------------------------------------------------------
+void			NotePairer::note_on(uint64_t tick, int channel, int key, int velocity)
+{
+	if (velocity == 0)
+	{
+		note_off(tick, channel, key, 0);
+		return;
+	}
+	size_t slot = (channel & 0xf) << 7 | (key & 0x7f);
+	if (policy.overlap == Overlap::RETRIGGER)
+	{
+		for (uint32_t span = heads[slot]; span != none; span = next[span])
+			end(span, tick, 0);
+		heads[slot] = tails[slot] = none;
+	}
+
+	uint32_t span = spans.size();
+	spans.push_back({
+		tick, 0, static_cast<uint16_t>(track), static_cast<byte>(channel & 0xf),
+		static_cast<byte>(key & 0x7f), static_cast<byte>(velocity), 0
+	});
+	next.push_back(none);
+
+	// the list is popped from its head: newest first for LIFO, oldest otherwise
+	if (policy.overlap == Overlap::LAST_IN_FIRST_OUT)
+	{
+		next[span] = heads[slot];
+		heads[slot] = span;
+	}
+	else
+	{
+		if (heads[slot] == none)
+			heads[slot] = span;
+		else
+			next[tails[slot]] = span;
+		tails[slot] = span;
+	}
+}
+//------------------------------------------------------------------------------
+void			NotePairer::note_off(uint64_t tick, int channel, int key, int velocity)
+{
+	size_t slot = (channel & 0xf) << 7 | (key & 0x7f);
+	uint32_t span = heads[slot];
+	if (span == none)
+	{
+		++orphan_count;
+		return;
+	}
+	heads[slot] = next[span];
+	if (heads[slot] == none)
+		tails[slot] = none;
+	end(span, tick, velocity);
+}
+//------------------------------------------------------------------------------
+void			NotePairer::apply(uint64_t tick, const Event& event)
+{
+	if (event.get_category() != Event::MIDI)
+		return;
+	auto& midi_event = static_cast<const MidiEvent&>(event);
+	apply(tick, midi_event.get_status(), midi_event.data[0], midi_event.data[1]);
+}
+//------------------------------------------------------------------------------
+void			NotePairer::apply(uint64_t tick, int status, int data0, int data1)
+{
+	switch (status >> 4)
+	{
+		case Event::NOTE_ON:	note_on(tick, status & 0xf, data0, data1); break;
+		case Event::NOTE_OFF:	note_off(tick, status & 0xf, data0, data1); break;
+		default:				break;
+	}
+}
+//------------------------------------------------------------------------------
+void			NotePairer::finish(uint64_t end_tick)
+{
+	bool dropped = false;
+	for (size_t slot = 0; slot < heads.size(); ++slot)
+	{
+		for (uint32_t span = heads[slot]; span != none; span = next[span])
+		{
+			if (policy.dangling == Dangling::DROP)
+			{
+				spans[span].duration = UINT64_MAX;
+				dropped = true;
+			}
+			else
+			{
+				end(span, std::max(end_tick, spans[span].tick), 0);
+			}
+		}
+		heads[slot] = tails[slot] = none;
+	}
+	if (dropped)
+		std::erase_if(spans, [](const NoteSpan& span){ return span.duration == UINT64_MAX; });
+	next.clear();
+}
+//------------------------------------------------------------------------------
+std::vector<NoteSpan>&	NotePairer::get_spans()
+{
+	return spans;
+}
+//------------------------------------------------------------------------------
+size_t			NotePairer::get_orphan_count() const
+{
+	return orphan_count;
+}
+//------------------------------------------------------------------------------
+std::vector<NoteSpan>	NotePairer::pair(const Track& track, int track_number, Policy policy)
+{
+	NotePairer pairer(policy);
+	pairer.reset(track_number);
+	// about half of the events are note ons in most files
+	pairer.spans.reserve(track.events.size() / 2);
+	pairer.next.reserve(track.events.size() / 2);
+	for (const auto& event: track.events)
+		pairer.apply(event->timestamp, *event);
+	pairer.finish(track.events.empty() ? 0 : track.events.back()->timestamp);
+	return std::move(pairer.spans);
+}
+//------------------------------------------------------------------------------
+std::vector<NoteSpan>	NotePairer::pair(const Midi& midi, Policy policy)
+{
+	std::vector<std::vector<NoteSpan>> tracks = pair_tracks(midi, policy);
+	std::vector<NoteSpan> spans;
+	std::vector<size_t> begins = {0};
+	for (const auto& track: tracks)
+	{
+		spans.insert(spans.end(), track.begin(), track.end());
+		begins.push_back(spans.size());
+	}
+	return merge(std::move(spans), std::move(begins));
+}
+//------------------------------------------------------------------------------
+std::vector<NoteSpan>	NotePairer::pair(const EventTable& table, Policy policy)
+{
+	auto ticks = table.get_ticks();
+	auto statuses = table.get_statuses();
+	auto data0 = table.get_data0();
+	auto data1 = table.get_data1();
+
+	std::vector<std::vector<NoteSpan>> tracks(table.get_track_count());
+	parallel_for(tracks.size(), [&](size_t track)
+	{
+		size_t begin = table.get_track_begin(track);
+		size_t end = table.get_track_end(track);
+		NotePairer pairer(policy);
+		pairer.reset(track);
+		pairer.spans.reserve((end - begin) / 2);
+		pairer.next.reserve((end - begin) / 2);
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (statuses[i] < 0xa0)
+				pairer.apply(ticks[i], statuses[i], data0[i], data1[i]);
+		}
+		pairer.finish(begin < end ? ticks[end - 1] : 0);
+		tracks[track] = std::move(pairer.spans);
+	});
+
+	std::vector<NoteSpan> spans;
+	std::vector<size_t> begins = {0};
+	for (const auto& track: tracks)
+	{
+		spans.insert(spans.end(), track.begin(), track.end());
+		begins.push_back(spans.size());
+	}
+	return merge(std::move(spans), std::move(begins));
+}
+//------------------------------------------------------------------------------
+std::vector<std::vector<NoteSpan>>	NotePairer::pair_tracks(const Midi& midi, Policy policy)
+{
+	std::vector<std::vector<NoteSpan>> tracks(midi.tracks.size());
+	parallel_for(tracks.size(), [&](size_t i)
+	{
+		tracks[i] = pair(midi.tracks[i], i, policy);
+	});
+	return tracks;
+}
+//------------------------------------------------------------------------------
+void			NotePairer::end(uint32_t span, uint64_t tick, int velocity)
+{
+	NoteSpan& note = spans[span];
+	note.duration = tick - note.tick;
+	note.off_velocity = velocity;
+}
+//------------------------------------------------------------------------------
+std::vector<NoteSpan>	NotePairer::merge(std::vector<NoteSpan> spans, std::vector<size_t> begins)
+{
+	// pairs of neighbouring runs, so O(n log tracks); stable keeps track order
+	auto by_tick = [](const NoteSpan& a, const NoteSpan& b){ return a.tick < b.tick; };
+	while (begins.size() > 2)
+	{
+		std::vector<size_t> merged = {0};
+		for (size_t i = 0; i + 1 < begins.size(); i += 2)
+		{
+			size_t last = i + 2 < begins.size() ? begins[i + 2] : begins[i + 1];
+			std::inplace_merge(
+				spans.begin() + begins[i], spans.begin() + begins[i + 1],
+				spans.begin() + last, by_tick
+			);
+			merged.push_back(last);
+		}
+		begins = std::move(merged);
+	}
+	return spans;
+}
+} // MidiParser
@@ -0,0 +1,131 @@
+#include "piano_roll.h"
+#include "util.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	PianoRoll
+
+##########################*/
+PianoRoll::PianoRoll(uint64_t ticks_per_frame):
+	ticks_per_frame(ticks_per_frame)
+{
+	if (ticks_per_frame == 0)
+		throw std::invalid_argument("PianoRoll: ticks_per_frame is 0");
+}
+//------------------------------------------------------------------------------
+PianoRoll::PianoRoll(const TempoMap& tempo_map, double frames_per_second):
+	tempo_map(tempo_map), frames_per_us(frames_per_second / 1000000)
+{
+	if (!(frames_per_second > 0))
+		throw std::invalid_argument("PianoRoll: frames_per_second must be positive");
+}
+//------------------------------------------------------------------------------
+size_t			PianoRoll::get_frame(uint64_t tick) const
+{
+	if (ticks_per_frame)
+		return tick / ticks_per_frame;
+	return static_cast<size_t>(tempo_map.get_time(tick).count() * frames_per_us);
+}
+//------------------------------------------------------------------------------
+size_t			PianoRoll::get_frame_count(std::span<const NoteSpan> spans) const
+{
+	size_t count = 0;
+	for (const NoteSpan& span: spans)
+		count = std::max(count, get_range(span).end);
+	return count;
+}
+//------------------------------------------------------------------------------
+void			PianoRoll::render(std::span<const NoteSpan> spans, const Planes& planes) const
+{
+	const size_t frame_count = planes.frame_count;
+	if (frame_count == 0)
+		return;
+
+	// frames of every note first, the tempo map is searched in parallel
+	constexpr size_t chunk_size = 1 << 14;
+	std::vector<Range> ranges(spans.size());
+	parallel_for((spans.size() + chunk_size - 1) / chunk_size, [&](size_t chunk)
+	{
+		size_t end = std::min(spans.size(), (chunk + 1) * chunk_size);
+		for (size_t i = chunk * chunk_size; i < end; ++i)
+			ranges[i] = get_range(spans[i]);
+	});
+
+	// notes of each key in their order, counting sort
+	std::array<uint32_t, key_count + 1> begins = {};
+	for (const NoteSpan& span: spans)
+		++begins[(span.key & 0x7f) + 1];
+	for (size_t key = 0; key < key_count; ++key)
+		begins[key + 1] += begins[key];
+	std::vector<uint32_t> order(spans.size());
+	std::array<uint32_t, key_count> positions;
+	std::copy(begins.begin(), begins.end() - 1, positions.begin());
+	for (uint32_t i = 0; i < spans.size(); ++i)
+		order[positions[spans[i].key & 0x7f]++] = i;
+
+	byte* const targets[] = {planes.velocity, planes.onset, planes.sustain};
+	const size_t window_end = planes.first_frame + frame_count;
+	parallel_for(key_count, [&](size_t key)
+	{
+		size_t row = key * frame_count;
+		for (byte* target: targets)
+		{
+			if (target)
+				std::memset(target + row, 0, frame_count);
+		}
+
+		auto notes = std::span(order).subspan(begins[key], begins[key + 1] - begins[key]);
+		auto by_begin = [&](uint32_t a, uint32_t b){ return ranges[a].begin < ranges[b].begin; };
+		if (!std::is_sorted(notes.begin(), notes.end(), by_begin))
+			std::stable_sort(notes.begin(), notes.end(), by_begin);
+
+		// the latest first, each writes only the frames no later note took,
+		// which are a stack of runs with the earliest on top
+		std::vector<Range> taken;
+		for (size_t n = notes.size(); n-- > 0;)
+		{
+			const NoteSpan& span = spans[notes[n]];
+			Range range = ranges[notes[n]];
+			if (planes.onset && range.begin >= planes.first_frame && range.begin < window_end)
+				planes.onset[row + range.begin - planes.first_frame] = 1;
+			range.begin = std::max(range.begin, planes.first_frame);
+			range.end = std::min(range.end, window_end);
+			if (range.begin >= range.end)
+				continue;
+
+			auto fill = [&](size_t from, size_t to)
+			{
+				if (planes.velocity)
+					std::memset(planes.velocity + row + from - planes.first_frame, span.velocity, to - from);
+				if (planes.sustain)
+					std::memset(planes.sustain + row + from - planes.first_frame, 1, to - from);
+			};
+			size_t position = range.begin;
+			size_t end = range.end;
+			while (!taken.empty() && taken.back().begin < range.end)
+			{
+				if (position < taken.back().begin)
+					fill(position, taken.back().begin);
+				position = std::max(position, taken.back().end);
+				end = std::max(end, taken.back().end);
+				taken.pop_back();
+			}
+			if (position < range.end)
+				fill(position, range.end);
+			taken.push_back({range.begin, end});
+		}
+	});
+}
+//------------------------------------------------------------------------------
+PianoRoll::Range	PianoRoll::get_range(const NoteSpan& span) const
+{
+	size_t begin = get_frame(span.tick);
+	size_t end = get_frame(span.tick + span.duration);
+	return {begin, std::max(end, begin + 1)};
+}
+} // MidiParser
@@ -0,0 +1,94 @@
+#include "playback_clock.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	PlaybackClock
+
+##########################*/
+PlaybackClock::PlaybackClock(double scale):
+	anchor_wall(Clock::now()), from_scale(scale), to_scale(scale)
+{
+	if (!(scale > 0))
+		throw std::invalid_argument("PlaybackClock: scale must be positive");
+}
+//------------------------------------------------------------------------------
+void			PlaybackClock::reset(Timepoint wall, Microseconds song)
+{
+	anchor_wall = wall;
+	anchor_song = static_cast<double>(song.count());
+	from_scale = to_scale;
+	ramp = 0;
+}
+//------------------------------------------------------------------------------
+void			PlaybackClock::set_scale(Timepoint now, double scale, Microseconds ramp)
+{
+	if (!(scale > 0))
+		throw std::invalid_argument("PlaybackClock: scale must be positive");
+
+	double elapsed = std::chrono::duration<double, std::micro>(now - anchor_wall).count();
+	anchor_song += get_elapsed_song(elapsed);
+	from_scale = get_scale(now);
+	to_scale = scale;
+	anchor_wall = now;
+	this->ramp = static_cast<double>(std::max<int64_t>(ramp.count(), 0));
+}
+//------------------------------------------------------------------------------
+double			PlaybackClock::get_scale(Timepoint wall) const
+{
+	double elapsed = std::chrono::duration<double, std::micro>(wall - anchor_wall).count();
+	if (elapsed <= 0)
+		return from_scale;
+	if (elapsed >= ramp)
+		return to_scale;
+	return from_scale + (to_scale - from_scale) * elapsed / ramp;
+}
+//------------------------------------------------------------------------------
+double			PlaybackClock::get_target_scale() const
+{
+	return to_scale;
+}
+//------------------------------------------------------------------------------
+Microseconds	PlaybackClock::get_song_time(Timepoint wall) const
+{
+	double elapsed = std::chrono::duration<double, std::micro>(wall - anchor_wall).count();
+	return Microseconds(static_cast<int64_t>(std::floor(anchor_song + get_elapsed_song(elapsed))));
+}
+//------------------------------------------------------------------------------
+Timepoint		PlaybackClock::get_wall_time(Microseconds song) const
+{
+	std::chrono::duration<double, std::micro> elapsed(
+		get_elapsed_wall(static_cast<double>(song.count()) - anchor_song)
+	);
+	return anchor_wall + std::chrono::ceil<Clock::duration>(elapsed);
+}
+//------------------------------------------------------------------------------
+double			PlaybackClock::get_elapsed_song(double elapsed_wall) const
+{
+	if (elapsed_wall <= 0)
+		return elapsed_wall * from_scale;
+	if (elapsed_wall >= ramp)
+		return (from_scale + to_scale) / 2 * ramp + (elapsed_wall - ramp) * to_scale;
+
+	// the speed grows linearly, so the position is quadratic
+	double acceleration = (to_scale - from_scale) / ramp;
+	return from_scale * elapsed_wall + acceleration * elapsed_wall * elapsed_wall / 2;
+}
+//------------------------------------------------------------------------------
+double			PlaybackClock::get_elapsed_wall(double elapsed_song) const
+{
+	if (elapsed_song <= 0)
+		return elapsed_song / from_scale;
+	double ramp_song = (from_scale + to_scale) / 2 * ramp;
+	if (elapsed_song >= ramp_song)
+		return ramp + (elapsed_song - ramp_song) / to_scale;
+
+	// root of a/2 t^2 + from t - s = 0, in the form that stays exact as a -> 0
+	double acceleration = (to_scale - from_scale) / ramp;
+	double discriminant = from_scale * from_scale + 2 * acceleration * elapsed_song;
+	return 2 * elapsed_song / (from_scale + std::sqrt(std::max(discriminant, 0.0)));
+}
+} // MidiParser
@@ -0,0 +1,143 @@
+#include "playback_monitor.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+
+namespace MidiParser {
+/*##########################
+
+	PlaybackMonitor
+
+##########################*/
+void			PlaybackMonitor::reset()
+{
+	histogram.fill(0);
+	count = 0;
+	total = 0;
+	max = 0;
+	sender_wakeup_count = 0;
+	producer_wakeup_count = 0;
+}
+//------------------------------------------------------------------------------
+void			PlaybackMonitor::record(Timepoint deadline, Timepoint sent, uint64_t count)
+{
+	// early is not late
+	int64_t lateness = std::max<int64_t>(
+		std::chrono::duration_cast<Nanoseconds>(sent - deadline).count(), 0
+	);
+	histogram[get_bucket(lateness)] += count;
+	this->count += count;
+	total += lateness * count;
+	max = std::max<uint64_t>(max, lateness);
+}
+//------------------------------------------------------------------------------
+void			PlaybackMonitor::add_sender_wakeup()
+{
+	++sender_wakeup_count;
+}
+//------------------------------------------------------------------------------
+void			PlaybackMonitor::add_producer_wakeup()
+{
+	++producer_wakeup_count;
+}
+//------------------------------------------------------------------------------
+uint64_t		PlaybackMonitor::get_count() const
+{
+	return count;
+}
+//------------------------------------------------------------------------------
+uint64_t		PlaybackMonitor::get_sender_wakeup_count() const
+{
+	return sender_wakeup_count;
+}
+//------------------------------------------------------------------------------
+uint64_t		PlaybackMonitor::get_producer_wakeup_count() const
+{
+	return producer_wakeup_count;
+}
+//------------------------------------------------------------------------------
+PlaybackMonitor::Nanoseconds	PlaybackMonitor::get_percentile(double percentile) const
+{
+	if (count == 0)
+		return Nanoseconds(0);
+	uint64_t target = std::clamp<uint64_t>(
+		static_cast<uint64_t>(std::ceil(percentile / 100 * count)), 1, count
+	);
+	uint64_t sum = 0;
+	for (int i = 0; i < bucket_count; ++i)
+	{
+		sum += histogram[i];
+		if (sum >= target)
+			return Nanoseconds(std::min(get_bucket_limit(i), max));
+	}
+	return Nanoseconds(max);
+}
+//------------------------------------------------------------------------------
+PlaybackMonitor::Nanoseconds	PlaybackMonitor::get_max() const
+{
+	return Nanoseconds(max);
+}
+//------------------------------------------------------------------------------
+PlaybackMonitor::Nanoseconds	PlaybackMonitor::get_mean() const
+{
+	return Nanoseconds(count ? total / count : 0);
+}
+//------------------------------------------------------------------------------
+std::ostream&	PlaybackMonitor::str(std::ostream& os) const
+{
+	auto us = [](Nanoseconds ns){ return ns.count() / 1000.0; };
+	std::ios_base::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+	os
+	<< "Messages: " << count << '\n'
+	<< "Sender wakeups: " << sender_wakeup_count << '\n'
+	<< "Producer wakeups: " << producer_wakeup_count << '\n'
+	<< std::fixed << std::setprecision(1)
+	<< "Lateness(us) mean: " << us(get_mean())
+	<< ", p50: " << us(get_percentile(50))
+	<< ", p99: " << us(get_percentile(99))
+	<< ", p99.9: " << us(get_percentile(99.9))
+	<< ", max: " << us(get_max()) << '\n';
+	os.flags(flags);
+	os.precision(precision);
+
+	// histogram, a row per power of 2
+	if (count == 0)
+		return os;
+	uint64_t row_count = 0;
+	for (int i = 0; i < bucket_count; ++i)
+	{
+		row_count += histogram[i];
+		if ((i + 1) % sub_bucket_count || row_count == 0)
+			continue;
+		os
+		<< "  <= " << std::setw(12) << get_bucket_limit(i) << " ns | "
+		<< std::setw(10) << row_count << " | "
+		<< std::string(std::max<uint64_t>(row_count * 50 / count, 1), '#') << '\n';
+		row_count = 0;
+	}
+	return os;
+}
+//------------------------------------------------------------------------------
+int				PlaybackMonitor::get_bucket(uint64_t value)
+{
+	if (value < sub_bucket_count)
+		return value;
+	int msb = std::bit_width(value) - 1;
+	int shift = msb - sub_bucket_bits;
+	int row = shift + 1;
+	return row * sub_bucket_count + ((value >> shift) & (sub_bucket_count - 1));
+}
+//------------------------------------------------------------------------------
+uint64_t		PlaybackMonitor::get_bucket_limit(int bucket)
+{
+	int row = bucket / sub_bucket_count;
+	uint64_t sub = bucket % sub_bucket_count;
+	if (row == 0)
+		return sub;
+	int shift = row - 1;
+	uint64_t lower = (sub_bucket_count + sub) << shift;
+	return lower + ((uint64_t(1) << shift) - 1);
+}
+} // MidiParser
@@ -0,0 +1,268 @@
+#include "playback_stream.h"
+#include "midi.h"
+#include "tempo_map.h"
+#include "track_merger.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	Cache file
+
+##########################*/
+namespace {
+// Native byte order, the cache is not meant to move between machines.
+struct CacheHeader
+{
+	char			magic[4];
+	uint32_t		version;
+	uint32_t		byte_order;
+	uint32_t		record_size;
+	uint64_t		source_size;
+	int64_t			source_time;
+	uint64_t		record_count;
+	uint64_t		sysex_count;
+	uint64_t		sysex_data_size;
+};
+
+constexpr char		cache_magic[4] = {'M', 'P', 'S', 'C'};
+constexpr uint32_t	cache_version = 1;
+constexpr uint32_t	cache_byte_order = 0x01020304;
+} // anonymous
+
+
+
+
+
+/*##########################
+
+	PlaybackStream
+
+##########################*/
+PlaybackStream::PlaybackStream(const Midi& midi)
+{
+	compile(midi);
+}
+//------------------------------------------------------------------------------
+PlaybackStream::PlaybackStream(const std::filesystem::path& cache_path)
+{
+	load(cache_path);
+}
+//------------------------------------------------------------------------------
+void			PlaybackStream::compile(const Midi& midi)
+{
+	clear();
+	TempoMap tempo_map(midi);
+	records.reserve(midi.event_count());
+
+	for (const TrackMerger::Item& item: TrackMerger(midi))
+	{
+		const Event* event = item.event;
+		int64_t time = tempo_map.get_time(event->timestamp).count();
+
+		if (event->get_category() == Event::MIDI)
+		{
+			auto* midi_event = static_cast<const MidiEvent*>(event);
+			records.push_back({time, midi_event->get_binary(), no_sysex});
+		}
+		else if (event->get_type() == Event::SYSEX_MESSAGES)
+		{
+			auto* sysex_messages = static_cast<const SysexMessages*>(event);
+			records.push_back({time, 0, static_cast<uint32_t>(sysex_offsets.size() - 1)});
+			sysex_data.push_back(Event::SYSEX_MESSAGES);
+			sysex_messages->get_messages(sysex_data);
+			sysex_offsets.push_back(static_cast<uint32_t>(sysex_data.size()));
+		}
+	}
+	records.shrink_to_fit();
+
+	std::filesystem::path file_path = midi.get_file_path();
+	if (!file_path.empty() && std::filesystem::exists(file_path))
+		get_file_stamp(file_path, source_size, source_time);
+}
+//------------------------------------------------------------------------------
+void			PlaybackStream::load(const std::filesystem::path& cache_path)
+{
+	clear();
+	std::ifstream ifs(cache_path, std::ios::binary);
+	if (!ifs.is_open())
+		throw std::runtime_error("Error: open file");
+
+	CacheHeader header;
+	ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!ifs
+		|| std::memcmp(header.magic, cache_magic, sizeof(cache_magic))
+		|| header.version != cache_version
+		|| header.byte_order != cache_byte_order
+		|| header.record_size != sizeof(Record))
+		throw std::runtime_error("Invalid cache file");
+	// counts bounded first, so the size below can not wrap
+	uint64_t file_size = std::filesystem::file_size(cache_path);
+	if (header.record_count > file_size / sizeof(Record)
+		|| header.sysex_count >= file_size / sizeof(uint32_t)
+		|| header.sysex_data_size > file_size)
+		throw std::runtime_error("Invalid cache file");
+	uint64_t expected_size = sizeof(header)
+		+ header.record_count * sizeof(Record)
+		+ (header.sysex_count + 1) * sizeof(uint32_t)
+		+ header.sysex_data_size;
+	if (file_size != expected_size)
+		throw std::runtime_error("Invalid cache file");
+
+	records.resize(header.record_count);
+	sysex_offsets.resize(header.sysex_count + 1);
+	sysex_data.resize(header.sysex_data_size);
+	ifs.read(
+		reinterpret_cast<char*>(records.data()),
+		records.size() * sizeof(Record)
+	);
+	ifs.read(
+		reinterpret_cast<char*>(sysex_offsets.data()),
+		sysex_offsets.size() * sizeof(uint32_t)
+	);
+	ifs.read(reinterpret_cast<char*>(sysex_data.data()), sysex_data.size());
+	if (!ifs || !is_valid())
+	{
+		clear();
+		throw std::runtime_error("Invalid cache file");
+	}
+	source_size = header.source_size;
+	source_time = header.source_time;
+}
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// as compile() makes them: records in time order, each sysex of its own
+// bytes(at least the status) and referred to by a record
+bool			PlaybackStream::is_valid() const
+{
+	if (sysex_offsets.front() != 0 || sysex_offsets.back() != sysex_data.size())
+		return false;
+	for (size_t i = 1; i < sysex_offsets.size(); ++i)
+	{
+		if (sysex_offsets[i] <= sysex_offsets[i - 1])
+			return false;
+	}
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if ((i && records[i].time < records[i - 1].time)
+			|| (records[i].sysex != no_sysex && records[i].sysex >= sysex_offsets.size() - 1))
+			return false;
+	}
+	return true;
+}
+void			PlaybackStream::save(const std::filesystem::path& cache_path) const
+{
+	std::ofstream ofs(cache_path, std::ios::binary);
+	if (!ofs.is_open())
+		throw std::runtime_error("create failed");
+
+	CacheHeader header = {};
+	std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.byte_order = cache_byte_order;
+	header.record_size = sizeof(Record);
+	header.source_size = source_size;
+	header.source_time = source_time;
+	header.record_count = records.size();
+	header.sysex_count = get_sysex_count();
+	header.sysex_data_size = sysex_data.size();
+
+	ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	ofs.write(
+		reinterpret_cast<const char*>(records.data()),
+		records.size() * sizeof(Record)
+	);
+	ofs.write(
+		reinterpret_cast<const char*>(sysex_offsets.data()),
+		sysex_offsets.size() * sizeof(uint32_t)
+	);
+	ofs.write(reinterpret_cast<const char*>(sysex_data.data()), sysex_data.size());
+	if (!ofs)
+		throw std::runtime_error("write failed");
+}
+//------------------------------------------------------------------------------
+void			PlaybackStream::clear()
+{
+	records.clear();
+	sysex_offsets.assign(1, 0);
+	sysex_data.clear();
+	source_size = 0;
+	source_time = 0;
+}
+//------------------------------------------------------------------------------
+PlaybackStream	PlaybackStream::load_cached(
+	const std::filesystem::path&	midi_path,
+	const std::filesystem::path&	cache_path
+)
+{
+	uint64_t size;
+	int64_t time;
+	get_file_stamp(midi_path, size, time);
+
+	PlaybackStream stream;
+	if (std::filesystem::exists(cache_path))
+	{
+		try
+		{
+			stream.load(cache_path);
+			if (stream.source_size == size && stream.source_time == time)
+				return stream;
+		}
+		catch (const std::runtime_error&)
+		{
+			// stale or broken, compile again
+		}
+	}
+	stream.compile(Midi(midi_path));
+	stream.save(cache_path);
+	return stream;
+}
+//------------------------------------------------------------------------------
+const std::vector<PlaybackStream::Record>&	PlaybackStream::get_records() const
+{
+	return records;
+}
+//------------------------------------------------------------------------------
+size_t			PlaybackStream::size() const
+{
+	return records.size();
+}
+//------------------------------------------------------------------------------
+bool			PlaybackStream::empty() const
+{
+	return records.empty();
+}
+//------------------------------------------------------------------------------
+size_t			PlaybackStream::find(Microseconds time) const
+{
+	auto it = std::lower_bound(
+		records.begin(), records.end(), time.count(),
+		[](const Record& record, int64_t time){ return record.time < time; }
+	);
+	return it - records.begin();
+}
+//------------------------------------------------------------------------------
+Microseconds	PlaybackStream::get_duration() const
+{
+	return Microseconds(records.empty() ? 0 : records.back().time);
+}
+//------------------------------------------------------------------------------
+const byte*		PlaybackStream::get_sysex(uint32_t sysex) const
+{
+	return sysex_data.data() + sysex_offsets.at(sysex);
+}
+//------------------------------------------------------------------------------
+uint32_t		PlaybackStream::get_sysex_size(uint32_t sysex) const
+{
+	return sysex_offsets.at(sysex + 1) - sysex_offsets[sysex];
+}
+//------------------------------------------------------------------------------
+size_t			PlaybackStream::get_sysex_count() const
+{
+	return sysex_offsets.size() - 1;
+}
+} // MidiParser
@@ -0,0 +1,290 @@
+#include "player.h"
+#include <thread>
+
+namespace MidiParser {
+/*##########################
+
+	Player
+
+##########################*/
+Player::Player(const Midi& midi, size_t buffer_size):
+	tempo_map(midi), merger(midi), ring(buffer_size)
+{}
+//------------------------------------------------------------------------------
+void			Player::play(const Callback& callback)
+{
+	run(
+		[&](const TrackMerger::Item& item, Timepoint){ callback(item); },
+		Microseconds(0)
+	);
+}
+//------------------------------------------------------------------------------
+void			Player::play(MidiSink& sink, const Callback& callback)
+{
+	ring.clear();
+	overrun_count = 0;
+	underrun_count = 0;
+	producing = true;
+	std::thread sender(&Player::send, this, std::ref(sink));
+
+	// Sysex data must stay where it is until the sender is done. The ring
+	// holds at most capacity() messages, so with one buffer more than that,
+	// taken in turn, a buffer comes back only after its message was sent.
+	std::vector<std::vector<byte>> sysex_pool(ring.capacity() + 1);
+	size_t sysex_count = 0;
+	run(
+		[&](const TrackMerger::Item& item, Timepoint deadline)
+		{
+			if (callback)
+				callback(item);
+			const Event* event = item.event;
+			if (event->get_category() == Event::MIDI)
+			{
+				auto* midi_event = static_cast<const MidiEvent*>(event);
+				push({deadline, midi_event->get_binary(), 0, nullptr});
+			}
+			else if (event->get_type() == Event::SYSEX_MESSAGES)
+			{
+				auto* sysex_messages = static_cast<const SysexMessages*>(event);
+				std::vector<byte>& sysex = sysex_pool[sysex_count++ % sysex_pool.size()];
+				sysex.assign(1, Event::SYSEX_MESSAGES);
+				sysex_messages->get_messages(sysex);
+				push({
+					deadline, 0, static_cast<uint32_t>(sysex.size()), sysex.data()
+				});
+			}
+			else if (event->get_type() == Event::END_OF_SYSEX_MESSAGES)
+			{
+				// escaped bytes go out as they are, from the event itself
+				const std::vector<byte>& escaped = static_cast<const EndOfSysexMessages*>(event)->get_messages();
+				if (!escaped.empty())
+					push({deadline, 0, static_cast<uint32_t>(escaped.size()), escaped.data()});
+			}
+		},
+		lookahead
+	);
+
+	producing = false;
+	notify_sender();
+	sender.join();
+}
+//------------------------------------------------------------------------------
+void			Player::stop()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopped = true;
+	}
+	condition.notify_all();
+	notify_sender();
+}
+//------------------------------------------------------------------------------
+void			Player::seek(uint64_t tick)
+{
+	if (playing)
+		throw std::logic_error("Player: seek while playing");
+	merger.seek(tick);
+	position = tick;
+}
+//------------------------------------------------------------------------------
+void			Player::set_lookahead(Microseconds lookahead)
+{
+	if (playing)
+		throw std::logic_error("Player: set_lookahead while playing");
+	this->lookahead = lookahead;
+}
+//------------------------------------------------------------------------------
+void			Player::set_monitor(PlaybackMonitor* monitor)
+{
+	if (playing)
+		throw std::logic_error("Player: set_monitor while playing");
+	this->monitor = monitor;
+}
+//------------------------------------------------------------------------------
+void			Player::set_tempo_scale(double scale, Microseconds ramp)
+{
+	{
+		std::lock_guard lock(mutex);
+		clock.set_scale(Clock::now(), scale, ramp);
+		++clock_version;
+	}
+	condition.notify_all();
+}
+//------------------------------------------------------------------------------
+double			Player::get_tempo_scale() const
+{
+	std::lock_guard lock(mutex);
+	return clock.get_target_scale();
+}
+//------------------------------------------------------------------------------
+uint64_t		Player::get_position() const
+{
+	return position;
+}
+//------------------------------------------------------------------------------
+bool			Player::is_playing() const
+{
+	return playing;
+}
+//------------------------------------------------------------------------------
+uint64_t		Player::get_overrun_count() const
+{
+	return overrun_count;
+}
+//------------------------------------------------------------------------------
+uint64_t		Player::get_underrun_count() const
+{
+	return underrun_count;
+}
+//------------------------------------------------------------------------------
+const TempoMap&	Player::get_tempo_map() const
+{
+	return tempo_map;
+}
+//------------------------------------------------------------------------------
+void			Player::run(const Producer& producer, Microseconds lookahead)
+{
+	{
+		std::lock_guard lock(mutex);
+		stopped = false;
+		// leave time for the first batch to be prepared
+		clock.reset(Clock::now() + lookahead, tempo_map.get_time(position));
+	}
+	playing = true;
+
+	while (!merger.empty())
+	{
+		uint64_t timestamp = merger.get_timestamp();
+		position = timestamp;
+
+		Timepoint deadline;
+		if (!wait_until(tempo_map.get_time(timestamp), lookahead, deadline))
+			break;
+		if (monitor)
+			monitor->add_producer_wakeup();
+
+		while (!merger.empty() && merger.get_timestamp() == timestamp)
+			producer(merger.next(), deadline);
+	}
+	if (merger.empty())
+	{
+		merger.reset();
+		position = 0;
+	}
+	playing = false;
+}
+//------------------------------------------------------------------------------
+void			Player::push(const Message& message)
+{
+	if (!ring.try_push(message))
+	{
+		overrun_count.fetch_add(1, std::memory_order_relaxed);
+		while (!ring.try_push(message))
+		{
+			if (stopped)
+				return;
+			std::this_thread::yield();
+		}
+	}
+	notify_sender();
+}
+//------------------------------------------------------------------------------
+void			Player::notify_sender()
+{
+	produced.fetch_add(1, std::memory_order_release);
+	produced.notify_one();
+}
+//------------------------------------------------------------------------------
+void			Player::send(MidiSink& sink)
+{
+	// Messages sharing a deadline are sent as a batch.
+	constexpr size_t batch_size = 64;
+	uint32_t batch[batch_size];
+
+	while (!stopped)
+	{
+		uint32_t sequence = produced.load(std::memory_order_acquire);
+		const Message* message = ring.front();
+		if (!message)
+		{
+			if (!producing)
+				break;
+			produced.wait(sequence, std::memory_order_acquire);
+			if (monitor)
+				monitor->add_sender_wakeup();
+			continue;
+		}
+
+		Timepoint deadline = message->deadline;
+		if (Clock::now() > deadline)
+		{
+			underrun_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			std::this_thread::sleep_until(deadline);
+			if (monitor)
+				monitor->add_sender_wakeup();
+		}
+		if (stopped)
+			break;
+
+		size_t count = 0;
+		while (message && message->deadline == deadline)
+		{
+			if (message->sysex_size)
+			{
+				send_batch(sink, batch, count, deadline);
+				sink.send_sysex(message->sysex, message->sysex_size);
+				if (monitor)
+					monitor->record(deadline, Clock::now());
+			}
+			else
+			{
+				batch[count++] = message->message;
+				if (count == batch_size)
+					send_batch(sink, batch, count, deadline);
+			}
+			ring.pop();
+			message = ring.front();
+		}
+		send_batch(sink, batch, count, deadline);
+	}
+}
+//------------------------------------------------------------------------------
+void			Player::send_batch(
+	MidiSink&	sink,
+	uint32_t*	batch,
+	size_t&		count,
+	Timepoint	deadline
+)
+{
+	if (count == 0)
+		return;
+	sink.send(batch, count);
+	if (monitor)
+		monitor->record(deadline, Clock::now(), count);
+	count = 0;
+}
+//------------------------------------------------------------------------------
+bool			Player::wait_until(Microseconds time, Microseconds lookahead, Timepoint& deadline)
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		// Time MUST be calculated by absolute time.
+		// Relative time MAY cause time delay;
+		// calculated again whenever the tempo scale changes.
+		deadline = clock.get_wall_time(time);
+		uint64_t version = clock_version;
+		condition.wait_until(lock, deadline - lookahead, [&]
+		{
+			return stopped || clock_version != version;
+		});
+		if (stopped)
+			return false;
+		if (clock_version == version)
+			return true;
+	}
+}
+} // MidiParser
@@ -0,0 +1,225 @@
+#include "session_scheduler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	SessionScheduler
+
+##########################*/
+SessionScheduler::SessionScheduler(size_t thread_count, Microseconds resolution):
+	resolution(resolution), epoch(Clock::now())
+{
+	if (thread_count == 0 || resolution.count() <= 0)
+		throw std::invalid_argument("SessionScheduler: invalid argument");
+	shards.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; ++i)
+		shards.emplace_back(std::make_unique<Shard>());
+	for (auto& shard: shards)
+		shard->thread = std::thread(&SessionScheduler::run, this, std::ref(*shard));
+}
+//------------------------------------------------------------------------------
+SessionScheduler::~SessionScheduler()
+{
+	for (auto& shard: shards)
+	{
+		{
+			std::lock_guard lock(shard->mutex);
+			stopped = true;
+		}
+		shard->condition.notify_all();
+	}
+	for (auto& shard: shards)
+		shard->thread.join();
+}
+//------------------------------------------------------------------------------
+SessionScheduler::SessionId		SessionScheduler::add(
+	std::shared_ptr<const PlaybackStream>	stream,
+	MidiSink&								sink,
+	double									tempo_scale
+)
+{
+	if (!stream || tempo_scale <= 0)
+		throw std::invalid_argument("SessionScheduler: invalid argument");
+
+	SessionId id = next_id++;
+	auto session = std::make_unique<Session>();
+	session->id = id;
+	session->stream = std::move(stream);
+	session->sink = &sink;
+	session->clock = PlaybackClock(tempo_scale);
+	session->clock.reset(Clock::now(), Microseconds(0));
+
+	Shard& shard = get_shard(id);
+	{
+		std::lock_guard lock(shard.mutex);
+		schedule(shard, *shard.sessions.emplace(id, std::move(session)).first->second);
+	}
+	shard.condition.notify_one();
+	return id;
+}
+//------------------------------------------------------------------------------
+void			SessionScheduler::remove(SessionId id)
+{
+	Shard& shard = get_shard(id);
+	std::lock_guard lock(shard.mutex);
+	auto it = shard.sessions.find(id);
+	if (it == shard.sessions.end())
+		return;
+	shard.wheel.remove(it->second.get());
+	shard.sessions.erase(it);
+}
+//------------------------------------------------------------------------------
+void			SessionScheduler::set_tempo_scale(
+	SessionId		id,
+	double			tempo_scale,
+	Microseconds	ramp
+)
+{
+	Shard& shard = get_shard(id);
+	{
+		std::lock_guard lock(shard.mutex);
+		Session* session = find(shard, id);
+		if (!session || session->finished)
+			return;
+		session->clock.set_scale(Clock::now(), tempo_scale, ramp);
+		schedule(shard, *session);
+	}
+	shard.condition.notify_one();
+}
+//------------------------------------------------------------------------------
+Microseconds	SessionScheduler::get_position(SessionId id) const
+{
+	Shard& shard = get_shard(id);
+	std::lock_guard lock(shard.mutex);
+	Session* session = find(shard, id);
+	if (!session)
+		return Microseconds(0);
+	Microseconds duration = session->stream->get_duration();
+	if (session->finished)
+		return duration;
+	return std::min(session->clock.get_song_time(Clock::now()), duration);
+}
+//------------------------------------------------------------------------------
+bool			SessionScheduler::is_finished(SessionId id) const
+{
+	Shard& shard = get_shard(id);
+	std::lock_guard lock(shard.mutex);
+	Session* session = find(shard, id);
+	return !session || session->finished;
+}
+//------------------------------------------------------------------------------
+size_t			SessionScheduler::get_session_count() const
+{
+	size_t count = 0;
+	for (const auto& shard: shards)
+	{
+		std::lock_guard lock(shard->mutex);
+		count += shard->sessions.size();
+	}
+	return count;
+}
+//------------------------------------------------------------------------------
+size_t			SessionScheduler::get_thread_count() const
+{
+	return shards.size();
+}
+//------------------------------------------------------------------------------
+void			SessionScheduler::run(Shard& shard)
+{
+	std::unique_lock lock(shard.mutex);
+	while (!stopped)
+	{
+		// Every node up to the current tick is due: ticks are rounded up.
+		Timepoint now = Clock::now();
+		shard.wheel.advance((now - epoch) / resolution, shard.expired);
+		for (TimerWheel::Node* node: shard.expired)
+			play(shard, static_cast<Session&>(*node), now);
+		shard.expired.clear();
+
+		uint64_t next = shard.wheel.get_next_expiry();
+		if (next == TimerWheel::no_expiry)
+			shard.condition.wait(lock);
+		else
+			shard.condition.wait_until(lock, to_timepoint(next));
+	}
+}
+//------------------------------------------------------------------------------
+void			SessionScheduler::play(Shard& shard, Session& session, Timepoint now)
+{
+	constexpr size_t batch_size = 64;
+	uint32_t batch[batch_size];
+	size_t count = 0;
+
+	const PlaybackStream& stream = *session.stream;
+	const auto& records = stream.get_records();
+	for (; session.cursor < records.size(); ++session.cursor)
+	{
+		const PlaybackStream::Record& record = records[session.cursor];
+		if (session.clock.get_wall_time(Microseconds(record.time)) > now)
+			break;
+		if (record.sysex == PlaybackStream::no_sysex)
+		{
+			batch[count++] = record.message;
+			if (count < batch_size)
+				continue;
+		}
+		if (count)
+		{
+			session.sink->send(batch, count);
+			count = 0;
+		}
+		if (record.sysex != PlaybackStream::no_sysex)
+		{
+			session.sink->send_sysex(
+				stream.get_sysex(record.sysex), stream.get_sysex_size(record.sysex)
+			);
+		}
+	}
+	if (count)
+		session.sink->send(batch, count);
+
+	if (session.cursor == records.size())
+		session.finished = true;
+	else
+		schedule(shard, session);
+}
+//------------------------------------------------------------------------------
+void			SessionScheduler::schedule(Shard& shard, Session& session)
+{
+	const auto& records = session.stream->get_records();
+	if (session.cursor == records.size())
+	{
+		shard.wheel.remove(&session);
+		session.finished = true;
+		return;
+	}
+	Timepoint deadline = session.clock.get_wall_time(Microseconds(records[session.cursor].time));
+	shard.wheel.insert(&session, to_tick(deadline));
+}
+//------------------------------------------------------------------------------
+uint64_t		SessionScheduler::to_tick(Timepoint timepoint) const
+{
+	if (timepoint <= epoch)
+		return 0;
+	auto elapsed = timepoint - epoch;
+	return (elapsed + resolution - Clock::duration(1)) / resolution;
+}
+//------------------------------------------------------------------------------
+Timepoint		SessionScheduler::to_timepoint(uint64_t tick) const
+{
+	return epoch + static_cast<int64_t>(tick) * resolution;
+}
+//------------------------------------------------------------------------------
+SessionScheduler::Shard&	SessionScheduler::get_shard(SessionId id) const
+{
+	return *shards[id % shards.size()];
+}
+//------------------------------------------------------------------------------
+SessionScheduler::Session*	SessionScheduler::find(Shard& shard, SessionId id) const
+{
+	auto it = shard.sessions.find(id);
+	return it == shard.sessions.end() ? nullptr : it->second.get();
+}
+} // MidiParser
@@ -0,0 +1,81 @@
+#include "smf_encoder.h"
+#include "util.h"
+
+namespace MidiParser {
+/*##########################
+
+	SmfEncoder
+
+##########################*/
+SmfEncoder::SmfEncoder(bool running_status):
+	running_status(running_status)
+{}
+//------------------------------------------------------------------------------
+void			SmfEncoder::encode(const Event& event, std::vector<byte>& output)
+{
+	write_variable(output, event.delta_time);
+	int event_status = event.get_status();
+	if (event.get_category() != Event::MIDI)
+	{
+		status = -1;
+		write1(output, event_status);
+	}
+	else if (!running_status || event_status != status)
+	{
+		status = event_status;
+		write1(output, event_status);
+	}
+	event.binary(output);
+}
+//------------------------------------------------------------------------------
+void			SmfEncoder::reset()
+{
+	status = -1;
+}
+//------------------------------------------------------------------------------
+void			SmfEncoder::encode_header(
+	std::vector<byte>&		output,
+	Midi::Format			format,
+	int						track_count,
+	const Division&			division
+)
+{
+	output.insert(output.end(), {'M', 'T', 'h', 'd'});
+	write4(output, 6);
+	write2(output, static_cast<uint16_t>(format));
+	write2(output, track_count);
+	if (division.get_type() == Division::SMPTE)
+	{
+		write1(output, static_cast<byte>(-division.get_frame_rate()));
+		write1(output, division.get_ticks());
+	}
+	else
+	{
+		write2(output, division.get_division());
+	}
+}
+//------------------------------------------------------------------------------
+void			SmfEncoder::encode_track(
+	std::vector<byte>&		output,
+	const Track&			track,
+	bool					running_status
+)
+{
+	// Most events take 3 or 4 bytes, reserve so that it rarely grows.
+	output.reserve(output.size() + 8 + track.events.size() * 4 + 4);
+	output.insert(output.end(), {'M', 'T', 'r', 'k', 0, 0, 0, 0});
+	size_t begin = output.size();
+
+	SmfEncoder encoder(running_status);
+	for (const Event::ptr& event: track.events)
+		encoder.encode(*event, output);
+	if (track.events.empty() || track.events.back()->get_type() != Event::END_OF_TRACK)
+		encoder.encode(EndOfTrack(0), output);
+
+	uint32_t length = static_cast<uint32_t>(output.size() - begin);
+	output[begin - 4] = length >> 24;
+	output[begin - 3] = length >> 16;
+	output[begin - 2] = length >> 8;
+	output[begin - 1] = length;
+}
+} // MidiParser
@@ -0,0 +1,282 @@
+#include "smf_writer.h"
+#include "util.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	SmfWriter
+
+##########################*/
+SmfWriter::SmfWriter(
+	const std::filesystem::path&	file_path,
+	Midi::Format					format,
+	int								track_count,
+	const Division&					division,
+	bool							running_status,
+	size_t							buffer_size
+):
+	file(file_path, std::ios::binary | std::ios::trunc),
+	output(&file), seekable(true), buffer_size(buffer_size),
+	format(format), division(division)
+{
+	if (!file.is_open())
+		throw std::runtime_error("create failed");
+	init(track_count, running_status);
+}
+//------------------------------------------------------------------------------
+SmfWriter::SmfWriter(
+	std::ostream&					output,
+	Midi::Format					format,
+	int								track_count,
+	const Division&					division,
+	bool							running_status,
+	size_t							buffer_size
+):
+	output(&output), seekable(false), buffer_size(buffer_size),
+	format(format), division(division)
+{
+	init(track_count, running_status);
+}
+//------------------------------------------------------------------------------
+SmfWriter::~SmfWriter()
+{
+	try
+	{
+		close();
+	}
+	catch (...)
+	{
+		// nowhere to report it, call close() to know
+	}
+	close_spills();
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::write(int track, const Event& event)
+{
+	TrackState& state = get_track(track);
+	encode(state, event);
+	if (event.get_category() == Event::META && event.get_type() == Event::END_OF_TRACK)
+	{
+		state.ended = true;
+		if (seekable && track == current)
+			end_current();
+	}
+	else if (state.buffer.size() >= buffer_size)
+	{
+		flush(track);
+	}
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::end_track(int track, uint64_t delta_time)
+{
+	write(track, EndOfTrack(delta_time));
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::close()
+{
+	if (!open)
+		return;
+	open = false;
+
+	for (TrackState& state: tracks)
+	{
+		if (state.ended)
+			continue;
+		encode(state, EndOfTrack(0));
+		state.ended = true;
+	}
+
+	if (seekable)
+	{
+		if (current < static_cast<int>(tracks.size()))
+			end_current();
+	}
+	else
+	{
+		std::vector<byte> header;
+		SmfEncoder::encode_header(header, format, tracks.size(), division);
+		write_output(header.data(), header.size());
+		for (TrackState& state: tracks)
+			write_track(state);
+	}
+
+	output->flush();
+	if (file.is_open())
+		file.close();
+	if (!*output)
+		throw std::runtime_error("write failed");
+}
+//------------------------------------------------------------------------------
+int				SmfWriter::get_track_count() const
+{
+	return tracks.size();
+}
+//------------------------------------------------------------------------------
+bool			SmfWriter::is_open() const
+{
+	return open;
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::init(int track_count, bool running_status)
+{
+	if (track_count <= 0 || track_count > 0xffff)
+		throw std::invalid_argument("SmfWriter: invalid track count");
+	// an empty buffer would spill every event and copy nothing back
+	if (buffer_size == 0)
+		throw std::invalid_argument("SmfWriter: buffer size must be positive");
+	if (format == Midi::Format::SINGLE_TRACK && track_count != 1)
+		throw std::logic_error("Format 0 must have exactly one track");
+
+	tracks.resize(track_count);
+	for (TrackState& state: tracks)
+		state.encoder = SmfEncoder(running_status);
+
+	if (seekable)
+	{
+		std::vector<byte> header;
+		SmfEncoder::encode_header(header, format, track_count, division);
+		write_output(header.data(), header.size());
+		begin_current();
+	}
+}
+//------------------------------------------------------------------------------
+SmfWriter::TrackState&	SmfWriter::get_track(int track)
+{
+	if (!open)
+		throw std::logic_error("SmfWriter: closed");
+	if (track < 0 || track >= static_cast<int>(tracks.size()))
+		throw std::out_of_range("SmfWriter: no such track");
+	TrackState& state = tracks[track];
+	if (state.ended)
+		throw std::logic_error("SmfWriter: track already ended");
+	return state;
+}
+//------------------------------------------------------------------------------
+// The MTrk length is 32 bits: an event that would pass it is taken back
+// before anything is written, and the track can go on with smaller ones.
+void			SmfWriter::encode(TrackState& state, const Event& event)
+{
+	SmfEncoder encoder = state.encoder;
+	size_t size = state.buffer.size();
+	state.encoder.encode(event, state.buffer);
+	if (state.length + (state.buffer.size() - size) > UINT32_MAX)
+	{
+		state.buffer.resize(size);
+		state.encoder = encoder;
+		throw std::length_error("SmfWriter: track too long");
+	}
+	state.length += state.buffer.size() - size;
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::flush(int track)
+{
+	TrackState& state = tracks[track];
+	if (seekable && track == current)
+	{
+		write_output(state.buffer.data(), state.buffer.size());
+	}
+	else
+	{
+		if (!state.spill)
+		{
+			state.spill = std::tmpfile();
+			if (!state.spill)
+				throw std::runtime_error("SmfWriter: spill file failed");
+		}
+		if (std::fwrite(state.buffer.data(), 1, state.buffer.size(), state.spill) != state.buffer.size())
+			throw std::runtime_error("SmfWriter: spill file failed");
+		state.spill_size += state.buffer.size();
+	}
+	state.buffer.clear();
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::begin_current()
+{
+	// tracks ended while waiting are complete, write them whole
+	for (; current < static_cast<int>(tracks.size()); ++current)
+	{
+		TrackState& state = tracks[current];
+		if (state.ended)
+		{
+			write_track(state);
+			continue;
+		}
+		static constexpr byte chunk[8] = {'M', 'T', 'r', 'k', 0, 0, 0, 0};
+		write_output(chunk, sizeof(chunk));
+		current_begin = output->tellp();
+		copy_spill(state);
+		return;
+	}
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::end_current()
+{
+	TrackState& state = tracks[current];
+	write_output(state.buffer.data(), state.buffer.size());
+	state.buffer.clear();
+	state.buffer.shrink_to_fit();
+
+	// patch the length of MTrk
+	std::streampos end = output->tellp();
+	uint32_t length = static_cast<uint32_t>(state.length);
+	byte bytes[4] = {
+		static_cast<byte>(length >> 24), static_cast<byte>(length >> 16),
+		static_cast<byte>(length >> 8), static_cast<byte>(length)
+	};
+	output->seekp(current_begin - std::streamoff(4));
+	write_output(bytes, sizeof(bytes));
+	output->seekp(end);
+
+	++current;
+	begin_current();
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::write_track(TrackState& state)
+{
+	std::vector<byte> chunk = {'M', 'T', 'r', 'k'};
+	write4(chunk, static_cast<uint32_t>(state.length));
+	write_output(chunk.data(), chunk.size());
+	copy_spill(state);
+	write_output(state.buffer.data(), state.buffer.size());
+	state.buffer.clear();
+	state.buffer.shrink_to_fit();
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::copy_spill(TrackState& state)
+{
+	if (!state.spill)
+		return;
+	std::rewind(state.spill);
+	std::vector<byte> chunk(std::min<uint64_t>(buffer_size, state.spill_size));
+	for (uint64_t left = state.spill_size; left;)
+	{
+		size_t size = std::min<uint64_t>(left, chunk.size());
+		if (std::fread(chunk.data(), 1, size, state.spill) != size)
+			throw std::runtime_error("SmfWriter: spill file failed");
+		write_output(chunk.data(), size);
+		left -= size;
+	}
+	std::fclose(state.spill);
+	state.spill = nullptr;
+	state.spill_size = 0;
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::write_output(const byte* data, size_t size)
+{
+	output->write(reinterpret_cast<const char*>(data), size);
+	if (!*output)
+		throw std::runtime_error("write failed");
+}
+//------------------------------------------------------------------------------
+void			SmfWriter::close_spills()
+{
+	for (TrackState& state: tracks)
+	{
+		if (state.spill)
+			std::fclose(state.spill);
+		state.spill = nullptr;
+	}
+}
+} // MidiParser
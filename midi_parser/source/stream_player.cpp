@@ -0,0 +1,159 @@
+#include "stream_player.h"
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	StreamPlayer
+
+##########################*/
+StreamPlayer::StreamPlayer(const PlaybackStream& stream):
+	stream(stream)
+{}
+//------------------------------------------------------------------------------
+void			StreamPlayer::play(MidiSink& sink)
+{
+	constexpr size_t batch_size = 64;
+	uint32_t batch[batch_size];
+
+	{
+		std::lock_guard lock(mutex);
+		stopped = false;
+		clock.reset(Clock::now(), Microseconds(position));
+	}
+	playing = true;
+	underrun_count = 0;
+
+	const auto& records = stream.get_records();
+	bool first = true;
+	while (cursor < records.size())
+	{
+		const int64_t time = records[cursor].time;
+		position = time;
+
+		Timepoint now = Clock::now();
+		Timepoint deadline;
+		if (!wait_until(Microseconds(time), deadline))
+			break;
+		// The first batch is due right away, it is not late.
+		if (deadline < now && !first)
+			underrun_count.fetch_add(1, std::memory_order_relaxed);
+		else if (monitor)
+			monitor->add_sender_wakeup();
+		first = false;
+
+		size_t count = 0;
+		for (; cursor < records.size() && records[cursor].time == time; ++cursor)
+		{
+			const PlaybackStream::Record& record = records[cursor];
+			if (record.sysex == PlaybackStream::no_sysex)
+			{
+				batch[count++] = record.message;
+				if (count < batch_size)
+					continue;
+			}
+			if (count)
+			{
+				sink.send(batch, count);
+				if (monitor)
+					monitor->record(deadline, Clock::now(), count);
+				count = 0;
+			}
+			if (record.sysex != PlaybackStream::no_sysex)
+			{
+				sink.send_sysex(
+					stream.get_sysex(record.sysex), stream.get_sysex_size(record.sysex)
+				);
+				if (monitor)
+					monitor->record(deadline, Clock::now());
+			}
+		}
+		if (count)
+		{
+			sink.send(batch, count);
+			if (monitor)
+				monitor->record(deadline, Clock::now(), count);
+		}
+	}
+	if (cursor == records.size())
+	{
+		cursor = 0;
+		position = 0;
+	}
+	playing = false;
+}
+//------------------------------------------------------------------------------
+void			StreamPlayer::stop()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopped = true;
+	}
+	condition.notify_all();
+}
+//------------------------------------------------------------------------------
+void			StreamPlayer::seek(Microseconds time)
+{
+	if (playing)
+		throw std::logic_error("StreamPlayer: seek while playing");
+	cursor = stream.find(time);
+	position = time.count();
+}
+//------------------------------------------------------------------------------
+void			StreamPlayer::set_monitor(PlaybackMonitor* monitor)
+{
+	if (playing)
+		throw std::logic_error("StreamPlayer: set_monitor while playing");
+	this->monitor = monitor;
+}
+//------------------------------------------------------------------------------
+void			StreamPlayer::set_tempo_scale(double scale, Microseconds ramp)
+{
+	{
+		std::lock_guard lock(mutex);
+		clock.set_scale(Clock::now(), scale, ramp);
+		++clock_version;
+	}
+	condition.notify_all();
+}
+//------------------------------------------------------------------------------
+double			StreamPlayer::get_tempo_scale() const
+{
+	std::lock_guard lock(mutex);
+	return clock.get_target_scale();
+}
+//------------------------------------------------------------------------------
+Microseconds	StreamPlayer::get_position() const
+{
+	return Microseconds(position);
+}
+//------------------------------------------------------------------------------
+bool			StreamPlayer::is_playing() const
+{
+	return playing;
+}
+//------------------------------------------------------------------------------
+uint64_t		StreamPlayer::get_underrun_count() const
+{
+	return underrun_count;
+}
+//------------------------------------------------------------------------------
+bool			StreamPlayer::wait_until(Microseconds time, Timepoint& deadline)
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		// calculated again whenever the tempo scale changes
+		deadline = clock.get_wall_time(time);
+		uint64_t version = clock_version;
+		condition.wait_until(lock, deadline, [&]
+		{
+			return stopped || clock_version != version;
+		});
+		if (stopped)
+			return false;
+		if (clock_version == version)
+			return true;
+	}
+}
+} // MidiParser
@@ -0,0 +1,146 @@
+#include "tempo_map.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	TempoMap
+
+##########################*/
+TempoMap::TempoMap(const Midi& midi)
+{
+	build(midi);
+}
+//------------------------------------------------------------------------------
+TempoMap::TempoMap(const Division& division, std::vector<Segment> segments):
+	division(division), segments(std::move(segments))
+{
+	if (this->segments.empty() || this->segments[0].tick != 0)
+		throw std::invalid_argument("TempoMap: no segment at tick 0");
+}
+//------------------------------------------------------------------------------
+void			TempoMap::build(const Midi& midi)
+{
+	division = midi.division;
+
+	struct Change
+	{
+		uint64_t	tick;
+		int64_t		quarter_note_duration;
+	};
+	std::vector<Change> changes;
+	for (const Track& track: midi.tracks)
+	{
+		for (const Event::ptr& event: track.events)
+		{
+			if (event->get_type() != Event::SET_TEMPO)
+				continue;
+			changes.push_back({
+				event->timestamp,
+				static_cast<const SetTempo*>(event.get())->get_quarter_note_duration().count()
+			});
+		}
+	}
+	// Tracks are merged, so the order of changes inside a track must be kept.
+	std::stable_sort(changes.begin(), changes.end(),
+		[](const Change& a, const Change& b){ return a.tick < b.tick; }
+	);
+
+	segments.clear();
+	segments.push_back({0, 0, default_quarter_note_duration});
+	for (const Change& change: changes)
+	{
+		Segment& last = segments.back();
+		if (change.tick == last.tick)
+		{
+			last.quarter_note_duration = change.quarter_note_duration;
+			continue;
+		}
+		int64_t time = last.time + ticks_to_time(
+			last.quarter_note_duration, change.tick - last.tick
+		);
+		segments.push_back({change.tick, time, change.quarter_note_duration});
+	}
+}
+//------------------------------------------------------------------------------
+Microseconds	TempoMap::get_time(uint64_t tick) const
+{
+	const Segment& segment = get_segment(tick);
+	return Microseconds(
+		segment.time + ticks_to_time(segment.quarter_note_duration, tick - segment.tick)
+	);
+}
+//------------------------------------------------------------------------------
+uint64_t		TempoMap::get_tick(Microseconds time) const
+{
+	auto it = std::upper_bound(segments.begin(), segments.end(), time.count(),
+		[](int64_t time, const Segment& segment){ return time < segment.time; }
+	);
+	if (it != segments.begin())
+		--it;
+	if (time.count() <= it->time)
+		return it->tick;
+	return it->tick + time_to_ticks(it->quarter_note_duration, time.count() - it->time);
+}
+//------------------------------------------------------------------------------
+Microseconds	TempoMap::get_quarter_note_duration(uint64_t tick) const
+{
+	return Microseconds(get_segment(tick).quarter_note_duration);
+}
+//------------------------------------------------------------------------------
+const TempoMap::Segment&	TempoMap::get_segment(uint64_t tick) const
+{
+	auto it = std::upper_bound(segments.begin(), segments.end(), tick,
+		[](uint64_t tick, const Segment& segment){ return tick < segment.tick; }
+	);
+	return *(--it);
+}
+//------------------------------------------------------------------------------
+const std::vector<TempoMap::Segment>&	TempoMap::get_segments() const
+{
+	return segments;
+}
+//------------------------------------------------------------------------------
+const Division&	TempoMap::get_division() const
+{
+	return division;
+}
+//------------------------------------------------------------------------------
+int64_t			TempoMap::ticks_to_time(int64_t quarter_note_duration, uint64_t ticks) const
+{
+	// split into quotient and remainder to avoid overflow on long files
+	if (division.get_type() == Division::SMPTE)
+	{
+		int64_t ticks_per_second = division.get_frame_rate() * division.get_ticks();
+		if (ticks_per_second <= 0)
+			return 0;
+		return
+			static_cast<int64_t>(ticks / ticks_per_second) * 1000000 +
+			static_cast<int64_t>(ticks % ticks_per_second) * 1000000 / ticks_per_second;
+	}
+	int64_t ppq = division.get_division();
+	if (ppq <= 0)
+		return 0;
+	return
+		static_cast<int64_t>(ticks / ppq) * quarter_note_duration +
+		static_cast<int64_t>(ticks % ppq) * quarter_note_duration / ppq;
+}
+//------------------------------------------------------------------------------
+uint64_t		TempoMap::time_to_ticks(int64_t quarter_note_duration, int64_t time) const
+{
+	if (division.get_type() == Division::SMPTE)
+	{
+		int64_t ticks_per_second = division.get_frame_rate() * division.get_ticks();
+		return
+			(time / 1000000) * ticks_per_second +
+			(time % 1000000) * ticks_per_second / 1000000;
+	}
+	int64_t ppq = division.get_division();
+	if (quarter_note_duration <= 0)
+		return 0;
+	return
+		(time / quarter_note_duration) * ppq +
+		(time % quarter_note_duration) * ppq / quarter_note_duration;
+}
+} // MidiParser
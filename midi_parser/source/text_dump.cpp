@@ -0,0 +1,418 @@
+#include "text_dump.h"
+#include "event/meta_event.h"
+#include "event/midi_event.h"
+#include "event/sysex_event.h"
+#include "util.h"
+#include <array>
+#include <charconv>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+
+namespace MidiParser {
+namespace {
+constexpr const char	separator[] = "\n===================================================================\n";
+constexpr int			print_width_type = 20; // as Event
+constexpr int			print_width_delta_time = 5;
+constexpr int			print_width_event_number = 6; // as Midi::str()
+
+std::string		pad(const std::string& str, int width)
+{
+	if (static_cast<int>(str.size()) >= width)
+		return str;
+	return std::string(width - str.size(), ' ') + str;
+}
+
+/*
+ * Everything str() prints with std::setw, padded once.
+*/
+struct Names
+{
+	std::array<std::string, 256>	labels; // by Event::Type, with the category
+	std::array<std::string, 128>	notes;
+	std::array<std::string, 128>	controllers;
+	std::array<std::string, 128>	instruments;
+
+	Names()
+	{
+		const std::pair<Event::Type, const char*> midi[] = {
+			{Event::NOTE_OFF,					"Note Off | "},
+			{Event::NOTE_ON,					"Note On | "},
+			{Event::POLYPHONIC_KEY_PRESSURE,	" Polyphonic Key Pressure | "},
+			{Event::CONTROL_CHANGE,				"Control Change | "},
+			{Event::PROGRAM_CHANGE,				"Program Change | "},
+			{Event::CHANNEL_PRESSURE,			"Channel Pressure | "},
+			{Event::PITCH_BEND,					"Pitch Bend | "},
+		};
+		const std::pair<Event::Type, const char*> meta[] = {
+			{Event::SEQUENCE_NUMBER,			"SequenceNumber | "},
+			{Event::USER_TEXT,					"User Text | "},
+			{Event::COPY_RIGHT,					"Copy Right | "},
+			{Event::TRACK_NAME,					"Track Name | "},
+			{Event::INSTRUMENT_NAME,			"InstrumentName | "},
+			{Event::LYRIC,						"Lyric | "},
+			{Event::MARKER,						"Marker | "},
+			{Event::CUE_POINT,					"CuePoint | "},
+			{Event::CHANNEL_PREFIX,				"ChannelPrefix | "},
+			{Event::MIDI_PORT,					"MidiPort | "},
+			{Event::END_OF_TRACK,				"EndOfTrack"},
+			{Event::SET_TEMPO,					"SetTempo | "},
+			{Event::SMPTE_OFFSET,				"SMPTEOffset | "},
+			{Event::TIME_SIGNATURE,				"TimeSignature | "},
+			{Event::KEY_SIGNATURE,				"KeySignature | "},
+			{Event::SEQUENCE_SPECIFIC,			"Sequence Specific | "},
+		};
+		const std::pair<Event::Type, const char*> sysex[] = {
+			{Event::SYSEX_MESSAGES,				"Sysex Messages | "},
+			{Event::MTC_QUARTER_FRAME,			"MTC QuarterFrame | "},
+			{Event::SONG_POSITION_POINTER,		"Song Pos Ptr | "},
+			{Event::SONG_REQUEST,				"Song Request | "},
+			{Event::TUNE_REQUEST,				"Tune Request | "},
+			{Event::END_OF_SYSEX_MESSAGES,		"End Of Sysex Msg | "},
+			{Event::TIMING_CLOCK_FOR_SYNC,		"Timing Clock For Sync | "},
+			{Event::START_CURRENT_SEQUENCE,		"Start Current Sequence | "},
+			{Event::CONTINUE_STOPPED_SEQUENCE,	"Continue Stopped Sequence | "},
+			{Event::STOP_SEQUENCE,				"Stop Sequence | "},
+			{Event::ACTIVE_SENSING,				"Active Sensing | "},
+		};
+		for (auto [type, name]: midi)
+			labels[type] = " [MIDI] " + pad(name, print_width_type);
+		for (auto [type, name]: meta)
+			labels[type] = " [META] " + pad(name, print_width_type);
+		for (auto [type, name]: sysex)
+			labels[type] = " [Sysex]" + pad(name, print_width_type);
+
+		for (int i = 0; i < 128; ++i)
+		{
+			notes[i] = Note(i).to_string();
+			controllers[i] = pad(
+				Controller::search_type_name(static_cast<Controller::Type>(i)), 20
+			);
+			instruments[i] = pad(
+				Instrument::search_type_name(static_cast<Instrument::Type>(i)), 20
+			);
+		}
+	}
+};
+
+const Names&	get_names()
+{
+	static const Names names;
+	return names;
+}
+} // namespace
+
+
+
+/*##########################
+
+	TextDump
+
+##########################*/
+void				TextDump::append(const Event& event)
+{
+	const Names& names = get_names();
+	Event::Type type = event.get_type();
+	if (names.labels[type].empty())
+	{
+		// not one of ours, let it print itself
+		std::ostringstream os;
+		event.str(os);
+		buffer += os.str();
+		return;
+	}
+
+	append_unsigned(event.delta_time, print_width_delta_time);
+	buffer += names.labels[type];
+
+	if (event.get_category() == Event::MIDI)
+	{
+		const MidiEvent& midi = static_cast<const MidiEvent&>(event);
+		buffer += "ch: ";
+		append_number(midi.get_channel(), 2);
+		buffer += ": ";
+	}
+
+	switch (type)
+	{
+		case Event::NOTE_OFF:
+		{
+			const NoteOff& e = static_cast<const NoteOff&>(event);
+			buffer += names.notes[e.get_note().get_note_number()];
+			buffer += ' ';
+			append_number(e.get_velocity());
+			break;
+		}
+		case Event::NOTE_ON:
+		{
+			const NoteOn& e = static_cast<const NoteOn&>(event);
+			buffer += names.notes[e.get_note().get_note_number()];
+			buffer += ' ';
+			append_number(e.get_velocity());
+			break;
+		}
+		case Event::POLYPHONIC_KEY_PRESSURE:
+		{
+			const PolyphonicKeyPressure& e = static_cast<const PolyphonicKeyPressure&>(event);
+			buffer += names.notes[e.get_note().get_note_number()];
+			buffer += ' ';
+			append_number(e.get_pressure());
+			break;
+		}
+		case Event::CONTROL_CHANGE:
+		{
+			const ControlChange& e = static_cast<const ControlChange&>(event);
+			buffer += names.controllers[e.get_controller().get_type()];
+			buffer += ' ';
+			append_number(e.get_value());
+			break;
+		}
+		case Event::PROGRAM_CHANGE:
+		{
+			const ProgramChange& e = static_cast<const ProgramChange&>(event);
+			buffer += names.instruments[e.get_instrument().get_type()];
+			break;
+		}
+		case Event::CHANNEL_PRESSURE:
+			append_number(static_cast<const ChannelPressure&>(event).get_pressure());
+			break;
+		case Event::PITCH_BEND:
+		{
+			const PitchBend& e = static_cast<const PitchBend&>(event);
+			append_number(e.get_lsb());
+			buffer += ", ";
+			append_number(e.get_msb());
+			break;
+		}
+
+		case Event::SEQUENCE_NUMBER:
+			append_number(static_cast<const SequenceNumber&>(event).get());
+			break;
+		case Event::USER_TEXT:
+		case Event::COPY_RIGHT:
+		case Event::TRACK_NAME:
+		case Event::INSTRUMENT_NAME:
+		case Event::LYRIC:
+		case Event::MARKER:
+		case Event::CUE_POINT:
+		{
+			const std::vector<byte>& data = static_cast<const MetaEvent&>(event).get_data();
+			buffer.append(data.begin(), data.end());
+			break;
+		}
+		case Event::CHANNEL_PREFIX:
+			append_number(static_cast<const ChannelPrefix&>(event).get());
+			break;
+		case Event::MIDI_PORT:
+			append_number(static_cast<const MidiPort&>(event).get());
+			break;
+		case Event::SET_TEMPO:
+			append_number(static_cast<const SetTempo&>(event).get_quarter_note_duration().count());
+			buffer += " ms";
+			break;
+		case Event::SMPTE_OFFSET:
+		{
+			const SMPTEOffset& e = static_cast<const SMPTEOffset&>(event);
+			append_number(e.get_hour());
+			buffer += ':';
+			append_number(e.get_minute());
+			buffer += ':';
+			append_number(e.get_second());
+			buffer += ", frame:";
+			append_number(e.get_frame());
+			buffer += ", sub frame: ";
+			append_number(e.get_subframe());
+			break;
+		}
+		case Event::TIME_SIGNATURE:
+		{
+			const TimeSignature& e = static_cast<const TimeSignature&>(event);
+			append_number(e.get_numerator());
+			buffer += '/';
+			// a double, as printed by a stream: "%g"
+			char number[32];
+			auto result = std::to_chars(
+				number, number + sizeof(number),
+				std::pow(2, e.get_denominator()), std::chars_format::general, 6
+			);
+			buffer.append(number, result.ptr);
+			buffer += ", metronome ticks: ";
+			append_number(e.get_metronome_ticks());
+			buffer += " (1/4) / (1/32) = ";
+			append_number(e.get_quarter_note_division_32());
+			break;
+		}
+		case Event::KEY_SIGNATURE:
+		{
+			const KeySignature& e = static_cast<const KeySignature&>(event);
+			int key = e.get_key();
+			if (key > 0)
+			{
+				buffer += "Sharp: ";
+				append_number(key);
+			}
+			else if (key < 0)
+			{
+				buffer += "flat: ";
+				append_number(key);
+			}
+			else
+			{
+				buffer += "natural";
+			}
+			buffer += e.get_scale() == 1 ? " Major" : " Minor";
+			break;
+		}
+		case Event::SEQUENCE_SPECIFIC:
+		{
+			const std::vector<byte>& data = static_cast<const MetaEvent&>(event).get_data();
+			append_hex(data.data(), data.data() + data.size());
+			break;
+		}
+
+		case Event::SYSEX_MESSAGES:
+			scratch.clear();
+			static_cast<const SysexMessages&>(event).get_messages(scratch);
+			append_hex(scratch.data(), scratch.data() + scratch.size());
+			break;
+		case Event::MTC_QUARTER_FRAME:
+			append_number(static_cast<const MTCQuarterFrame&>(event).get_value());
+			break;
+		case Event::SONG_POSITION_POINTER:
+			append_number(static_cast<const SongPositionPointer&>(event).get_position());
+			break;
+
+		default:
+			break;
+	}
+}
+//------------------------------------------------------------------------------
+void				TextDump::append(const Track& track, int track_number)
+{
+	buffer += "Track ";
+	append_number(track_number);
+	buffer += "\nNum of Events: ";
+	append_unsigned(track.events.size());
+	buffer += '\n';
+
+	int event_number = 0;
+	for (const auto& event: track.events)
+	{
+		append_number(event_number++, print_width_event_number);
+		buffer += " | ";
+		append(*event);
+		buffer += '\n';
+	}
+	buffer += separator + 1; // without the blank line
+}
+//------------------------------------------------------------------------------
+void				TextDump::append_header(const Midi& midi)
+{
+	buffer += "Header\nFormat: ";
+	if (midi.tracks.size() == 1)
+		buffer += "Single Track";
+	else if (midi.tracks.size() > 1)
+		buffer += "Multiple Tracks";
+	buffer += "Num of tracks: ";
+	append_unsigned(midi.tracks.size());
+	buffer += "\nDivision: ";
+	buffer += midi.division.to_string();
+	buffer += '\n';
+	buffer += separator;
+}
+//------------------------------------------------------------------------------
+const std::string&	TextDump::get() const
+{
+	return buffer;
+}
+//------------------------------------------------------------------------------
+void				TextDump::clear()
+{
+	buffer.clear();
+}
+//------------------------------------------------------------------------------
+std::string			TextDump::str(const Midi& midi)
+{
+	std::vector<std::string> buffers = dump(midi);
+	size_t size = 0;
+	for (const auto& buffer: buffers)
+		size += buffer.size();
+
+	std::string result;
+	result.reserve(size);
+	for (const auto& buffer: buffers)
+		result += buffer;
+	return result;
+}
+//------------------------------------------------------------------------------
+void				TextDump::save(const Midi& midi, const std::filesystem::path& file_path)
+{
+	write_file(file_path, dump(midi));
+}
+//------------------------------------------------------------------------------
+void				TextDump::append_number(int64_t value, int width)
+{
+	char number[24];
+	auto result = std::to_chars(number, number + sizeof(number), value);
+	int length = result.ptr - number;
+	if (length < width)
+		buffer.append(width - length, ' ');
+	buffer.append(number, length);
+}
+//------------------------------------------------------------------------------
+void				TextDump::append_unsigned(uint64_t value, int width)
+{
+	char number[24];
+	auto result = std::to_chars(number, number + sizeof(number), value);
+	int length = result.ptr - number;
+	if (length < width)
+		buffer.append(width - length, ' ');
+	buffer.append(number, length);
+}
+//------------------------------------------------------------------------------
+void				TextDump::append_hex(const byte* begin, const byte* end)
+{
+	// hex_dump() with its default splits: a space every 2 bytes, two more
+	// every 8, a line every 64 and two more every 1024
+	static constexpr char digits[] = "0123456789abcdef";
+	for (size_t i = 1; begin != end; ++i, ++begin)
+	{
+		if (std::isalpha(*begin))
+		{
+			buffer += ' ';
+			buffer += static_cast<char>(*begin);
+		}
+		else
+		{
+			buffer += digits[*begin >> 4];
+			buffer += digits[*begin & 0xf];
+		}
+		if (i % 2 == 0)
+			buffer += ' ';
+		if (i % 8 == 0)
+			buffer += "  ";
+		if (i % 64 == 0)
+			buffer += '\n';
+		if (i % 1024 == 0)
+			buffer += "\n\n";
+	}
+}
+//------------------------------------------------------------------------------
+std::vector<std::string>	TextDump::dump(const Midi& midi)
+{
+	std::vector<std::string> buffers(midi.tracks.size() + 1);
+	TextDump header;
+	header.append_header(midi);
+	buffers[0] = std::move(header.buffer);
+
+	parallel_for(midi.tracks.size(), [&](size_t i)
+	{
+		// a line takes about 60 characters
+		TextDump dump;
+		dump.buffer.reserve(midi.tracks[i].events.size() * 64 + 128);
+		dump.append(midi.tracks[i], i);
+		buffers[i + 1] = std::move(dump.buffer);
+	});
+	return buffers;
+}
+} // MidiParser
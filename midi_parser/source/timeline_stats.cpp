@@ -0,0 +1,307 @@
+#include "timeline_stats.h"
+#include "util.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace MidiParser {
+namespace {
+void			append_csv(std::string& output, double value)
+{
+	char buffer[32];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 3);
+	output.append(buffer, result.ptr);
+}
+//------------------------------------------------------------------------------
+void			append_csv(std::string& output, const std::string& path, const std::string& window, const TimelineStats::Window& stats)
+{
+	MidiParser::append_csv(output, path);
+	output += ',' + window;
+	for (int64_t value: {stats.begin, stats.end, static_cast<int64_t>(stats.max_polyphony)})
+		output += ',' + std::to_string(value);
+	output += ',';
+	append_csv(output, stats.mean_polyphony);
+	output += ',' + std::to_string(stats.note_count) + ',';
+	append_csv(output, stats.notes_per_second);
+	output += ',' + std::to_string(stats.controller_count) + ',';
+	append_csv(output, stats.controllers_per_second);
+	output += ',' + std::to_string(stats.event_count);
+	output += ',' + std::to_string(stats.peak_events_per_ms) + ",\n";
+}
+} // anonymous
+
+
+
+/*##########################
+
+	TimelineStats
+
+##########################*/
+TimelineStats::TimelineStats(Microseconds window_size):
+	window_size(window_size.count())
+{
+	if (this->window_size < 0)
+		throw std::invalid_argument("TimelineStats: negative window size");
+	reset();
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::reset()
+{
+	total = {};
+	windows.clear();
+	sounding.fill(0);
+	polyphony = 0;
+	time = 0;
+	millisecond = 0;
+	millisecond_events = 0;
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::apply(int64_t time, int status, int data0, int data1)
+{
+	if (time < this->time)
+		throw std::logic_error("TimelineStats: events out of time order");
+	advance(time);
+	if (status == 0xff)
+		return;
+
+	Window* window = window_size ? &get_window(time) : nullptr;
+	++total.event_count;
+	if (window)
+		++window->event_count;
+	if (time / 1000 != millisecond)
+	{
+		count_millisecond();
+		millisecond = time / 1000;
+	}
+	++millisecond_events;
+
+	size_t slot = (status & 0xf) << 7 | (data0 & 0x7f);
+	switch (status >> 4)
+	{
+		case Event::NOTE_ON:
+			if (data1 != 0)
+			{
+				++sounding[slot];
+				++polyphony;
+				++total.note_count;
+				if (window)
+					++window->note_count;
+				break;
+			}
+			[[fallthrough]];
+		case Event::NOTE_OFF:
+			if (sounding[slot])
+			{
+				--sounding[slot];
+				--polyphony;
+			}
+			break;
+		case Event::CONTROL_CHANGE:
+			++total.controller_count;
+			if (window)
+				++window->controller_count;
+			break;
+		default:
+			break;
+	}
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::finish(int64_t end_time)
+{
+	end_time = std::max(end_time, time);
+	advance(end_time);
+	count_millisecond();
+
+	total.begin = 0;
+	total.end = end_time;
+	complete(total);
+	if (window_size && end_time > 0)
+		get_window(end_time - 1);
+	for (Window& window: windows)
+	{
+		window.end = std::min(window.end, std::max(end_time, window.begin));
+		complete(window);
+	}
+}
+//------------------------------------------------------------------------------
+const TimelineStats::Window&	TimelineStats::get_total() const
+{
+	return total;
+}
+//------------------------------------------------------------------------------
+const std::vector<TimelineStats::Window>&	TimelineStats::get_windows() const
+{
+	return windows;
+}
+//------------------------------------------------------------------------------
+TimelineStats	TimelineStats::measure(const EventTable& table, Microseconds window_size)
+{
+	auto times = table.get_times();
+	auto statuses = table.get_statuses();
+	auto data0 = table.get_data0();
+	auto data1 = table.get_data1();
+
+	// the next event of each track, the earliest on top, then the lowest track
+	struct Cursor
+	{
+		int64_t			time;
+		int				track;
+		size_t			index;
+		size_t			end;
+	};
+	auto greater = [](const Cursor& a, const Cursor& b)
+	{
+		return a.time != b.time ? a.time > b.time : a.track > b.track;
+	};
+	std::vector<Cursor> heap;
+	int64_t end_time = 0;
+	for (int track = 0; track < table.get_track_count(); ++track)
+	{
+		size_t begin = table.get_track_begin(track);
+		size_t end = table.get_track_end(track);
+		if (begin == end)
+			continue;
+		heap.push_back({times[begin], track, begin, end});
+		end_time = std::max(end_time, times[end - 1]);
+	}
+	std::make_heap(heap.begin(), heap.end(), greater);
+
+	TimelineStats stats(window_size);
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		Cursor& cursor = heap.back();
+		// a run of the track until another one comes first, all of it if alone
+		Cursor limit = heap.size() > 1 ? heap.front() : Cursor{INT64_MAX, 0, 0, 0};
+		size_t i = cursor.index;
+		do
+		{
+			stats.apply(times[i], statuses[i], data0[i], data1[i]);
+			++i;
+		}
+		while (i < cursor.end && (times[i] < limit.time || (times[i] == limit.time && cursor.track < limit.track)));
+
+		if (i == cursor.end)
+		{
+			heap.pop_back();
+			continue;
+		}
+		cursor.time = times[i];
+		cursor.index = i;
+		std::push_heap(heap.begin(), heap.end(), greater);
+	}
+	stats.finish(end_time);
+	return stats;
+}
+//------------------------------------------------------------------------------
+TimelineStats	TimelineStats::measure(const Midi& midi, Microseconds window_size)
+{
+	return measure(EventTable(midi), window_size);
+}
+//------------------------------------------------------------------------------
+std::vector<TimelineStats::FileStats>	TimelineStats::measure_files(
+	const std::vector<std::filesystem::path>&	files,
+	Microseconds								window_size
+)
+{
+	std::vector<FileStats> results(files.size());
+	parallel_for(files.size(), [&](size_t i)
+	{
+		FileStats& result = results[i];
+		result.path = files[i];
+		try
+		{
+			TimelineStats stats = measure(Midi(files[i]), window_size);
+			result.total = stats.total;
+			result.windows = std::move(stats.windows);
+		}
+		catch (const std::exception& e)
+		{
+			result.error = e.what();
+		}
+	});
+	return results;
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::save_csv(
+	const std::vector<FileStats>&	stats,
+	const std::filesystem::path&	csv_path
+)
+{
+	std::string output =
+		"path,window,begin_us,end_us,max_polyphony,mean_polyphony,notes,notes_per_second,"
+		"controllers,controllers_per_second,events,peak_events_per_ms,error\n";
+	for (const FileStats& file: stats)
+	{
+		std::string path = file.path.generic_string();
+		if (!file.error.empty())
+		{
+			append_csv(output, path);
+			output += ",,,,,,,,,,,,";
+			append_csv(output, file.error);
+			output += '\n';
+			continue;
+		}
+		append_csv(output, path, "", file.total);
+		for (size_t i = 0; i < file.windows.size(); ++i)
+			append_csv(output, path, std::to_string(i), file.windows[i]);
+	}
+	write_file(csv_path, output);
+}
+//------------------------------------------------------------------------------
+TimelineStats::Window&	TimelineStats::get_window(int64_t time)
+{
+	size_t index = time / window_size;
+	while (windows.size() <= index)
+	{
+		int64_t begin = windows.size() * window_size;
+		windows.push_back({begin, begin + window_size});
+	}
+	return windows[index];
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::advance(int64_t time)
+{
+	if (polyphony && time > this->time)
+	{
+		// mean_polyphony sums voice time until complete()
+		total.max_polyphony = std::max(total.max_polyphony, polyphony);
+		total.mean_polyphony += static_cast<double>(polyphony) * (time - this->time);
+		for (int64_t begin = this->time; window_size && begin < time;)
+		{
+			Window& window = get_window(begin);
+			int64_t end = std::min(time, window.end);
+			window.max_polyphony = std::max(window.max_polyphony, polyphony);
+			window.mean_polyphony += static_cast<double>(polyphony) * (end - begin);
+			begin = end;
+		}
+	}
+	this->time = time;
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::count_millisecond()
+{
+	if (millisecond_events == 0)
+		return;
+	total.peak_events_per_ms = std::max(total.peak_events_per_ms, millisecond_events);
+	if (window_size)
+	{
+		Window& window = get_window(millisecond * 1000);
+		window.peak_events_per_ms = std::max(window.peak_events_per_ms, millisecond_events);
+	}
+	millisecond_events = 0;
+}
+//------------------------------------------------------------------------------
+void			TimelineStats::complete(Window& window)
+{
+	double seconds = (window.end - window.begin) / 1e6;
+	if (seconds <= 0)
+	{
+		window.mean_polyphony = 0;
+		return;
+	}
+	window.mean_polyphony /= seconds * 1e6;
+	window.notes_per_second = window.note_count / seconds;
+	window.controllers_per_second = window.controller_count / seconds;
+}
+} // MidiParser
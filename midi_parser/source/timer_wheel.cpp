@@ -0,0 +1,155 @@
+#include "timer_wheel.h"
+#include <bit>
+
+namespace MidiParser {
+/*##########################
+
+	TimerWheel
+
+##########################*/
+TimerWheel::TimerWheel(uint64_t current):
+	current(current)
+{
+	for (Node& head: slots)
+	{
+		head.prev = &head;
+		head.next = &head;
+	}
+}
+//------------------------------------------------------------------------------
+void			TimerWheel::insert(Node* node, uint64_t tick)
+{
+	remove(node);
+	node->tick = tick;
+	link(node);
+	++count;
+}
+//------------------------------------------------------------------------------
+void			TimerWheel::remove(Node* node)
+{
+	if (node->slot < 0)
+		return;
+	unlink(node);
+	--count;
+}
+//------------------------------------------------------------------------------
+void			TimerWheel::advance(uint64_t tick, std::vector<Node*>& expired)
+{
+	if (count == 0)
+	{
+		if (tick >= current)
+			current = tick + 1;
+		return;
+	}
+	while (current <= tick)
+	{
+		int index = current & slot_mask;
+
+		// Entering a new lap of a level moves its next slot down.
+		if (index == 0)
+		{
+			for (int level = 1; level < level_count && cascade(level) == 0; ++level)
+			{}
+		}
+
+		Node& head = slots[index];
+		while (head.next != &head)
+		{
+			Node* node = head.next;
+			unlink(node);
+			--count;
+			expired.push_back(node);
+		}
+		++current;
+		if (count == 0)
+		{
+			current = tick + 1;
+			break;
+		}
+	}
+}
+//------------------------------------------------------------------------------
+uint64_t		TimerWheel::get_next_expiry() const
+{
+	if (count == 0)
+		return no_expiry;
+
+	// first busy slot of level 0 in this lap, otherwise the next cascade
+	uint64_t index = current & slot_mask;
+	uint64_t busy = occupied >> index;
+	if (busy)
+		return current + std::countr_zero(busy);
+	return (current | slot_mask) + 1;
+}
+//------------------------------------------------------------------------------
+uint64_t		TimerWheel::get_current() const
+{
+	return current;
+}
+//------------------------------------------------------------------------------
+size_t			TimerWheel::size() const
+{
+	return count;
+}
+//------------------------------------------------------------------------------
+bool			TimerWheel::empty() const
+{
+	return count == 0;
+}
+//------------------------------------------------------------------------------
+void			TimerWheel::link(Node* node)
+{
+	uint64_t tick = node->tick < current ? current : node->tick;
+	uint64_t distance = tick - current;
+
+	int level = 0;
+	while (level + 1 < level_count && distance >> (slot_bits * (level + 1)))
+		++level;
+	if (level == level_count - 1 && distance >> (slot_bits * level_count))
+		tick = current + (uint64_t(1) << (slot_bits * level_count)) - 1;
+
+	int index = (tick >> (slot_bits * level)) & slot_mask;
+	node->slot = level * slot_count + index;
+	if (level == 0)
+		occupied |= uint64_t(1) << index;
+
+	Node& head = slots[node->slot];
+	node->prev = head.prev;
+	node->next = &head;
+	head.prev->next = node;
+	head.prev = node;
+}
+//------------------------------------------------------------------------------
+void			TimerWheel::unlink(Node* node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	if (node->slot < slot_count && slots[node->slot].next == &slots[node->slot])
+		occupied &= ~(uint64_t(1) << node->slot);
+	node->prev = nullptr;
+	node->next = nullptr;
+	node->slot = -1;
+}
+//------------------------------------------------------------------------------
+int				TimerWheel::cascade(int level)
+{
+	int index = (current >> (slot_bits * level)) & slot_mask;
+	Node& head = slots[level * slot_count + index];
+
+	if (head.next == &head)
+		return index;
+
+	// detach the whole list first, link() may append to the same slot
+	Node* node = head.next;
+	head.prev->next = nullptr;
+	head.prev = &head;
+	head.next = &head;
+	while (node)
+	{
+		Node* next = node->next;
+		link(node);
+		node = next;
+	}
+	return index;
+}
+} // MidiParser
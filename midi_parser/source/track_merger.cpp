@@ -0,0 +1,145 @@
+#include "track_merger.h"
+#include "midi.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace MidiParser {
+/*##########################
+
+	TrackMerger::iterator
+
+##########################*/
+TrackMerger::iterator::iterator(TrackMerger* merger):
+	merger(merger)
+{
+	if (merger->empty())
+		this->merger = nullptr;
+	else
+		item = merger->next();
+}
+//------------------------------------------------------------------------------
+TrackMerger::iterator::reference	TrackMerger::iterator::operator*() const
+{
+	return item;
+}
+//------------------------------------------------------------------------------
+TrackMerger::iterator::pointer	TrackMerger::iterator::operator->() const
+{
+	return &item;
+}
+//------------------------------------------------------------------------------
+TrackMerger::iterator&	TrackMerger::iterator::operator++()
+{
+	if (merger->empty())
+		merger = nullptr;
+	else
+		item = merger->next();
+	return *this;
+}
+//------------------------------------------------------------------------------
+void	TrackMerger::iterator::operator++(int)
+{
+	++*this;
+}
+//------------------------------------------------------------------------------
+bool	TrackMerger::iterator::operator==(const iterator& other) const
+{
+	return merger == other.merger;
+}
+
+
+
+
+/*##########################
+
+	TrackMerger
+
+##########################*/
+TrackMerger::TrackMerger(const Midi& midi):
+	TrackMerger(midi.tracks)
+{}
+//------------------------------------------------------------------------------
+TrackMerger::TrackMerger(const std::vector<Track>& tracks):
+	tracks(&tracks)
+{
+	reset();
+}
+//------------------------------------------------------------------------------
+bool		TrackMerger::empty() const
+{
+	return heap.empty();
+}
+//------------------------------------------------------------------------------
+const TrackMerger::Item&	TrackMerger::peek() const
+{
+	if (heap.empty())
+		throw std::out_of_range(__func__);
+	return heap.front().item;
+}
+//------------------------------------------------------------------------------
+TrackMerger::Item	TrackMerger::next()
+{
+	if (heap.empty())
+		throw std::out_of_range(__func__);
+	std::pop_heap(heap.begin(), heap.end(), greater);
+	Item item = heap.back().item;
+	heap.pop_back();
+	push(item.track, item.index + 1);
+	return item;
+}
+//------------------------------------------------------------------------------
+uint64_t	TrackMerger::get_timestamp() const
+{
+	if (heap.empty())
+		throw std::out_of_range(__func__);
+	return heap.front().timestamp;
+}
+//------------------------------------------------------------------------------
+void		TrackMerger::seek(uint64_t tick)
+{
+	heap.clear();
+	for (size_t i = 0; i < tracks->size(); ++i)
+	{
+		const auto& events = (*tracks)[i].events;
+		auto it = std::lower_bound(events.begin(), events.end(), tick,
+			[](const Event::ptr& event, uint64_t tick){ return event->timestamp < tick; }
+		);
+		push(i, it - events.begin());
+	}
+}
+//------------------------------------------------------------------------------
+void		TrackMerger::reset()
+{
+	heap.clear();
+	heap.reserve(tracks->size());
+	for (size_t i = 0; i < tracks->size(); ++i)
+		push(i, 0);
+}
+//------------------------------------------------------------------------------
+TrackMerger::iterator	TrackMerger::begin()
+{
+	return iterator(this);
+}
+//------------------------------------------------------------------------------
+TrackMerger::iterator	TrackMerger::end()
+{
+	return iterator();
+}
+//------------------------------------------------------------------------------
+bool		TrackMerger::greater(const Cursor& a, const Cursor& b)
+{
+	if (a.timestamp != b.timestamp)
+		return a.timestamp > b.timestamp;
+	return a.item.track > b.item.track;
+}
+//------------------------------------------------------------------------------
+void		TrackMerger::push(int track, size_t index)
+{
+	const auto& events = (*tracks)[track].events;
+	if (index >= events.size())
+		return;
+	const Event* event = events[index].get();
+	heap.push_back({event->timestamp, {track, index, event}});
+	std::push_heap(heap.begin(), heap.end(), greater);
+}
+} // MidiParser
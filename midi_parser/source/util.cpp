@@ -1,5 +1,14 @@
 #include "util.h"
 #include <sstream>
+#include <cctype>
+#include <random>
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace MidiParser {
 std::vector<byte>	read_bin_file(const std::filesystem::path &file_path)
@@ -27,6 +36,34 @@ std::string			read_file(const std::filesystem::path& file_path)
 	return ss.str();
 }
 //------------------------------------------------------------------------------
+void				get_file_stamp(
+	const std::filesystem::path&	file_path,
+	uint64_t&						size,
+	int64_t&						time
+)
+{
+	size = std::filesystem::file_size(file_path);
+	time = std::filesystem::last_write_time(file_path).time_since_epoch().count();
+}
+//------------------------------------------------------------------------------
+std::vector<std::filesystem::path>	find_midi_files(const std::filesystem::path& directory)
+{
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry: std::filesystem::recursive_directory_iterator(directory))
+	{
+		if (!entry.is_regular_file())
+			continue;
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(),
+			[](unsigned char c){ return std::tolower(c); }
+		);
+		if (extension == ".mid" || extension == ".midi")
+			files.push_back(entry.path());
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+//------------------------------------------------------------------------------
 void				write_bin_file(
 	const std::filesystem::path&	file_path, 
 	const std::vector<byte>&		data)
@@ -38,6 +75,123 @@ void				write_bin_file(
 	ofs.close();
 }
 //------------------------------------------------------------------------------
+namespace {
+// The mode only matters on Windows, elsewhere text and binary are the same bytes.
+template <typename Buffer>
+void				write_buffers(
+	const std::filesystem::path&	file_path,
+	const std::vector<Buffer>&		buffers,
+	[[maybe_unused]] std::ios::openmode	mode
+)
+{
+#ifdef _WIN32
+	std::ofstream ofs(file_path, mode);
+	if (!ofs.is_open())
+		throw std::runtime_error("Error: open file");
+	for (const auto& buffer: buffers)
+		ofs.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	if (!ofs)
+		throw std::runtime_error("Error: write file");
+#else
+	std::vector<iovec> vectors;
+	vectors.reserve(buffers.size());
+	for (const auto& buffer: buffers)
+	{
+		if (!buffer.empty())
+			vectors.push_back({const_cast<void*>(static_cast<const void*>(buffer.data())), buffer.size()});
+	}
+
+	int fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw std::runtime_error("Error: open file");
+	size_t done = 0;
+	while (done < vectors.size())
+	{
+		int count = static_cast<int>(std::min<size_t>(vectors.size() - done, IOV_MAX));
+		ssize_t written = ::writev(fd, &vectors[done], count);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			::close(fd);
+			throw std::runtime_error("Error: write file");
+		}
+		// skip what is written, a write may stop in the middle of a buffer
+		for (size_t left = written; left;)
+		{
+			iovec& vector = vectors[done];
+			if (left < vector.iov_len)
+			{
+				vector.iov_base = static_cast<byte*>(vector.iov_base) + left;
+				vector.iov_len -= left;
+				break;
+			}
+			left -= vector.iov_len;
+			++done;
+		}
+	}
+	if (::close(fd) < 0)
+		throw std::runtime_error("Error: write file");
+#endif
+}
+} // namespace
+//------------------------------------------------------------------------------
+void				write_bin_file(
+	const std::filesystem::path&			file_path,
+	const std::vector<std::vector<byte>>&	buffers
+)
+{
+	write_buffers(file_path, buffers, std::ios::binary);
+}
+//------------------------------------------------------------------------------
+void				write_bin_file(
+	const std::filesystem::path&				file_path,
+	const std::vector<std::span<const byte>>&	buffers
+)
+{
+	write_buffers(file_path, buffers, std::ios::binary);
+}
+//------------------------------------------------------------------------------
+void				replace_bin_file(
+	const std::filesystem::path&	file_path,
+	std::span<const byte>			data
+)
+{
+	std::filesystem::path temp_path = file_path;
+	temp_path += ".tmp" + std::to_string(std::random_device()());
+	try
+	{
+		write_bin_file(temp_path, std::vector<std::span<const byte>>{data});
+		std::filesystem::rename(temp_path, file_path);
+	}
+	catch (...)
+	{
+		std::error_code error;
+		std::filesystem::remove(temp_path, error);
+		throw;
+	}
+}
+//------------------------------------------------------------------------------
+void				append_csv(std::string& output, std::string_view text)
+{
+	output += '"';
+	for (char c: text)
+	{
+		if (c == '"')
+			output += '"';
+		output += c;
+	}
+	output += '"';
+}
+//------------------------------------------------------------------------------
+void				write_file(
+	const std::filesystem::path&	file_path,
+	const std::vector<std::string>&	buffers
+)
+{
+	write_buffers(file_path, buffers, std::ios::out);
+}
+//------------------------------------------------------------------------------
 void				write_file(
 	const std::filesystem::path&	file_path, 
 	const std::string&				data